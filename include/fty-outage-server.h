@@ -22,6 +22,10 @@
 #ifndef FTY_OUTAGE_SERVER_H_INCLUDED
 #define FTY_OUTAGE_SERVER_H_INCLUDED
 
+//  Stream of published outage sets, subject "outage/snapshot",
+//  OUTAGE_SNAPSHOT/<sequence>/<time>/<count>/asset1/.../assetN
+#define FTY_OUTAGE_STREAM_SNAPSHOT "_OUTAGE_SNAPSHOT"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
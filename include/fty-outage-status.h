@@ -0,0 +1,109 @@
+/*  =========================================================================
+    fty_outage_status - Shared memory table of outage status
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef FTY_OUTAGE_STATUS_H_INCLUDED
+#define FTY_OUTAGE_STATUS_H_INCLUDED
+
+// default path of the table published by the agent
+#define FTY_OUTAGE_STATUS_FILE "/run/fty-outage/status"
+
+// size of name field, longer asset names are not published
+#define FTY_OUTAGE_STATUS_NAME_SIZE 64
+
+// fty_outage_status_record_t flags
+#define FTY_OUTAGE_STATUS_ALERT_ACTIVE 0x01
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _fty_outage_status_record_t {
+    char name [FTY_OUTAGE_STATUS_NAME_SIZE];    // asset iname, zero terminated
+    uint64_t last_time_seen_sec;    // [s] last time the asset was seen
+    uint64_t ttl_sec;               // [s] learned TTL
+    uint64_t expires_sec;           // [s] asset is dead since then
+    uint64_t maintenance_until_sec; // [s] end of maintenance, 0 if none
+    uint32_t flags;                 // FTY_OUTAGE_STATUS_ALERT_ACTIVE
+    uint32_t reserved;
+} fty_outage_status_record_t;
+
+//  @interface
+//  Open the table published by the agent for lookups
+//  return NULL if the table does not exist or has unknown format
+FTY_OUTAGE_EXPORT fty_outage_status_t *
+    fty_outage_status_open (const char *path);
+
+//  Create (or replace) the table to publish status, used by the agent
+//  return NULL on error
+FTY_OUTAGE_EXPORT fty_outage_status_t *
+    fty_outage_status_create (const char *path, size_t capacity);
+
+//  Close the table
+FTY_OUTAGE_EXPORT void
+    fty_outage_status_destroy (fty_outage_status_t **self_p);
+
+//  Copy status of the asset to record, without any lock nor message bus
+//  return 0 if found, -1 if the asset is not in the table
+FTY_OUTAGE_EXPORT int
+    fty_outage_status_lookup (fty_outage_status_t *self, const char *asset_name,
+                              fty_outage_status_record_t *record);
+
+//  Return number of assets in the table
+FTY_OUTAGE_EXPORT size_t
+    fty_outage_status_size (fty_outage_status_t *self);
+
+//  Return time [s] the table was published, 0 if never
+FTY_OUTAGE_EXPORT uint64_t
+    fty_outage_status_time (fty_outage_status_t *self);
+
+//  Return state of the asset at now_sec: "alive", "dead", "maintenance" or
+//  "unknown" if it was never seen
+FTY_OUTAGE_EXPORT const char *
+    fty_outage_status_state (const fty_outage_status_record_t *record, uint64_t now_sec);
+
+//  Start to write new content of the table with count records, assets must
+//  be appended ordered by name. Table is recreated bigger if needed.
+//  return -1 on error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    fty_outage_status_begin (fty_outage_status_t *self, size_t count);
+
+//  Append status of the asset
+//  return -1 if name is too long or table is full, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    fty_outage_status_append (fty_outage_status_t *self, const char *asset_name,
+                              uint64_t last_time_seen_sec, uint64_t ttl_sec, uint64_t expires_sec,
+                              uint64_t maintenance_until_sec, uint32_t flags);
+
+//  Make the new content visible to readers
+FTY_OUTAGE_EXPORT void
+    fty_outage_status_commit (fty_outage_status_t *self, uint64_t time_sec);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    fty_outage_status_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -86,12 +86,15 @@
 #ifdef FTY_OUTAGE_BUILD_DRAFT_API
 typedef struct _fty_outage_server_t fty_outage_server_t;
 #define FTY_OUTAGE_SERVER_T_DEFINED
+typedef struct _fty_outage_status_t fty_outage_status_t;
+#define FTY_OUTAGE_STATUS_T_DEFINED
 #endif // FTY_OUTAGE_BUILD_DRAFT_API
 
 
 //  Public classes, each with its own header file
 #ifdef FTY_OUTAGE_BUILD_DRAFT_API
 #include "fty-outage-server.h"
+#include "fty-outage-status.h"
 #endif // FTY_OUTAGE_BUILD_DRAFT_API
 
 #ifdef FTY_OUTAGE_BUILD_DRAFT_API
@@ -0,0 +1,423 @@
+/*  =========================================================================
+    blackbox - Flight recorder of outage events
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    blackbox - Flight recorder of outage events
+@discuss
+    Always-on, fixed-size ring of the last BLACKBOX_EVENTS compact events
+    of the agent: metrics seen with their time and ttl, alert transitions,
+    maintenance changes, timings of dead devices checks and stalls of the
+    main loop. Recording is an atomic increment and a copy of one cache
+    line, without any allocation or lock. The ring is dumped on the
+    BLACKBOX mailbox request or on a signal (SIGUSR1 in the agent), and
+    `fty-outage --blackbox FILE` prints the dump, so a missed or spurious
+    alert can be explained without debug logging turned on in advance.
+@end
+*/
+
+#include "fty_outage_classes.h"
+#include <atomic>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <limits.h>
+
+static blackbox_event_t s_ring [BLACKBOX_EVENTS] __attribute__ ((aligned (64)));
+static std::atomic<uint64_t> s_head (0);
+static char s_file [PATH_MAX];
+
+static const char *
+s_type_name (int type)
+{
+    switch (type) {
+        case BLACKBOX_TOUCH:            return "touch";
+        case BLACKBOX_ALERT_ACTIVE:     return "alert-active";
+        case BLACKBOX_ALERT_RESOLVED:   return "alert-resolved";
+        case BLACKBOX_MAINTENANCE_ON:   return "maintenance-on";
+        case BLACKBOX_MAINTENANCE_OFF:  return "maintenance-off";
+        case BLACKBOX_SWEEP:            return "sweep";
+        case BLACKBOX_ASSET_ADD:        return "asset-add";
+        case BLACKBOX_ASSET_DELETE:     return "asset-delete";
+        case BLACKBOX_STALL:            return "stall";
+        default:                        return "unknown";
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Record the event to the ring, overwriting the oldest one
+void
+blackbox_record (int type, const char *asset, uint64_t value, uint64_t value2)
+{
+    uint64_t n = s_head.fetch_add (1, std::memory_order_relaxed);
+    blackbox_event_t *event = &s_ring [n & (BLACKBOX_EVENTS - 1)];
+
+    __atomic_store_n (&event->seq_start, n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    event->time_ms = vclock_time ();
+    event->value = value;
+    event->value2 = value2;
+    event->type = (uint8_t) type;
+    strncpy (event->asset, asset ? asset : "", BLACKBOX_ASSET_SIZE - 1);
+    event->asset [BLACKBOX_ASSET_SIZE - 1] = '\0';
+    __atomic_store_n (&event->seq, n + 1, __ATOMIC_RELEASE);
+}
+
+//  --------------------------------------------------------------------------
+//  Return number of events recorded since the start
+uint64_t
+blackbox_head (void)
+{
+    return s_head.load (std::memory_order_acquire);
+}
+
+//  --------------------------------------------------------------------------
+//  Set file used by blackbox_dump_file and the signal handler
+void
+blackbox_set_file (const char *path)
+{
+    strncpy (s_file, path ? path : "", sizeof (s_file) - 1);
+    s_file [sizeof (s_file) - 1] = '\0';
+}
+
+//  --------------------------------------------------------------------------
+//  Return file set by blackbox_set_file
+const char *
+blackbox_file (void)
+{
+    return s_file;
+}
+
+// write all of size, restarting on interrupts
+static int
+s_write (int fd, const void *data, size_t size)
+{
+    const char *cursor = (const char *) data;
+    while (size > 0) {
+        ssize_t written = write (fd, cursor, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return -1;
+        cursor += written;
+        size -= (size_t) written;
+    }
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Write the ring to path, async-signal-safe
+int
+blackbox_dump (const char *path)
+{
+    if (!path || !*path)
+        return -1;
+    int fd = open (path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return -1;
+
+    blackbox_header_t header;
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, BLACKBOX_MAGIC, sizeof (header.magic));
+    header.event_size = sizeof (blackbox_event_t);
+    header.events = BLACKBOX_EVENTS;
+    header.head = s_head.load (std::memory_order_acquire);
+
+    int rv = s_write (fd, &header, sizeof (header));
+    if (rv == 0)
+        rv = s_write (fd, s_ring, sizeof (s_ring));
+    if (close (fd) != 0)
+        rv = -1;
+    return rv;
+}
+
+//  --------------------------------------------------------------------------
+//  Write the ring to the file set by blackbox_set_file
+int
+blackbox_dump_file (void)
+{
+    return blackbox_dump (s_file);
+}
+
+static void
+s_signal_handler (int signum)
+{
+    (void) signum;
+    int saved_errno = errno;
+    blackbox_dump (s_file);
+    errno = saved_errno;
+}
+
+//  --------------------------------------------------------------------------
+//  Dump the ring to the file set by blackbox_set_file on signal signum
+int
+blackbox_catch (int signum)
+{
+    struct sigaction action;
+    memset (&action, 0, sizeof (action));
+    action.sa_handler = s_signal_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset (&action.sa_mask);
+    return sigaction (signum, &action, NULL);
+}
+
+//  --------------------------------------------------------------------------
+//  Call fn for each complete event of the dump at path, oldest first
+int
+blackbox_read (const char *path, blackbox_read_fn *fn, void *arg)
+{
+    assert (path);
+    assert (fn);
+
+    FILE *file = fopen (path, "rb");
+    if (!file)
+        return -1;
+
+    int count = -1;
+    blackbox_header_t header;
+    blackbox_event_t *ring = NULL;
+    if (fread (&header, sizeof (header), 1, file) != 1
+    ||  memcmp (header.magic, BLACKBOX_MAGIC, sizeof (header.magic)) != 0
+    ||  header.event_size != sizeof (blackbox_event_t)
+    ||  header.events == 0
+    ||  (header.events & (header.events - 1)) != 0) {
+        log_error ("%s: not a dump of the flight recorder", path);
+        goto end;
+    }
+    ring = (blackbox_event_t *) malloc ((size_t) header.events * sizeof (blackbox_event_t));
+    if (!ring || fread (ring, sizeof (blackbox_event_t), header.events, file) != header.events) {
+        log_error ("%s: dump of the flight recorder is truncated", path);
+        goto end;
+    }
+
+    count = 0;
+    for (uint64_t n = header.head > header.events ? header.head - header.events : 0;
+         n < header.head;
+         n++)
+    {
+        const blackbox_event_t *event = &ring [n & (header.events - 1)];
+        // overwritten or half written while dumped
+        if (event->seq != n + 1 || event->seq_start != n + 1)
+            continue;
+        fn (event, arg);
+        count++;
+    }
+end:
+    free (ring);
+    fclose (file);
+    return count;
+}
+
+//  --------------------------------------------------------------------------
+//  Print the event as a single readable line
+void
+blackbox_format (const blackbox_event_t *event, char *buffer, size_t size)
+{
+    assert (event);
+    assert (buffer);
+
+    time_t time_sec = (time_t) (event->time_ms / 1000);
+    struct tm tm;
+    char date [32];
+    if (!gmtime_r (&time_sec, &tm) || !strftime (date, sizeof (date), "%Y-%m-%dT%H:%M:%S", &tm))
+        snprintf (date, sizeof (date), "%" PRIi64, (int64_t) time_sec);
+
+    char asset [BLACKBOX_ASSET_SIZE];
+    memcpy (asset, event->asset, sizeof (asset));
+    asset [sizeof (asset) - 1] = '\0';
+
+    int length = snprintf (buffer, size, "%s.%03dZ %-15s %s", date, (int) (event->time_ms % 1000),
+                           s_type_name (event->type), asset);
+    if (length < 0 || (size_t) length >= size)
+        return;
+    buffer += length;
+    size -= (size_t) length;
+
+    switch (event->type) {
+        case BLACKBOX_TOUCH:
+            snprintf (buffer, size, " time=%" PRIu64 " ttl=%" PRIu64, event->value, event->value2);
+            break;
+        case BLACKBOX_ALERT_ACTIVE:
+        case BLACKBOX_ALERT_RESOLVED:
+            snprintf (buffer, size, " rv=%d", (int) event->value);
+            break;
+        case BLACKBOX_MAINTENANCE_ON:
+            snprintf (buffer, size, " until=%" PRIu64, event->value);
+            break;
+        case BLACKBOX_SWEEP:
+            snprintf (buffer, size, " duration_us=%" PRIu64 " dead=%" PRIu64, event->value, event->value2);
+            break;
+        case BLACKBOX_STALL:
+            snprintf (buffer, size, " duration_us=%" PRIu64 " phase_us=%" PRIu64, event->value, event->value2);
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+s_decode_event (const blackbox_event_t *event, void *arg)
+{
+    char line [256];
+    blackbox_format (event, line, sizeof (line));
+    fprintf ((FILE *) arg, "%s\n", line);
+}
+
+//  --------------------------------------------------------------------------
+//  Print all events of the dump at path to file
+int
+blackbox_decode (const char *path, FILE *file)
+{
+    assert (file);
+    return blackbox_read (path, s_decode_event, file);
+}
+
+//  --------------------------------------------------------------------------
+//  Forget all recorded events
+void
+blackbox_reset (void)
+{
+    memset (s_ring, 0, sizeof (s_ring));
+    s_head.store (0, std::memory_order_release);
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+static void
+s_test_collect (const blackbox_event_t *event, void *arg)
+{
+    zlistx_t *events = (zlistx_t *) arg;
+    blackbox_event_t *copy = (blackbox_event_t *) malloc (sizeof (blackbox_event_t));
+    assert (copy);
+    memcpy (copy, event, sizeof (blackbox_event_t));
+    zlistx_add_end (events, copy);
+}
+
+static void
+s_test_destroy (void **item_p)
+{
+    free (*item_p);
+    *item_p = NULL;
+}
+
+void
+blackbox_test (bool verbose)
+{
+    ftylog_setInstance("blackbox_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * blackbox: \n");
+
+    //  @selftest
+    const char *dump = "src/blackbox_test.bin";
+    unlink (dump);
+    assert (sizeof (blackbox_event_t) == 64);
+
+    blackbox_reset ();
+    vclock_set_virtual (1600000000000);
+    blackbox_record (BLACKBOX_TOUCH, "ups-1", 1600000000, 60);
+    blackbox_record (BLACKBOX_ALERT_ACTIVE, "a-very-long-name-of-an-asset", 0, 0);
+    vclock_advance (1500);
+    blackbox_record (BLACKBOX_SWEEP, NULL, 120, 1);
+    assert (blackbox_head () == 3);
+
+    // nothing is dumped without a file
+    blackbox_set_file (NULL);
+    assert (streq (blackbox_file (), ""));
+    assert (blackbox_dump_file () == -1);
+
+    blackbox_set_file (dump);
+    assert (blackbox_dump_file () == 0);
+    zlistx_t *events = zlistx_new ();
+    zlistx_set_destructor (events, s_test_destroy);
+    assert (blackbox_read (dump, s_test_collect, events) == 3);
+    blackbox_event_t *event = (blackbox_event_t *) zlistx_first (events);
+    assert (event->type == BLACKBOX_TOUCH && streq (event->asset, "ups-1"));
+    assert (event->time_ms == 1600000000000 && event->value == 1600000000 && event->value2 == 60);
+    event = (blackbox_event_t *) zlistx_next (events);
+    assert (event->type == BLACKBOX_ALERT_ACTIVE && streq (event->asset, "a-very-long-name-of-an"));
+    event = (blackbox_event_t *) zlistx_next (events);
+    assert (event->type == BLACKBOX_SWEEP && event->time_ms == 1600000001500 && streq (event->asset, ""));
+    char line [256];
+    blackbox_format (event, line, sizeof (line));
+    assert (streq (line, "2020-09-13T12:26:41.500Z sweep            duration_us=120 dead=1"));
+    zlistx_purge (events);
+
+    // the ring keeps the newest events only
+    for (int i = 0; i < BLACKBOX_EVENTS + 10; i++)
+        blackbox_record (BLACKBOX_TOUCH, "ups-2", (uint64_t) i, 60);
+    assert (blackbox_dump (dump) == 0);
+    assert (blackbox_read (dump, s_test_collect, events) == BLACKBOX_EVENTS);
+    event = (blackbox_event_t *) zlistx_first (events);
+    assert (event->value == 10);
+    event = (blackbox_event_t *) zlistx_last (events);
+    assert (event->value == BLACKBOX_EVENTS + 9);
+    zlistx_purge (events);
+
+    // half written event is dropped
+    s_ring [(blackbox_head () - 1) & (BLACKBOX_EVENTS - 1)].seq_start++;
+    assert (blackbox_dump (dump) == 0);
+    assert (blackbox_read (dump, s_test_collect, events) == BLACKBOX_EVENTS - 1);
+    zlistx_purge (events);
+
+    // dump on a signal
+    blackbox_reset ();
+    blackbox_record (BLACKBOX_MAINTENANCE_ON, "ups-3", 1600003600, 0);
+    assert (blackbox_catch (SIGUSR1) == 0);
+    raise (SIGUSR1);
+    signal (SIGUSR1, SIG_DFL);
+    FILE *decoded = tmpfile ();
+    assert (decoded);
+    assert (blackbox_decode (dump, decoded) == 1);
+    rewind (decoded);
+    assert (fgets (line, sizeof (line), decoded));
+    assert (streq (line, "2020-09-13T12:26:41.500Z maintenance-on  ups-3 until=1600003600\n"));
+    fclose (decoded);
+
+    // garbage is refused
+    FILE *garbage = fopen (dump, "w");
+    assert (garbage);
+    fputs ("garbage", garbage);
+    fclose (garbage);
+    assert (blackbox_read (dump, s_test_collect, events) == -1);
+    assert (zlistx_size (events) == 0);
+
+    // recording is cheap enough to be always on
+    blackbox_reset ();
+    const int count = 1000000;
+    int64_t start = zclock_usecs ();
+    for (int i = 0; i < count; i++)
+        blackbox_record (BLACKBOX_TOUCH, "epdu-42", (uint64_t) i, 60);
+    int64_t elapsed = zclock_usecs () - start;
+    assert (blackbox_head () == (uint64_t) count);
+    log_info ("%s: %d events recorded in %" PRIi64 " us", __func__, count, elapsed);
+
+    zlistx_destroy (&events);
+    blackbox_reset ();
+    blackbox_set_file (NULL);
+    vclock_set_real ();
+    unlink (dump);
+    //  @end
+    printf ("OK\n");
+}
@@ -0,0 +1,135 @@
+/*  =========================================================================
+    blackbox - Flight recorder of outage events
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+
+#ifndef BLACKBOX_H_INCLUDED
+#define BLACKBOX_H_INCLUDED
+
+#include "../include/fty-outage.h"
+
+// events
+#define BLACKBOX_TOUCH              1   // metric seen: value = time [s] of the metric, value2 = ttl [s]
+#define BLACKBOX_ALERT_ACTIVE       2   // alert published: value = rv of mlm_client_send
+#define BLACKBOX_ALERT_RESOLVED     3   // alert published: value = rv of mlm_client_send
+#define BLACKBOX_MAINTENANCE_ON     4   // maintenance enabled: value = until [s]
+#define BLACKBOX_MAINTENANCE_OFF    5   // maintenance disabled or expired
+#define BLACKBOX_SWEEP              6   // dead devices checked: value = duration [us], value2 = dead devices
+#define BLACKBOX_ASSET_ADD          7   // asset tracked
+#define BLACKBOX_ASSET_DELETE       8   // asset forgotten
+#define BLACKBOX_STALL              9   // main loop stalled: asset = phase, value = duration [us], value2 = [us] of the phase
+
+// events kept in memory, must be a power of two (64 B each)
+#ifndef BLACKBOX_EVENTS
+#define BLACKBOX_EVENTS             (1 << 16)
+#endif
+
+#define BLACKBOX_MAGIC              "FTYOBBX1"
+#define BLACKBOX_ASSET_SIZE         23  // names of assets longer than 22 characters are cut
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  One recorded event, a cache line. Sequence number n + 1 of the event is
+//  written both before (seq_start) and after (seq) the other fields, so an
+//  event caught half written by a dump has them different and is dropped.
+typedef struct _blackbox_event_t {
+    uint64_t seq;                   // written last
+    int64_t time_ms;                // vclock_time
+    uint64_t value;                 // BLACKBOX_* specific
+    uint64_t value2;                // BLACKBOX_* specific
+    uint8_t type;                   // BLACKBOX_*
+    char asset [BLACKBOX_ASSET_SIZE];
+    uint64_t seq_start;             // written first
+} blackbox_event_t;
+
+//  Dump is the header followed by all BLACKBOX_EVENTS events of the ring
+typedef struct _blackbox_header_t {
+    char magic [8];                 // BLACKBOX_MAGIC
+    uint32_t event_size;            // sizeof (blackbox_event_t)
+    uint32_t events;                // size of the ring
+    uint64_t head;                  // events recorded since the start
+} blackbox_header_t;
+
+// callback for blackbox_read
+typedef void (blackbox_read_fn) (const blackbox_event_t *event, void *arg);
+
+//  @interface
+//  Record the event of the asset (may be NULL) to the process wide ring,
+//  overwriting the oldest one. Lock-free, safe to call from any thread.
+FTY_OUTAGE_EXPORT void
+    blackbox_record (int type, const char *asset, uint64_t value, uint64_t value2);
+
+//  Return number of events recorded since the start
+FTY_OUTAGE_EXPORT uint64_t
+    blackbox_head (void);
+
+//  Set file used by blackbox_dump_file and the signal handler, empty or NULL
+//  disables dumps to it
+FTY_OUTAGE_EXPORT void
+    blackbox_set_file (const char *path);
+
+//  Return file set by blackbox_set_file, "" if not set
+FTY_OUTAGE_EXPORT const char *
+    blackbox_file (void);
+
+//  Write the ring to path, return 0 on success, -1 otherwise. Uses only
+//  async-signal-safe calls and does not stop recording.
+FTY_OUTAGE_EXPORT int
+    blackbox_dump (const char *path);
+
+//  Write the ring to the file set by blackbox_set_file, return 0 on success
+FTY_OUTAGE_EXPORT int
+    blackbox_dump_file (void);
+
+//  Dump the ring to the file set by blackbox_set_file on signal signum
+//  (e.g. SIGUSR1), return 0 on success, -1 otherwise
+FTY_OUTAGE_EXPORT int
+    blackbox_catch (int signum);
+
+//  Call fn for each complete event of the dump at path, oldest first
+//  return number of events, -1 if the file is not a dump
+FTY_OUTAGE_EXPORT int
+    blackbox_read (const char *path, blackbox_read_fn *fn, void *arg);
+
+//  Print the event as a single readable line to buffer of size
+FTY_OUTAGE_EXPORT void
+    blackbox_format (const blackbox_event_t *event, char *buffer, size_t size);
+
+//  Print all events of the dump at path to file, return as blackbox_read
+FTY_OUTAGE_EXPORT int
+    blackbox_decode (const char *path, FILE *file);
+
+//  Forget all recorded events
+FTY_OUTAGE_EXPORT void
+    blackbox_reset (void);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    blackbox_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,341 @@
+/*  =========================================================================
+    catalog - On-disk catalog of tracked assets
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    catalog - On-disk catalog of tracked assets
+@discuss
+    Catalog keeps iname, unicode name, subtype and parent device of every
+    tracked asset, so they are known right after start, before the asset
+    agent republishes them. It has the same layout as the state snapshot:
+    a header, fixed size records and an area of zero terminated strings,
+    loaded by mapping the file to memory.
+@end
+*/
+
+#include "fty_outage_classes.h"
+#include <sys/mman.h>
+
+// checksum of the header with zero checksum field, records and strings
+static uint64_t
+s_catalog_checksum (catalog_t *self)
+{
+    uint64_t hash = STATE_FNV_OFFSET_BASIS;
+    catalog_header_t header = *self->header;
+    header.checksum = 0;
+    hash = state_fnv1a (hash, &header, sizeof (header));
+    hash = state_fnv1a (hash, self->records, self->header->count * sizeof (catalog_record_t));
+    hash = state_fnv1a (hash, self->strings, self->header->strings_size);
+    return hash;
+}
+
+// append string to string area, return its offset or UINT32_MAX on error
+static uint32_t
+s_catalog_string_add (catalog_t *self, const char *string)
+{
+    catalog_header_t *header = self->header;
+    size_t length = strlen (string) + 1;
+    if (header->strings_size + length >= UINT32_MAX)
+        return UINT32_MAX;
+    if (header->strings_size + length > self->strings_alloc) {
+        size_t alloc = self->strings_alloc ? self->strings_alloc * 2 : 4096;
+        while (alloc < header->strings_size + length)
+            alloc *= 2;
+        char *strings = (char *) realloc (self->strings, alloc);
+        if (!strings)
+            return UINT32_MAX;
+        self->strings = strings;
+        self->strings_alloc = alloc;
+    }
+    uint32_t offset = (uint32_t) header->strings_size;
+    memcpy (self->strings + offset, string, length);
+    header->strings_size += length;
+    return offset;
+}
+
+//  --------------------------------------------------------------------------
+//  Create a new empty catalog
+catalog_t *
+catalog_new (void)
+{
+    catalog_t *self = (catalog_t *) zmalloc (sizeof (catalog_t));
+    if (self) {
+        self->header = (catalog_header_t *) zmalloc (sizeof (catalog_header_t));
+        if (!self->header) {
+            free (self);
+            return NULL;
+        }
+        memcpy (self->header->magic, CATALOG_MAGIC, sizeof (self->header->magic));
+        self->header->version = CATALOG_VERSION;
+    }
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the catalog
+void
+catalog_destroy (catalog_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        catalog_t *self = *self_p;
+        if (self->map)
+            munmap (self->map, self->map_size);
+        else {
+            free (self->header);
+            free (self->records);
+            free (self->strings);
+        }
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Append record for an asset
+int
+catalog_add (catalog_t *self, const char *asset_name, const char *ename,
+             const char *subtype, const char *parent_name)
+{
+    assert (self);
+    assert (asset_name);
+    assert (!self->map);
+
+    catalog_header_t *header = self->header;
+    if (header->count == self->records_alloc) {
+        size_t alloc = self->records_alloc ? self->records_alloc * 2 : 256;
+        catalog_record_t *records = (catalog_record_t *) realloc (self->records, alloc * sizeof (catalog_record_t));
+        if (!records)
+            return -1;
+        self->records = records;
+        self->records_alloc = alloc;
+    }
+
+    catalog_record_t record;
+    record.name_offset = s_catalog_string_add (self, asset_name);
+    record.ename_offset = s_catalog_string_add (self, ename ? ename : "");
+    record.subtype_offset = s_catalog_string_add (self, subtype ? subtype : "");
+    record.parent_offset = parent_name ? s_catalog_string_add (self, parent_name) : CATALOG_NO_PARENT;
+    if (record.name_offset == UINT32_MAX
+    ||  record.ename_offset == UINT32_MAX
+    ||  record.subtype_offset == UINT32_MAX
+    ||  (parent_name && record.parent_offset == UINT32_MAX))
+        return -1;
+
+    self->records [header->count++] = record;
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Write the catalog to a file
+int
+catalog_save (catalog_t *self, const char *path)
+{
+    assert (self);
+    assert (path);
+
+    self->header->checksum = s_catalog_checksum (self);
+
+    struct iovec parts [] = {
+        { self->header, sizeof (catalog_header_t) },
+        { self->records, self->header->count * sizeof (catalog_record_t) },
+        { self->strings, self->header->strings_size }
+    };
+    return state_write_file (path, parts, 3);
+}
+
+//  --------------------------------------------------------------------------
+//  Map the catalog file into memory
+catalog_t *
+catalog_load (const char *path)
+{
+    assert (path);
+
+    int fd = open (path, O_RDONLY);
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+    if (fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof (catalog_header_t)) {
+        log_error ("Catalog file %s is too short", path);
+        close (fd);
+        return NULL;
+    }
+
+    size_t map_size = (size_t) st.st_size;
+    void *map = mmap (NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        log_error ("Can't map catalog file %s: %m", path);
+        return NULL;
+    }
+
+    catalog_header_t *header = (catalog_header_t *) map;
+    if (memcmp (header->magic, CATALOG_MAGIC, sizeof (header->magic)) != 0
+    ||  header->version != CATALOG_VERSION
+    ||  header->strings_size > map_size
+    ||  sizeof (catalog_header_t) + (uint64_t) header->count * sizeof (catalog_record_t) + header->strings_size != map_size
+    ||  (header->strings_size > 0 && ((char *) map) [map_size - 1] != '\0'))
+    {
+        log_error ("Catalog file %s has unknown format or version", path);
+        munmap (map, map_size);
+        return NULL;
+    }
+
+    catalog_t *self = (catalog_t *) zmalloc (sizeof (catalog_t));
+    if (!self) {
+        munmap (map, map_size);
+        return NULL;
+    }
+    self->map = map;
+    self->map_size = map_size;
+    self->header = header;
+    self->records = (catalog_record_t *) ((char *) map + sizeof (catalog_header_t));
+    self->strings = (char *) (self->records + header->count);
+
+    if (s_catalog_checksum (self) != header->checksum) {
+        log_error ("Catalog file %s is damaged (checksum mismatch)", path);
+        catalog_destroy (&self);
+        return NULL;
+    }
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Return number of records
+size_t
+catalog_size (catalog_t *self)
+{
+    assert (self);
+    return self->header->count;
+}
+
+//  --------------------------------------------------------------------------
+//  Return record at index
+const catalog_record_t *
+catalog_record (catalog_t *self, size_t index)
+{
+    assert (self);
+    if (index >= self->header->count)
+        return NULL;
+    return &self->records [index];
+}
+
+//  --------------------------------------------------------------------------
+//  Return string at offset
+const char *
+catalog_string (catalog_t *self, uint32_t offset)
+{
+    assert (self);
+    if (offset == CATALOG_NO_PARENT || offset >= self->header->strings_size)
+        return NULL;
+    return self->strings + offset;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+catalog_test (bool verbose)
+{
+    ftylog_setInstance("catalog_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * catalog: \n");
+
+    //  @selftest
+    const char *path = "src/catalog_test.bin";
+
+    // save/load round trip
+    catalog_t *catalog = catalog_new ();
+    assert (catalog);
+    assert (catalog_size (catalog) == 0);
+    assert (catalog_add (catalog, "epdu-42", "ePDU in rack 1", "epdu", NULL) == 0);
+    assert (catalog_add (catalog, "sensor-7", "Temperature", "sensor", "epdu-42") == 0);
+    assert (catalog_save (catalog, path) == 0);
+    catalog_destroy (&catalog);
+
+    catalog = catalog_load (path);
+    assert (catalog);
+    assert (catalog_size (catalog) == 2);
+    const catalog_record_t *record = catalog_record (catalog, 0);
+    assert (streq (catalog_string (catalog, record->name_offset), "epdu-42"));
+    assert (streq (catalog_string (catalog, record->ename_offset), "ePDU in rack 1"));
+    assert (streq (catalog_string (catalog, record->subtype_offset), "epdu"));
+    assert (catalog_string (catalog, record->parent_offset) == NULL);
+    record = catalog_record (catalog, 1);
+    assert (streq (catalog_string (catalog, record->name_offset), "sensor-7"));
+    assert (streq (catalog_string (catalog, record->parent_offset), "epdu-42"));
+    assert (catalog_record (catalog, 2) == NULL);
+    catalog_destroy (&catalog);
+
+    // damaged file is refused
+    FILE *f = fopen (path, "r+b");
+    assert (f);
+    fseek (f, -2, SEEK_END);
+    fputc ('X', f);
+    fclose (f);
+    assert (catalog_load (path) == NULL);
+
+    // header is covered by the checksum, sizes which wrap around are refused
+    catalog = catalog_new ();
+    assert (catalog_save (catalog, path) == 0);
+    catalog_destroy (&catalog);
+    catalog_header_t bad_header;
+    f = fopen (path, "r+b");
+    assert (f);
+    assert (fread (&bad_header, sizeof (bad_header), 1, f) == 1);
+    bad_header.count = 1000;
+    bad_header.strings_size = (uint64_t) 0 - 1000 * sizeof (catalog_record_t);
+    fseek (f, 0, SEEK_SET);
+    assert (fwrite (&bad_header, sizeof (bad_header), 1, f) == 1);
+    fclose (f);
+    assert (catalog_load (path) == NULL);
+    unlink (path);
+    assert (catalog_load (path) == NULL);
+
+    // timings for a big site
+    const size_t count = 100000;
+    int64_t start = zclock_usecs ();
+    catalog = catalog_new ();
+    for (size_t i = 0; i < count; i++) {
+        char name [32], ename [32];
+        snprintf (name, sizeof (name), "ups-%zu", i);
+        snprintf (ename, sizeof (ename), "UPS %zu", i);
+        assert (catalog_add (catalog, name, ename, "ups", NULL) == 0);
+    }
+    assert (catalog_save (catalog, path) == 0);
+    int64_t saved = zclock_usecs ();
+    catalog_destroy (&catalog);
+    catalog = catalog_load (path);
+    assert (catalog);
+    assert (catalog_size (catalog) == count);
+    int64_t loaded = zclock_usecs ();
+    catalog_destroy (&catalog);
+    log_info ("%s: %zu assets: build and save %" PRIi64 " us, load %" PRIi64 " us",
+              __func__, count, saved - start, loaded - saved);
+
+    unlink (path);
+    //  @end
+    printf ("OK\n");
+}
@@ -0,0 +1,121 @@
+/*  =========================================================================
+    catalog - On-disk catalog of tracked assets
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef CATALOG_H_INCLUDED
+#define CATALOG_H_INCLUDED
+
+#include "../include/fty-outage.h"
+
+// file layout (native byte order):
+//      catalog_header_t
+//      catalog_record_t [count]
+//      strings [strings_size], zero terminated names
+#define CATALOG_MAGIC   "FTYOUTCT"
+#define CATALOG_VERSION 1
+
+// parent_offset of assets without parent device
+#define CATALOG_NO_PARENT UINT32_MAX
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _catalog_header_t {
+    char magic [8];                 // CATALOG_MAGIC, not zero terminated
+    uint32_t version;               // CATALOG_VERSION
+    uint32_t count;                 // number of records
+    uint64_t strings_size;          // [B] size of string area
+    uint64_t checksum;              // FNV-1a of header (zero checksum), records and strings
+} catalog_header_t;
+
+typedef struct _catalog_record_t {
+    uint32_t name_offset;           // offset of asset iname in string area
+    uint32_t ename_offset;          // offset of asset unicode name
+    uint32_t subtype_offset;        // offset of asset subtype
+    uint32_t parent_offset;         // offset of parent device iname, CATALOG_NO_PARENT if none
+} catalog_record_t;
+
+//  Structure of our class
+struct _catalog_t {
+    catalog_header_t *header;       // header of the catalog (mapped or built)
+    catalog_record_t *records;      // records of the catalog
+    char *strings;                  // string area
+    size_t records_alloc;           // [records] allocated while building, 0 if mapped
+    size_t strings_alloc;           // [B] allocated while building, 0 if mapped
+    void *map;                      // mapped file, NULL while building
+    size_t map_size;                // [B] size of mapped file
+};
+
+#ifndef CATALOG_T_DEFINED
+typedef struct _catalog_t catalog_t;
+#define CATALOG_T_DEFINED
+#endif
+
+//  @interface
+//  Create a new empty catalog to be filled by catalog_add
+FTY_OUTAGE_EXPORT catalog_t *
+    catalog_new (void);
+
+//  Destroy the catalog
+FTY_OUTAGE_EXPORT void
+    catalog_destroy (catalog_t **self_p);
+
+//  Append record for an asset, parent_name may be NULL
+//  return -1 on memory error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    catalog_add (catalog_t *self, const char *asset_name, const char *ename,
+                 const char *subtype, const char *parent_name);
+
+//  Write the catalog to a file
+//  data go through state_write_file, so the target is replaced atomically
+//  return -1 on error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    catalog_save (catalog_t *self, const char *path);
+
+//  Map the catalog file into memory
+//  return NULL if file is missing, damaged or of unknown version
+FTY_OUTAGE_EXPORT catalog_t *
+    catalog_load (const char *path);
+
+//  Return number of records
+FTY_OUTAGE_EXPORT size_t
+    catalog_size (catalog_t *self);
+
+//  Return record at index, NULL if out of range
+FTY_OUTAGE_EXPORT const catalog_record_t *
+    catalog_record (catalog_t *self, size_t index);
+
+//  Return string of the record at offset, NULL for CATALOG_NO_PARENT or
+//  offset out of range
+FTY_OUTAGE_EXPORT const char *
+    catalog_string (catalog_t *self, uint32_t offset);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    catalog_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -48,6 +48,7 @@ expiration_destroy (expiration_t **self_p)
     if (*self_p) {
         expiration_t *self = *self_p;
         fty_proto_destroy (&self->msg);
+        zstr_free (&self->parent);
         free (self);
         *self_p = NULL;
     }
@@ -88,11 +89,47 @@ expiration_get (expiration_t *self)
     return self->last_time_seen_sec + self->ttl_sec * 2;
 }
 
+int
+expiration_touch (expiration_t *self, const char *asset_name, uint64_t timestamp, uint64_t ttl, uint64_t now_sec)
+{
+    assert (self);
+    assert (asset_name);
+
+    FTY_OUTAGE_PROBE4 (asset__touch, asset_name, timestamp, ttl, now_sec);
+    blackbox_record (BLACKBOX_TOUCH, asset_name, timestamp, ttl);
+    // try to update ttl
+    expiration_update_ttl (self, ttl);
+    // need to compute new expiration time
+    if ( timestamp > now_sec )
+        return -1;
+    expiration_update (self, timestamp);
+    logging_debug ("asset: INFO UPDATED name='%s', last_seen=%" PRIu64 "[s], ttl= %" PRIu64 "[s], expires_at=%" PRIu64 "[s]", asset_name, self->last_time_seen_sec, self->ttl_sec, expiration_get (self));
+    return 0;
+}
+
+// subtypes of tracked devices, expiration_t refers to these strings
+static const char *s_tracked_subtypes [] = {"ups", "epdu", "sensor", "sensorgpio", "sts", NULL};
+
+static const char *
+s_tracked_subtype (const char *subtype)
+{
+    for (const char **it = s_tracked_subtypes; *it; it++) {
+        if (streq (*it, subtype))
+            return *it;
+    }
+    return NULL;
+}
+
 void ename_destroy(void **ptr)
 {
     free (*ptr);
 }
 
+void children_destroy(void **ptr)
+{
+    zhashx_destroy ((zhashx_t **) ptr);
+}
+
 //  --------------------------------------------------------------------------
 //  Destroy the data
 void
@@ -103,6 +140,9 @@ data_destroy (data_t **self_p)
         data_t *self = *self_p;
         zhashx_destroy(&self -> assets);
         zhashx_destroy(&self -> asset_enames);
+        zhashx_destroy(&self -> children);
+        zhashx_destroy(&self -> restored);
+        deadline_destroy (&self->maintenance);
         free (self);
         *self_p = NULL;
     }
@@ -122,6 +162,26 @@ data_new (void)
         }
         zhashx_set_destructor (self -> asset_enames,  (zhashx_destructor_fn *) ename_destroy);
 
+        self -> children = zhashx_new();
+        if ( !self->children ) {
+            data_destroy (&self);
+            return NULL;
+        }
+        zhashx_set_destructor (self -> children,  (zhashx_destructor_fn *) children_destroy);
+
+        self -> restored = zhashx_new();
+        if ( !self->restored ) {
+            data_destroy (&self);
+            return NULL;
+        }
+        zhashx_set_destructor (self -> restored,  (zhashx_destructor_fn *) expiration_destroy);
+
+        self -> maintenance = deadline_new ();
+        if ( !self->maintenance ) {
+            data_destroy (&self);
+            return NULL;
+        }
+
         self -> assets = zhashx_new();
         if ( self->assets ) {
             self->default_expiry_sec = DEFAULT_ASSET_EXPIRATION_TIME_SEC;
@@ -141,6 +201,16 @@ data_get_asset_ename (data_t *self, const char *asset_name)
 
 }
 
+//  ------------------------------------------------------------------------
+//  Return expiration of the asset, NULL if asset is not tracked
+expiration_t*
+data_lookup (data_t *self, const char *asset_name)
+{
+    assert (self);
+    assert (asset_name);
+    return (expiration_t *) zhashx_lookup (self->assets, asset_name);
+}
+
 //  ------------------------------------------------------------------------
 //  Return default number of seconds in that newly added asset would expire
 uint64_t
@@ -176,16 +246,50 @@ data_touch_asset (data_t *self, const char *asset_name, uint64_t timestamp, uint
     }
 
     // we know information about this asset
-    // try to update ttl
-    expiration_update_ttl (e, ttl);
-    // need to compute new expiration time
-    if ( timestamp > now_sec )
-        return -1;
-    else {
-        expiration_update (e, timestamp);
-        log_debug ("asset: INFO UPDATED name='%s', last_seen=%" PRIu64 "[s], ttl= %" PRIu64 "[s], expires_at=%" PRIu64 "[s]", asset_name, e->last_time_seen_sec, e->ttl_sec, expiration_get (e));
+    return expiration_touch (e, asset_name, timestamp, ttl, now_sec);
+}
+
+// add asset to the cache if not present, takes ownership of the message
+// (NULL for assets from the catalog), return NULL on memory error
+static expiration_t *
+s_data_add (data_t *self, const char *asset_name, const char *ename,
+            const char *subtype, const char *parent_name, fty_proto_t **proto_p)
+{
+    const char *old_ename = (const char *) zhashx_lookup (self->asset_enames, asset_name);
+    if (!old_ename || !streq (old_ename, ename ? ename : "")) {
+        zhashx_update (self->asset_enames, asset_name, (void*) strdup (ename ? ename : ""));
+        self->changed = true;
     }
-    return 0;
+
+    // this asset is not known yet -> add it to the cache
+    expiration_t *e = (expiration_t *) zhashx_lookup (self->assets, asset_name );
+    if ( e == NULL ) {
+        e = expiration_new (self->default_expiry_sec, proto_p);
+        if (!e)
+            return NULL;
+        e->subtype = s_tracked_subtype (subtype);
+        expiration_t *restored = (expiration_t *) zhashx_lookup (self->restored, asset_name);
+        if (restored) {
+            // times saved before restart, detection goes on where it stopped
+            e->ttl_sec = restored->ttl_sec;
+            expiration_update (e, restored->last_time_seen_sec);
+            e->maintenance_until_sec = restored->maintenance_until_sec;
+            zhashx_delete (self->restored, asset_name);
+            if (e->maintenance_until_sec)
+                deadline_push (self->maintenance, asset_name, e->maintenance_until_sec);
+        }
+        else {
+            uint64_t now_sec = vclock_time () / 1000;
+            expiration_update (e, now_sec);
+        }
+        logging_debug ("asset: ADDED name='%s', last_seen=%" PRIu64 "[s], ttl= %" PRIu64 "[s], expires_at=%" PRIu64 "[s]", asset_name, e->last_time_seen_sec, e->ttl_sec, expiration_get (e));
+        zhashx_update (self->assets, asset_name, e);
+        self->changed = true;
+    }
+    // So, if we already knew this asset -> only the link to parent may change
+    if (parent_name)
+        data_set_parent (self, asset_name, parent_name);
+    return e;
 }
 
 //  ------------------------------------------------------------------------
@@ -208,7 +312,7 @@ data_put (data_t *self, fty_proto_t **proto_p)
     const char *operation = fty_proto_operation (proto);
     const char *asset_name = fty_proto_name (proto);
 
-    log_debug ("Received asset: name=%s, operation=%s", asset_name, operation);
+    logging_debug ("Received asset: name=%s, operation=%s", asset_name, operation);
 
     // remove asset from cache
     const char* sub_type = fty_proto_aux_string (proto, FTY_PROTO_ASSET_SUBTYPE, "");
@@ -218,42 +322,71 @@ data_put (data_t *self, fty_proto_t **proto_p)
     )
     {
         data_delete (self, asset_name);
-        log_debug ("asset: DELETED name=%s, operation=%s", asset_name, operation);
+        logging_debug ("asset: DELETED name=%s, operation=%s", asset_name, operation);
         fty_proto_destroy (proto_p);
     }
     else
     // other asset operations - add ups, epdu or sensors to the cache if not present
     if (    streq (fty_proto_aux_string (proto, FTY_PROTO_ASSET_TYPE, ""), "device" )
-         && (   streq (sub_type, "ups")
-             || streq (sub_type, "epdu")
-             || streq (sub_type, "sensor")
-             || streq (sub_type, "sensorgpio")
-             || streq (sub_type, "sts")
-            )
+         && s_tracked_subtype (sub_type)
        )
     {
-        zhashx_update (self->asset_enames, asset_name, (void*) strdup(fty_proto_ext_string (proto, "name", "")));
-
-        // this asset is not known yet -> add it to the cache
-        expiration_t *e = (expiration_t *) zhashx_lookup (self->assets, asset_name );
-        if ( e == NULL ) {
-            e = expiration_new (self->default_expiry_sec, proto_p);
-            uint64_t now_sec = zclock_time() / 1000;
-            expiration_update (e, now_sec);
-            log_debug ("asset: ADDED name='%s', last_seen=%" PRIu64 "[s], ttl= %" PRIu64 "[s], expires_at=%" PRIu64 "[s]", asset_name, e->last_time_seen_sec, e->ttl_sec, expiration_get (e));
-            zhashx_update (self->assets, asset_name, e);
-        }
-        else {
-            fty_proto_destroy (proto_p);
-            // intentionally left empty
-            // So, if we already knew this asset -> nothing to do
+        // sensors are reachable only through the device they are attached to
+        const char *parent_name = NULL;
+        if (streq (sub_type, "sensor") || streq (sub_type, "sensorgpio"))
+            parent_name = fty_proto_aux_string (proto, "parent_name.1", NULL);
+        char *parent = parent_name ? strdup (parent_name) : NULL;
+        char *name = strdup (asset_name);
+
+        expiration_t *e = s_data_add (self, name, fty_proto_ext_string (proto, "name", ""), sub_type, parent, proto_p);
+        if (e) {
+            e->announced = true;
+            FTY_OUTAGE_PROBE2 (asset__add, name, sub_type);
+            blackbox_record (BLACKBOX_ASSET_ADD, name, 0, 0);
         }
+        fty_proto_destroy (proto_p);
+        zstr_free (&name);
+        zstr_free (&parent);
     }
     else {
         fty_proto_destroy (proto_p);
     }
 }
 
+//  ------------------------------------------------------------------------
+//  add asset from the catalog
+int
+data_add_asset (data_t *self, const char *asset_name, const char *ename,
+                const char *subtype, const char *parent_name)
+{
+    assert (self);
+    assert (asset_name);
+    assert (subtype);
+
+    if (!s_tracked_subtype (subtype))
+        return -1;
+    fty_proto_t *msg = NULL;
+    return s_data_add (self, asset_name, ename, subtype, parent_name, &msg) ? 0 : -1;
+}
+
+//  ------------------------------------------------------------------------
+//  return true if tracked assets changed
+bool
+data_changed (data_t *self)
+{
+    assert (self);
+    return self->changed;
+}
+
+//  ------------------------------------------------------------------------
+//  mark tracked assets as saved to the catalog
+void
+data_clear_changed (data_t *self)
+{
+    assert (self);
+    self->changed = false;
+}
+
 // --------------------------------------------------------------------------
 // delete from cache
 void
@@ -262,7 +395,214 @@ data_delete (data_t *self, const char* source)
     assert (self);
     assert (source);
 
+    expiration_t *e = (expiration_t *) zhashx_lookup (self->assets, source);
+    if (e && e->parent)
+        data_set_parent (self, source, NULL);
+    if (e) {
+        self->changed = true;
+        FTY_OUTAGE_PROBE1 (asset__delete, source);
+        blackbox_record (BLACKBOX_ASSET_DELETE, source, 0, 0);
+    }
+
+    // children are not reachable through this asset anymore
+    zhashx_t *children = (zhashx_t *) zhashx_lookup (self->children, source);
+    if (children) {
+        for (void *it = zhashx_first (children);
+                   it != NULL;
+                   it = zhashx_next (children))
+        {
+            expiration_t *child = (expiration_t *) zhashx_lookup (self->assets, zhashx_cursor (children));
+            if (child)
+                zstr_free (&child->parent);
+        }
+        zhashx_delete (self->children, source);
+    }
+
     zhashx_delete (self->assets, source);
+    zhashx_delete (self->asset_enames, source);
+    zhashx_delete (self->restored, source);
+}
+
+// --------------------------------------------------------------------------
+// remember last seen time and ttl of the asset from saved state
+void
+data_restore (data_t *self, const char *asset_name, uint64_t last_time_seen_sec, uint64_t ttl_sec,
+              uint64_t maintenance_until_sec)
+{
+    assert (self);
+    assert (asset_name);
+
+    expiration_t *e = (expiration_t *) zhashx_lookup (self->assets, asset_name);
+    if (e) {
+        expiration_update_ttl (e, ttl_sec);
+        expiration_update (e, last_time_seen_sec);
+        data_set_maintenance (self, asset_name, maintenance_until_sec);
+        return;
+    }
+
+    fty_proto_t *msg = NULL;
+    e = expiration_new (ttl_sec, &msg);
+    if (!e)
+        return;
+    e->last_time_seen_sec = last_time_seen_sec;
+    e->maintenance_until_sec = maintenance_until_sec;
+    zhashx_update (self->restored, asset_name, e);
+}
+
+// --------------------------------------------------------------------------
+// put asset into maintenance until until_sec, 0 ends the maintenance
+int
+data_set_maintenance (data_t *self, const char *asset_name, uint64_t until_sec)
+{
+    assert (self);
+    assert (asset_name);
+
+    expiration_t *e = (expiration_t *) zhashx_lookup (self->assets, asset_name);
+    if (!e) {
+        // index is filled once the restored asset is put
+        e = (expiration_t *) zhashx_lookup (self->restored, asset_name);
+        if (!e)
+            return -1;
+        e->maintenance_until_sec = until_sec;
+        return 0;
+    }
+
+    if (e->maintenance_until_sec == until_sec)
+        return 0;
+    // previous deadline stays in the index, it does not match anymore
+    e->maintenance_until_sec = until_sec;
+    if (until_sec && deadline_push (self->maintenance, asset_name, until_sec) != 0)
+        log_error ("asset: can't index end of maintenance of '%s' (memory error)", asset_name);
+    return 0;
+}
+
+// --------------------------------------------------------------------------
+// end maintenance windows, which are over at now_sec
+zlistx_t *
+data_expire_maintenance (data_t *self, uint64_t now_sec)
+{
+    assert (self);
+
+    zlistx_t *expired = zlistx_new ();
+    if (!expired)
+        return NULL;
+    zlistx_set_destructor (expired, (zlistx_destructor_fn *) zstr_free);
+
+    uint64_t until_sec;
+    char *asset_name;
+    while ((asset_name = deadline_pop (self->maintenance, now_sec, &until_sec)) != NULL) {
+        expiration_t *e = (expiration_t *) zhashx_lookup (self->assets, asset_name);
+        if (e && e->maintenance_until_sec == until_sec) {
+            // device gets whole ttl to report itself after maintenance
+            e->maintenance_until_sec = 0;
+            expiration_update (e, now_sec);
+            zlistx_add_end (expired, asset_name);
+        }
+        else
+            // deleted asset, cancelled or prolonged maintenance
+            zstr_free (&asset_name);
+    }
+    return expired;
+}
+
+// --------------------------------------------------------------------------
+// forget restored assets, which were deleted while we were not running
+zlistx_t *
+data_restore_check (data_t *self, zhashx_t *listed)
+{
+    assert (self);
+    assert (listed);
+
+    zlistx_t *deleted = zlistx_new ();
+    if (!deleted)
+        return NULL;
+    zlistx_set_destructor (deleted, (zlistx_destructor_fn *) zstr_free);
+    zlistx_set_duplicator (deleted, (zlistx_duplicator_fn *) strdup);
+
+    // restored times of assets, which will never be put
+    for (void *it = zhashx_first (self->restored); it != NULL; it = zhashx_next (self->restored)) {
+        if (!zhashx_lookup (listed, (const char *) zhashx_cursor (self->restored)))
+            zlistx_add_end (deleted, (void *) zhashx_cursor (self->restored));
+    }
+    for (void *it = zlistx_first (deleted); it != NULL; it = zlistx_next (deleted))
+        zhashx_delete (self->restored, (const char *) it);
+    if (zlistx_size (deleted) > 0)
+        log_debug ("asset: %zu restored assets do not exist anymore, forgetting them", zlistx_size (deleted));
+    zlistx_purge (deleted);
+
+    // assets from the catalog; announced ones are deleted by stream messages
+    for (expiration_t *e = (expiration_t *) zhashx_first (self->assets);
+                       e != NULL;
+                       e = (expiration_t *) zhashx_next (self->assets))
+    {
+        if (!e->announced && !zhashx_lookup (listed, (const char *) zhashx_cursor (self->assets)))
+            zlistx_add_end (deleted, (void *) zhashx_cursor (self->assets));
+    }
+    for (void *it = zlistx_first (deleted); it != NULL; it = zlistx_next (deleted))
+        data_delete (self, (const char *) it);
+    if (zlistx_size (deleted) > 0)
+        log_debug ("asset: %zu assets from catalog do not exist anymore, deleting them", zlistx_size (deleted));
+    return deleted;
+}
+
+// --------------------------------------------------------------------------
+// link asset to its parent device, NULL parent_name removes the link
+void
+data_set_parent (data_t *self, const char *asset_name, const char *parent_name)
+{
+    assert (self);
+    assert (asset_name);
+
+    expiration_t *e = (expiration_t *) zhashx_lookup (self->assets, asset_name);
+    if (!e)
+        return;
+    if (e->parent && parent_name && streq (e->parent, parent_name))
+        return;
+
+    if (e->parent) {
+        zhashx_t *children = (zhashx_t *) zhashx_lookup (self->children, e->parent);
+        if (children) {
+            zhashx_delete (children, asset_name);
+            if (zhashx_size (children) == 0)
+                zhashx_delete (self->children, e->parent);
+        }
+        zstr_free (&e->parent);
+    }
+    self->changed = true;
+
+    if (parent_name) {
+        zhashx_t *children = (zhashx_t *) zhashx_lookup (self->children, parent_name);
+        if (!children) {
+            children = zhashx_new ();
+            zhashx_insert (self->children, parent_name, children);
+        }
+        zhashx_update (children, asset_name, (void *) "");
+        e->parent = strdup (parent_name);
+        log_debug ("asset: LINKED name='%s' to parent='%s'", asset_name, parent_name);
+    }
+}
+
+// --------------------------------------------------------------------------
+// return parent device of the asset
+const char *
+data_get_parent (data_t *self, const char *asset_name)
+{
+    assert (self);
+    assert (asset_name);
+
+    expiration_t *e = (expiration_t *) zhashx_lookup (self->assets, asset_name);
+    return e ? e->parent : NULL;
+}
+
+// --------------------------------------------------------------------------
+// return set of children of the asset
+zhashx_t *
+data_get_children (data_t *self, const char *parent_name)
+{
+    assert (self);
+    assert (parent_name);
+
+    return (zhashx_t *) zhashx_lookup (self->children, parent_name);
 }
 
 // --------------------------------------------------------------------------
@@ -289,25 +629,36 @@ convert_port (const char *old_port)
 // get non-responding devices
 zlistx_t *
 data_get_dead (data_t *self)
+{
+    return data_get_dead_at (self, vclock_time () / 1000);
+}
+
+//  ------------------------------------------------------------------------
+//  Returns list of devices nonresponding at now_sec
+zlistx_t *
+data_get_dead_at (data_t *self, uint64_t now_sec)
 {
     assert (self);
     // list of devices
     zlistx_t *dead = zlistx_new();
 
-    uint64_t now_sec = zclock_time() / 1000;
-    log_debug ("now=%" PRIu64 "s", now_sec);
+    FTY_OUTAGE_PROBE1 (sweep__start, zhashx_size (self->assets));
+    logging_debug ("now=%" PRIu64 "s", now_sec);
     for (expiration_t *e =  (expiration_t *) zhashx_first (self->assets);
         e != NULL;
         e = (expiration_t *) zhashx_next (self->assets))
     {
         void *asset_name = (void*) zhashx_cursor(self->assets);
-        log_debug ("asset: name=%s, ttl=%" PRIu64 ", expires_at=%" PRIu64, asset_name, e->ttl_sec, expiration_get (e));
+        logging_debug ("asset: name=%s, ttl=%" PRIu64 ", expires_at=%" PRIu64, asset_name, e->ttl_sec, expiration_get (e));
+        if (e->maintenance_until_sec > now_sec)
+            continue;
         if ( expiration_get (e) <= now_sec)
         {
             assert(zlistx_add_start (dead, asset_name));
         }
     }
 
+    FTY_OUTAGE_PROBE2 (sweep__end, zhashx_size (self->assets), zlistx_size (dead));
     return dead;
 }
 
@@ -363,15 +714,15 @@ void test3 (bool verbose)
 
     fty_proto_t *msg = fty_proto_new (FTY_PROTO_ASSET);
     expiration_t *e = expiration_new (10, &msg);
-    zclock_sleep (1000);
+    vclock_sleep (1000);
 
     uint64_t old_last_seen_date = e->last_time_seen_sec;
-    expiration_update (e, zclock_time() / 1000);
+    expiration_update (e, vclock_time () / 1000);
     assert ( e->last_time_seen_sec != old_last_seen_date );
 
     // from past!!
     old_last_seen_date = e->last_time_seen_sec;
-    expiration_update (e, zclock_time() / 1000 - 10000);
+    expiration_update (e, vclock_time () / 1000 - 10000);
     assert ( e->last_time_seen_sec == old_last_seen_date );
 
     expiration_update_ttl (e, 1);
@@ -400,6 +751,9 @@ data_test (bool verbose)
     }
     printf (" * data: \n");
 
+    // expiration is tested in simulated time, without waiting
+    vclock_set_virtual (zclock_time ());
+
     test0 (verbose);
 
     test2 (verbose);
@@ -441,14 +795,14 @@ data_test (bool verbose)
     zhash_destroy (&asset_aux);
 
     // create new metric UPS4 - exp NOK
-    uint64_t now_sec = zclock_time() / 1000;
+    uint64_t now_sec = vclock_time () / 1000;
     int rv = data_touch_asset(data, "UPS4", now_sec, 3, now_sec);
 
     // create new metric UPS3 - exp NOT OK
-    now_sec = zclock_time() / 1000;
+    now_sec = vclock_time () / 1000;
     rv = data_touch_asset(data, "UPS3", now_sec, 1, now_sec);
 
-    zclock_sleep (5000);
+    vclock_sleep (5000);
     // give me dead devices
     zlistx_t *list = data_get_dead(data);
     if (verbose)
@@ -458,7 +812,7 @@ data_test (bool verbose)
     zlistx_destroy (&list);
 
     // update metric - exp OK
-    now_sec = zclock_time() / 1000;
+    now_sec = vclock_time () / 1000;
     rv = data_touch_asset(data, "UPS4", now_sec, 2, now_sec);
     assert ( rv == 0 );
 
@@ -481,7 +835,7 @@ data_test (bool verbose)
     data_put (data, &bmsg);
 
     assert (zhashx_lookup (data->assets, "PDU1"));
-    now_sec = zclock_time() / 1000;
+    now_sec = vclock_time () / 1000;
     uint64_t diff = zhashx_get_expiration_test (data, (char*)"PDU1") - now_sec;
     if (verbose)
         log_debug ("diff=%" PRIi64, diff);
@@ -490,11 +844,149 @@ data_test (bool verbose)
 
     assert (streq (data_get_asset_ename (data, "PDU1"),"ename_of_pdu1"));
 
+    // lookup test
+    expiration_t *e = data_lookup (data, "PDU1");
+    assert (e);
+    assert (!e->alert_active);
+    assert (data_lookup (data, "PDU-unknown") == NULL);
+    now_sec = vclock_time () / 1000;
+    assert (expiration_touch (e, "PDU1", now_sec + 100, 1, now_sec) == -1);
+    assert (e->ttl_sec == 1);
+    assert (expiration_touch (e, "PDU1", now_sec, 1, now_sec) == 0);
+    assert (e->last_time_seen_sec == now_sec);
+
+    // topology test
+    zhash_destroy (&aux);
+    aux = zhash_new ();
+    zhash_insert (aux, "status", (void*)"active");
+    zhash_insert (aux, "type", (void*)"device");
+    zhash_insert (aux, FTY_PROTO_ASSET_SUBTYPE, (void*)"sensor");
+    zhash_insert (aux, "parent_name.1", (void*)"PDU1");
+    msg = fty_proto_encode_asset (aux, "SENSOR1", FTY_PROTO_ASSET_OP_CREATE, NULL);
+    bmsg = fty_proto_decode (&msg);
+    data_put (data, &bmsg);
+    zhash_destroy (&aux);
+
+    assert (streq (data_get_parent (data, "SENSOR1"), "PDU1"));
+    assert (data_get_parent (data, "PDU1") == NULL);
+    zhashx_t *children = data_get_children (data, "PDU1");
+    assert (children && zhashx_size (children) == 1);
+    assert (zhashx_lookup (children, "SENSOR1"));
+
+    // sensor metric may move the sensor to another device
+    data_set_parent (data, "SENSOR1", "UPS4");
+    assert (streq (data_get_parent (data, "SENSOR1"), "UPS4"));
+    assert (data_get_children (data, "PDU1") == NULL);
+    assert (zhashx_lookup (data_get_children (data, "UPS4"), "SENSOR1"));
+
+    // deleted parent unlinks its children
+    data_delete (data, "UPS4");
+    assert (data_get_children (data, "UPS4") == NULL);
+    assert (data_get_parent (data, "SENSOR1") == NULL);
+    data_set_parent (data, "SENSOR1", "PDU1");
+    data_delete (data, "SENSOR1");
+    assert (data_get_children (data, "PDU1") == NULL);
+
+    // restored times are applied when the asset is put
+    now_sec = vclock_time () / 1000;
+    data_restore (data, "UPS5", now_sec - 100, 10, 0);
+    data_restore (data, "UPS6", now_sec - 100, 10, 0);
+    assert (data_lookup (data, "UPS5") == NULL);
+    zhash_destroy (&aux);
+    aux = zhash_new ();
+    zhash_insert (aux, "type", (void*)"device");
+    zhash_insert (aux, FTY_PROTO_ASSET_SUBTYPE, (void*)"ups");
+    msg = fty_proto_encode_asset (aux, "UPS5", FTY_PROTO_ASSET_OP_CREATE, NULL);
+    bmsg = fty_proto_decode (&msg);
+    data_put (data, &bmsg);
+    e = data_lookup (data, "UPS5");
+    assert (e);
+    assert (e->last_time_seen_sec == now_sec - 100);
+    assert (e->ttl_sec == 10);
+    assert (zhashx_lookup (data->restored, "UPS5") == NULL);
+    // dead right after restart, without waiting for a whole expiry
+    zlistx_destroy (&list);
+    list = data_get_dead (data);
+    bool found = false;
+    for (void *it = zlistx_first (list); it != NULL; it = zlistx_next (list))
+        found = found || streq ((char *) it, "UPS5");
+    assert (found);
+    // deleted asset does not keep its restored times
+    data_delete (data, "UPS6");
+    assert (zhashx_size (data->restored) == 0);
+    data_restore (data, "UPS6", now_sec - 100, 10, 0);
+    data_restore (data, "UPS8", now_sec - 100, 10, 0);
+    zhashx_t *listed = zhashx_new ();
+    zhashx_insert (listed, "UPS5", (void *) "");
+    zhashx_insert (listed, "UPS8", (void *) "");
+    zlistx_t *deleted = data_restore_check (data, listed);
+    assert (deleted && zlistx_size (deleted) == 0);
+    zlistx_destroy (&deleted);
+    // restored times of existing assets are kept until they are announced
+    assert (zhashx_size (data->restored) == 1);
+    assert (zhashx_lookup (data->restored, "UPS8"));
+    zhashx_delete (data->restored, "UPS8");
+
+    // assets from the catalog are tracked until they turn out to be deleted
+    data_clear_changed (data);
+    assert (data_add_asset (data, "ROZ1", "ename_of_roz1", "rack controller", NULL) == -1);
+    assert (data_add_asset (data, "UPS7", "ename_of_ups7", "ups", NULL) == 0);
+    assert (data_add_asset (data, "SENSOR7", "ename_of_sensor7", "sensor", "UPS7") == 0);
+    assert (data_changed (data));
+    e = data_lookup (data, "UPS7");
+    assert (e && !e->announced);
+    assert (streq (e->subtype, "ups"));
+    assert (streq (data_get_asset_ename (data, "UPS7"), "ename_of_ups7"));
+    assert (streq (data_get_parent (data, "SENSOR7"), "UPS7"));
+    assert (data_add_asset (data, "UPS9", "ename_of_ups9", "ups", NULL) == 0);
+    // UPS7 is announced, SENSOR7 and UPS9 are not, UPS9 still exists
+    msg = fty_proto_encode_asset (aux, "UPS7", FTY_PROTO_ASSET_OP_CREATE, NULL);
+    bmsg = fty_proto_decode (&msg);
+    data_put (data, &bmsg);
+    assert (data_lookup (data, "UPS7")->announced);
+    zhashx_insert (listed, "UPS9", (void *) "");
+    deleted = data_restore_check (data, listed);
+    assert (deleted && zlistx_size (deleted) == 1);
+    assert (streq ((char *) zlistx_first (deleted), "SENSOR7"));
+    zlistx_destroy (&deleted);
+    zhashx_destroy (&listed);
+    assert (data_lookup (data, "UPS7"));
+    assert (data_lookup (data, "UPS9"));
+    data_delete (data, "UPS9");
+    assert (data_lookup (data, "SENSOR7") == NULL);
+    assert (data_get_asset_ename (data, "SENSOR7") == NULL);
+    assert (data_get_children (data, "UPS7") == NULL);
+
+    // assets in maintenance are not dead, until the maintenance is over
+    now_sec = vclock_time () / 1000;
+    e = data_lookup (data, "UPS5");
+    assert (data_set_maintenance (data, "UPS-unknown", now_sec + 100) == -1);
+    assert (data_set_maintenance (data, "UPS5", now_sec + 100) == 0);
+    // prolonged maintenance leaves a stale entry in the index
+    assert (data_set_maintenance (data, "UPS5", now_sec + 200) == 0);
+    assert (deadline_size (data->maintenance) == 2);
+    zlistx_destroy (&list);
+    list = data_get_dead (data);
+    for (void *it = zlistx_first (list); it != NULL; it = zlistx_next (list))
+        assert (!streq ((char *) it, "UPS5"));
+    zlistx_t *expired = data_expire_maintenance (data, now_sec + 150);
+    assert (expired && zlistx_size (expired) == 0);
+    zlistx_destroy (&expired);
+    assert (e->maintenance_until_sec == now_sec + 200);
+    expired = data_expire_maintenance (data, now_sec + 200);
+    assert (expired && zlistx_size (expired) == 1);
+    assert (streq ((char *) zlistx_first (expired), "UPS5"));
+    zlistx_destroy (&expired);
+    assert (e->maintenance_until_sec == 0);
+    assert (e->last_time_seen_sec == now_sec + 200);
+    assert (deadline_size (data->maintenance) == 0);
+
     zlistx_destroy(&list);
     fty_proto_destroy(&proto_n);
     zhash_destroy(&aux);
     zhash_destroy(&ext);
     data_destroy (&data);
+    vclock_set_real ();
 
     //  @end
     printf ("OK\n");
@@ -36,6 +36,10 @@ extern "C" {
 struct _data_t {
     zhashx_t *assets;            // asset_name => expiration time [s]
     zhashx_t *asset_enames;      // asset iname => asset ename (unicode name)
+    zhashx_t *children;          // parent iname => zhashx_t set of child inames (sensors on ePDU/UPS)
+    zhashx_t *restored;          // asset iname => expiration_t restored from saved state, until the asset is put
+    bool changed;                // tracked assets changed since data_clear_changed (catalog is out of date)
+    deadline_t *maintenance;     // ends of maintenance windows
     uint64_t default_expiry_sec; // [s] default time for the asset, in what asset would be considered as not responding
 };
 
@@ -74,10 +78,69 @@ FTY_OUTAGE_EXPORT void
 FTY_OUTAGE_EXPORT void
     data_delete (data_t *self, const char* source);
 
+//  Add asset from the catalog, it is not considered announced until it is
+//  put again, parent_name may be NULL
+//  return -1 if subtype is not tracked or on memory error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    data_add_asset (data_t *self, const char *asset_name, const char *ename,
+                    const char *subtype, const char *parent_name);
+
+//  Return true if tracked assets changed since the last data_clear_changed
+FTY_OUTAGE_EXPORT bool
+    data_changed (data_t *self);
+
+//  Mark tracked assets as saved to the catalog
+FTY_OUTAGE_EXPORT void
+    data_clear_changed (data_t *self);
+
+//  Link asset to its parent device (sensor -> ePDU/UPS)
+//  NULL parent_name removes the link
+FTY_OUTAGE_EXPORT void
+    data_set_parent (data_t *self, const char *asset_name, const char *parent_name);
+
+//  Return parent device of the asset, NULL if there is none
+FTY_OUTAGE_EXPORT const char *
+    data_get_parent (data_t *self, const char *asset_name);
+
+//  Return set of children of the asset (keys are inames), NULL if there is none
+//  Returned hash is a reference owned by data
+FTY_OUTAGE_EXPORT zhashx_t *
+    data_get_children (data_t *self, const char *parent_name);
+
+//  Remember last seen time, ttl and end of maintenance of the asset from
+//  saved state, they are applied once the asset is put (or right away if it
+//  is known already)
+FTY_OUTAGE_EXPORT void
+    data_restore (data_t *self, const char *asset_name, uint64_t last_time_seen_sec, uint64_t ttl_sec,
+                  uint64_t maintenance_until_sec);
+
+//  Check assets restored from saved state and catalog against listed (keys
+//  are inames of existing assets): forget restored times and delete assets
+//  added from the catalog, which were not announced since and are not listed
+//  return list of deleted assets, caller is responsible to destroy it
+FTY_OUTAGE_EXPORT zlistx_t *
+    data_restore_check (data_t *self, zhashx_t *listed);
+
+//  Put asset into maintenance until until_sec, 0 ends the maintenance
+//  return -1 if asset is not known, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    data_set_maintenance (data_t *self, const char *asset_name, uint64_t until_sec);
+
+//  End maintenance windows, which are over at now_sec
+//  return list of assets back from maintenance, caller is responsible to
+//  destroy it
+FTY_OUTAGE_EXPORT zlistx_t *
+    data_expire_maintenance (data_t *self, uint64_t now_sec);
+
 //  Returns list of nonresponding devices, zlistx entries are refereces
+//  assets in maintenance are never considered as nonresponding
 FTY_OUTAGE_EXPORT zlistx_t *
     data_get_dead (data_t *self);
 
+//  Returns list of devices nonresponding at now_sec [s], see data_get_dead
+FTY_OUTAGE_EXPORT zlistx_t *
+    data_get_dead_at (data_t *self, uint64_t now_sec);
+
 //  update information about expiration time
 //  return -1, if data are from future and are ignored as damaging
 //  return 0 otherwise
@@ -93,6 +156,11 @@ typedef struct _expiration_t {
     uint64_t ttl_sec;                      // [s] minimal ttl seen for some asset
     uint64_t last_time_seen_sec;           // [s] time when  some metrics were seen for this asset
     fty_proto_t *msg;                      // asset representation
+    bool alert_active;                     // outage alert is tracked for this asset (mirrors server's active_alerts)
+    char *parent;                          // iname of parent device, the asset is reachable through (or NULL)
+    const char *subtype;                   // one of tracked subtypes (static string)
+    bool announced;                        // put since start, false for assets from the catalog
+    uint64_t maintenance_until_sec;        // [s] end of maintenance window, 0 if not in maintenance
 } expiration_t;
 
 //  Create a new expiration
@@ -115,6 +183,16 @@ expiration_update_ttl (expiration_t *self, uint64_t proposed_ttl);
 FTY_OUTAGE_EXPORT uint64_t
 expiration_get (expiration_t *self);
 
+//  update information about expiration time of already looked up asset
+//  return -1, if data are from future and are ignored as damaging
+//  return 0 otherwise
+FTY_OUTAGE_EXPORT int
+expiration_touch (expiration_t *self, const char *asset_name, uint64_t timestamp, uint64_t ttl, uint64_t now_sec);
+
+//  Return expiration of the asset, NULL if asset is not tracked
+FTY_OUTAGE_EXPORT expiration_t*
+data_lookup (data_t *self, const char *asset_name);
+
 //  @end
 
 #ifdef __cplusplus
@@ -0,0 +1,223 @@
+/*  =========================================================================
+    deadline - Deadline-ordered index of assets
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    deadline - Deadline-ordered index of assets
+@discuss
+    Binary min-heap of (deadline, asset) pairs, so the earliest deadline is
+    found in O(1) and due entries are removed in O(log n) each, whatever
+    the number of assets. Entries are never changed in place: a changed or
+    cancelled deadline leaves a stale entry behind, which is recognized by
+    the caller when popped.
+@end
+*/
+
+#include "fty_outage_classes.h"
+
+static void
+s_swap (deadline_entry_t *a, deadline_entry_t *b)
+{
+    deadline_entry_t tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+//  --------------------------------------------------------------------------
+//  Create a new empty index
+deadline_t *
+deadline_new (void)
+{
+    deadline_t *self = (deadline_t *) zmalloc (sizeof (deadline_t));
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the index
+void
+deadline_destroy (deadline_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        deadline_t *self = *self_p;
+        for (size_t i = 0; i < self->size; i++)
+            free (self->heap [i].name);
+        free (self->heap);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Add deadline of the asset
+int
+deadline_push (deadline_t *self, const char *name, uint64_t time_sec)
+{
+    assert (self);
+    assert (name);
+
+    if (self->size == self->alloc) {
+        size_t alloc = self->alloc ? self->alloc * 2 : 64;
+        deadline_entry_t *heap = (deadline_entry_t *) realloc (self->heap, alloc * sizeof (deadline_entry_t));
+        if (!heap)
+            return -1;
+        self->heap = heap;
+        self->alloc = alloc;
+    }
+    char *copy = strdup (name);
+    if (!copy)
+        return -1;
+
+    size_t i = self->size++;
+    self->heap [i].time_sec = time_sec;
+    self->heap [i].name = copy;
+    // sift up
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (self->heap [parent].time_sec <= self->heap [i].time_sec)
+            break;
+        s_swap (&self->heap [parent], &self->heap [i]);
+        i = parent;
+    }
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Return the earliest deadline
+uint64_t
+deadline_next (deadline_t *self)
+{
+    assert (self);
+    return self->size > 0 ? self->heap [0].time_sec : 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Remove the earliest entry, if it is due
+char *
+deadline_pop (deadline_t *self, uint64_t now_sec, uint64_t *time_sec_p)
+{
+    assert (self);
+
+    if (self->size == 0 || self->heap [0].time_sec > now_sec)
+        return NULL;
+
+    char *name = self->heap [0].name;
+    if (time_sec_p)
+        *time_sec_p = self->heap [0].time_sec;
+    self->heap [0] = self->heap [--self->size];
+    // sift down
+    size_t i = 0;
+    while (true) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < self->size && self->heap [left].time_sec < self->heap [smallest].time_sec)
+            smallest = left;
+        if (right < self->size && self->heap [right].time_sec < self->heap [smallest].time_sec)
+            smallest = right;
+        if (smallest == i)
+            break;
+        s_swap (&self->heap [smallest], &self->heap [i]);
+        i = smallest;
+    }
+    return name;
+}
+
+//  --------------------------------------------------------------------------
+//  Return number of entries
+size_t
+deadline_size (deadline_t *self)
+{
+    assert (self);
+    return self->size;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+deadline_test (bool verbose)
+{
+    ftylog_setInstance("deadline_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * deadline: \n");
+
+    //  @selftest
+    deadline_t *deadline = deadline_new ();
+    assert (deadline);
+    assert (deadline_size (deadline) == 0);
+    assert (deadline_next (deadline) == 0);
+    assert (deadline_pop (deadline, 1000, NULL) == NULL);
+
+    assert (deadline_push (deadline, "ups-3", 300) == 0);
+    assert (deadline_push (deadline, "ups-1", 100) == 0);
+    assert (deadline_push (deadline, "ups-2", 200) == 0);
+    assert (deadline_push (deadline, "ups-1", 150) == 0);
+    assert (deadline_size (deadline) == 4);
+    assert (deadline_next (deadline) == 100);
+
+    // nothing is due yet
+    assert (deadline_pop (deadline, 99, NULL) == NULL);
+
+    // due entries come in order of their deadlines
+    uint64_t time_sec = 0;
+    char *name = deadline_pop (deadline, 200, &time_sec);
+    assert (name && streq (name, "ups-1") && time_sec == 100);
+    zstr_free (&name);
+    name = deadline_pop (deadline, 200, &time_sec);
+    assert (name && streq (name, "ups-1") && time_sec == 150);
+    zstr_free (&name);
+    name = deadline_pop (deadline, 200, &time_sec);
+    assert (name && streq (name, "ups-2") && time_sec == 200);
+    zstr_free (&name);
+    assert (deadline_pop (deadline, 200, &time_sec) == NULL);
+    assert (deadline_size (deadline) == 1);
+    deadline_destroy (&deadline);
+
+    // ordering for a big site
+    const size_t count = 100000;
+    deadline = deadline_new ();
+    int64_t start = zclock_usecs ();
+    for (size_t i = 0; i < count; i++) {
+        char asset [32];
+        snprintf (asset, sizeof (asset), "ups-%zu", i);
+        assert (deadline_push (deadline, asset, (i * 7919) % count) == 0);
+    }
+    int64_t pushed = zclock_usecs ();
+    uint64_t last = 0;
+    size_t popped = 0;
+    while ((name = deadline_pop (deadline, count, &time_sec)) != NULL) {
+        assert (time_sec >= last);
+        last = time_sec;
+        popped++;
+        zstr_free (&name);
+    }
+    int64_t done = zclock_usecs ();
+    assert (popped == count);
+    log_info ("%s: %zu deadlines: push %" PRIi64 " us, pop %" PRIi64 " us",
+              __func__, count, pushed - start, done - pushed);
+    deadline_destroy (&deadline);
+    //  @end
+    printf ("OK\n");
+}
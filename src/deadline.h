@@ -0,0 +1,87 @@
+/*  =========================================================================
+    deadline - Deadline-ordered index of assets
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef DEADLINE_H_INCLUDED
+#define DEADLINE_H_INCLUDED
+
+#include "../include/fty-outage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _deadline_entry_t {
+    uint64_t time_sec;              // [s] deadline
+    char *name;                     // asset iname
+} deadline_entry_t;
+
+//  Structure of our class
+struct _deadline_t {
+    deadline_entry_t *heap;         // binary min-heap ordered by time_sec
+    size_t size;                    // entries used
+    size_t alloc;                   // entries allocated
+};
+
+#ifndef DEADLINE_T_DEFINED
+typedef struct _deadline_t deadline_t;
+#define DEADLINE_T_DEFINED
+#endif
+
+//  @interface
+//  Create a new empty index
+FTY_OUTAGE_EXPORT deadline_t *
+    deadline_new (void);
+
+//  Destroy the index
+FTY_OUTAGE_EXPORT void
+    deadline_destroy (deadline_t **self_p);
+
+//  Add deadline of the asset. Entries are not updated nor removed in place,
+//  so caller checks popped entries against the current state of the asset.
+//  return -1 on memory error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    deadline_push (deadline_t *self, const char *name, uint64_t time_sec);
+
+//  Return the earliest deadline, 0 if the index is empty
+FTY_OUTAGE_EXPORT uint64_t
+    deadline_next (deadline_t *self);
+
+//  Remove the earliest entry, if its deadline is not later than now_sec
+//  return name of the asset (caller frees it) and set time_sec_p to its
+//  deadline, NULL if nothing is due
+FTY_OUTAGE_EXPORT char *
+    deadline_pop (deadline_t *self, uint64_t now_sec, uint64_t *time_sec_p);
+
+//  Return number of entries
+FTY_OUTAGE_EXPORT size_t
+    deadline_size (deadline_t *self);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    deadline_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
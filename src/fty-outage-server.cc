@@ -27,10 +27,16 @@
 */
 #define TIMEOUT_MS 30000   //wait at least 30 seconds
 #define SAVE_INTERVAL_MS 45*60*1000 // store state each 45 minutes
+#define JOURNAL_COMPACT_SIZE 4*1024*1024 // store state sooner, if journal grows over 4MB
+#define QUERY_PAGE_DEFAULT 100 // assets in one reply to list query, if not asked otherwise
+#define QUERY_PAGE_MAX 1000 // upper limit of assets in one reply to a query
+#define STATUS_PUBLISH_MS 1000 // publish status view for readers at most each second
+#define STATS_ASSET "fty-outage" // asset name of the stats published to shm
 
 #include "fty_outage_classes.h"
 #include "data.h"
 #include "fty_common_macros.h"
+#include <vector>
 
 static void *TRUE = (void*) "true";   // hack to allow us to pretend zhash is set
 
@@ -40,7 +46,25 @@ typedef struct _s_osrv_t {
     data_t *assets;
     zhash_t *active_alerts;
     char *state_file;
+    char *legacy_state_file;        // zconfig state file of older releases, imported if state_file is missing,
+                                    // renamed to .imported once the first state is saved
+    char *catalog_file;             // catalog of tracked assets, saved with the state if assets changed
+    char *catalog_check;            // uuid of the pending request for existing assets, if any
+    journal_t *journal;             // state transitions since the last saved state
+    schedule_t *schedules;          // recurring maintenance windows
+    status_t *status;               // status of assets published for reader threads
+    zactor_t *status_writer;        // copies published status to shared memory table for other agents
+    int status_reader;              // reader of status views serving mailbox queries
+    char *schedule_file;            // schedules, saved whenever they change
+    stats_t *stats;                 // performance counters and latencies
+    watchdog_t *watchdog;           // stalls and heartbeat of the main loop
+    uint64_t stats_interval_ms;     // publish stats to shm each interval, 0 = never
+    recording_t *recording;         // inputs and alerts recorded for replay, if enabled
     uint64_t default_maintenance_expiration;
+    bool resend_active;             // re-send ACTIVE alerts of dead devices each check
+    uint64_t snapshot_interval_ms;  // publish outage snapshot each interval, 0 = never
+    uint64_t snapshot_seq;          // sequence number of the last outage snapshot
+    mlm_client_t *snapshot_client;  // producer of outage snapshots, NULL if not connected
     bool verbose;
 } s_osrv_t;
 
@@ -53,7 +77,22 @@ s_osrv_destroy (s_osrv_t **self_p)
         zhash_destroy (&self->active_alerts);
         data_destroy (&self->assets);
         mlm_client_destroy (&self->client);
+        mlm_client_destroy (&self->snapshot_client);
         zstr_free (&self->state_file);
+        zstr_free (&self->legacy_state_file);
+        zstr_free (&self->catalog_file);
+        zstr_free (&self->catalog_check);
+        journal_destroy (&self->journal);
+        schedule_destroy (&self->schedules);
+        // writer reads status views until it ends
+        zactor_destroy (&self->status_writer);
+        if (self->status)
+            status_reader_destroy (self->status, self->status_reader);
+        status_destroy (&self->status);
+        zstr_free (&self->schedule_file);
+        watchdog_destroy (&self->watchdog);
+        stats_destroy (&self->stats);
+        recording_destroy (&self->recording);
         free (self);
         *self_p = NULL;
     }
@@ -68,11 +107,25 @@ s_osrv_new ()
         if (self->client)
             self->assets = data_new ();
         if (self->assets)
+            self->schedules = schedule_new ();
+        if (self->schedules)
+            self->status = status_new ();
+        if (self->status) {
+            self->status_reader = status_reader_new (self->status);
+            self->stats = stats_new ();
+        }
+        if (self->stats)
+            self->watchdog = watchdog_new (self->stats);
+        if (self->watchdog)
             self->active_alerts = zhash_new ();
         if (self->active_alerts) {
             self->timeout_ms = TIMEOUT_MS;
             self->state_file = NULL;
             self->default_maintenance_expiration = 0;
+            self->resend_active = true;
+            self->snapshot_interval_ms = 0;
+            self->snapshot_seq = 0;
+            self->stats_interval_ms = 0;
         } else {
             s_osrv_destroy (&self);
         }
@@ -81,6 +134,148 @@ s_osrv_new ()
     return self;
 }
 
+// record transition of asset 'source-asset' to the journal, if any
+static void
+s_osrv_journal (s_osrv_t* self, uint8_t type, const char* source_asset, uint64_t value)
+{
+    if (!self->journal)
+        return;
+    if (journal_append (self->journal, type, source_asset, vclock_time () / 1000, value) != 0)
+        log_error ("Can't journal transition %u of '%s'", (unsigned) type, source_asset);
+}
+
+// update status of asset 'source-asset' for readers, it is published with
+// other changes of the batch
+static void
+s_osrv_status_update (s_osrv_t* self, const char* source_asset)
+{
+    expiration_t *e = data_lookup (self->assets, source_asset);
+    if (!e) {
+        status_remove (self->status, source_asset);
+        return;
+    }
+    if (status_update (self->status, source_asset, e->last_time_seen_sec, e->ttl_sec,
+                       expiration_get (e), e->maintenance_until_sec, e->alert_active) != 0)
+        log_error ("Can't update status of '%s' (memory error)", source_asset);
+}
+
+// update status of all assets, after they were loaded
+static void
+s_osrv_status_refresh (s_osrv_t* self)
+{
+    zhashx_t *assets = self->assets->assets;
+    for (void *it = zhashx_first (assets); it != NULL; it = zhashx_next (assets))
+        s_osrv_status_update (self, (const char *) zhashx_cursor (assets));
+}
+
+// publish status updates made so far as a new view
+static void
+s_osrv_status_publish (s_osrv_t* self, uint64_t now_sec)
+{
+    if (status_publish (self->status, now_sec) != 0)
+        log_error ("Can't publish status of assets (memory error)");
+    else
+    if (self->status_writer)
+        zstr_send (self->status_writer, "PUBLISHED");
+}
+
+// record message received from malamute, if recording is enabled
+static void
+s_osrv_record_message (s_osrv_t* self, const char *command, const char *address,
+                       const char *sender, const char *subject, zmsg_t *message)
+{
+    if (!self->recording)
+        return;
+    zmsg_t *record = zmsg_dup (message);
+    if (!record)
+        return;
+    bool stream = streq (command, "STREAM DELIVER");
+    zmsg_pushstr (record, subject);
+    zmsg_pushstr (record, sender);
+    if (stream)
+        zmsg_pushstr (record, address);
+    recording_write (self->recording, stream ? RECORDING_STREAM : RECORDING_MAILBOX, vclock_time (), record);
+    zmsg_destroy (&record);
+}
+
+// append metric to a recording as one frame with only what touching the
+// asset uses, metrics ignored by the agent are left out
+// uint64_t time, uint32_t ttl, name '\0' [port '\0' sname '\0']
+static void
+s_osrv_record_metric (zmsg_t *record, fty_proto_t *metric)
+{
+    if (fty_proto_aux_string (metric, "x-cm-count", NULL))
+        return;
+    const char *name = fty_proto_name (metric);
+    const char *port = fty_proto_aux_string (metric, FTY_PROTO_METRICS_SENSOR_AUX_PORT, NULL);
+    const char *sname = fty_proto_aux_string (metric, FTY_PROTO_METRICS_SENSOR_AUX_SNAME, NULL);
+    if (!name || (port && !sname))
+        return;
+
+    uint64_t time = fty_proto_time (metric);
+    uint32_t ttl = fty_proto_ttl (metric);
+    size_t name_size = strlen (name) + 1;
+    size_t port_size = port ? strlen (port) + 1 : 0;
+    size_t sname_size = port ? strlen (sname) + 1 : 0;
+    zframe_t *frame = zframe_new (NULL, sizeof (time) + sizeof (ttl) + name_size + port_size + sname_size);
+    byte *p = zframe_data (frame);
+    memcpy (p, &time, sizeof (time));
+    p += sizeof (time);
+    memcpy (p, &ttl, sizeof (ttl));
+    p += sizeof (ttl);
+    memcpy (p, name, name_size);
+    p += name_size;
+    if (port) {
+        memcpy (p, port, port_size);
+        memcpy (p + port_size, sname, sname_size);
+    }
+    zmsg_append (record, &frame);
+}
+
+// return metric of a recording frame written by s_osrv_record_metric,
+// NULL if the frame is damaged
+static fty_proto_t *
+s_osrv_recorded_metric (zframe_t *frame)
+{
+    uint64_t time;
+    uint32_t ttl;
+    size_t size = zframe_size (frame);
+    const char *data = (const char *) zframe_data (frame);
+    if (size <= sizeof (time) + sizeof (ttl) || data [size - 1] != '\0')
+        return NULL;
+    memcpy (&time, data, sizeof (time));
+    memcpy (&ttl, data + sizeof (time), sizeof (ttl));
+    const char *end = data + size;
+    const char *name = data + sizeof (time) + sizeof (ttl);
+    const char *port = name + strlen (name) + 1;
+    const char *sname = port < end ? port + strlen (port) + 1 : end;
+    if (port < end && sname >= end)
+        return NULL;
+
+    fty_proto_t *metric = fty_proto_new (FTY_PROTO_METRIC);
+    fty_proto_set_name (metric, "%s", name);
+    fty_proto_set_time (metric, time);
+    fty_proto_set_ttl (metric, ttl);
+    if (port < end) {
+        fty_proto_aux_insert (metric, FTY_PROTO_METRICS_SENSOR_AUX_PORT, "%s", port);
+        fty_proto_aux_insert (metric, FTY_PROTO_METRICS_SENSOR_AUX_SNAME, "%s", sname);
+    }
+    return metric;
+}
+
+// record metrics read from shm, if recording is enabled
+static void
+s_osrv_record_metrics (s_osrv_t* self, fty::shm::shmMetrics& metrics)
+{
+    if (!self->recording)
+        return;
+    zmsg_t *record = zmsg_new ();
+    for (auto &element : metrics)
+        s_osrv_record_metric (record, element);
+    recording_write (self->recording, RECORDING_METRICS, vclock_time (), record);
+    zmsg_destroy (&record);
+}
+
 // publish 'outage' alert for asset 'source-asset' in state 'alert-state'
 static void
 s_osrv_send_alert (s_osrv_t* self, const char* source_asset, const char* alert_state)
@@ -94,10 +289,12 @@ s_osrv_send_alert (s_osrv_t* self, const char* source_asset, const char* alert_s
     zlist_append(actions, (void *) "EMAIL");
     zlist_append(actions, (void *) "SMS");
     char *rule_name = zsys_sprintf ("%s@%s","outage",source_asset);
-    std::string description = TRANSLATE_ME("Device %s does not provide expected data. It may be offline or not correctly configured.", data_get_asset_ename (self->assets, source_asset));
+    // alerts of assets being deleted are resolved after they are forgotten
+    const char *ename = data_get_asset_ename (self->assets, source_asset);
+    std::string description = TRANSLATE_ME("Device %s does not provide expected data. It may be offline or not correctly configured.", ename ? ename : source_asset);
     zmsg_t *msg = fty_proto_encode_alert (
             NULL, // aux
-            zclock_time() / 1000, // unix time (sec.)
+            vclock_time () / 1000, // unix time (sec.)
             self->timeout_ms * 3 / 1000, // ttl (sec.)
             rule_name, // rule_name
             source_asset,
@@ -109,10 +306,25 @@ s_osrv_send_alert (s_osrv_t* self, const char* source_asset, const char* alert_s
         "outage",
         "CRITICAL",
         source_asset);
-    log_debug ("Alert '%s' is '%s'", subject, alert_state);
+    logging_debug ("Alert '%s' is '%s'", subject, alert_state);
+    int64_t start_us = zclock_usecs ();
     int rv = mlm_client_send (self->client, subject, &msg);
-    if ( rv != 0 )
+    stats_record_since (self->stats, STATS_SEND, start_us);
+    FTY_OUTAGE_PROBE3 (alert__send, source_asset, alert_state, rv);
+    blackbox_record (streq (alert_state, "ACTIVE") ? BLACKBOX_ALERT_ACTIVE : BLACKBOX_ALERT_RESOLVED, source_asset, (uint64_t) rv, 0);
+    if ( rv != 0 ) {
         log_error ("Cannot send alert on '%s' (mlm_client_send)", source_asset);
+        stats_add (self->stats, STATS_SEND_ERRORS, 1);
+    }
+    else
+        stats_add (self->stats, streq (alert_state, "ACTIVE") ? STATS_ALERTS_ACTIVE : STATS_ALERTS_RESOLVED, 1);
+    if (self->recording) {
+        zmsg_t *record = zmsg_new ();
+        zmsg_addstr (record, source_asset);
+        zmsg_addstr (record, alert_state);
+        recording_write (self->recording, RECORDING_ALERT, vclock_time (), record);
+        zmsg_destroy (&record);
+    }
     zlist_destroy(&actions);
     zstr_free (&subject);
     zstr_free (&rule_name);
@@ -131,9 +343,101 @@ s_osrv_resolve_alert (s_osrv_t* self, const char* source_asset)
         log_info ("\t\tsend RESOLVED alert for source=%s", source_asset);
         s_osrv_send_alert (self, source_asset, "RESOLVED");
         zhash_delete (self->active_alerts, source_asset);
+        s_osrv_journal (self, JOURNAL_ALERT_RESOLVED, source_asset, 0);
+        expiration_t *e = data_lookup (self->assets, source_asset);
+        if (e) {
+            e->alert_active = false;
+            s_osrv_status_update (self, source_asset);
+        }
     }
 }
 
+// return true if the 'outage' alert is tracked for asset 'source-asset'
+// tracked assets carry a copy of the state in expiration record, so the
+// common "no alert" answer needs no lookup in active_alerts at all
+static bool
+s_osrv_alert_is_active (s_osrv_t* self, const char* source_asset, expiration_t *e)
+{
+    if (e)
+        return e->alert_active;
+    // asset is not tracked (yet), alert may come from the state file
+    return zhash_size (self->active_alerts) > 0
+        && zhash_lookup (self->active_alerts, source_asset) != NULL;
+}
+
+// copy the alert state of asset 'source-asset' into its expiration record
+// needs to be called whenever a new expiration record is created
+static void
+s_osrv_sync_alert_flag (s_osrv_t* self, const char* source_asset)
+{
+    expiration_t *e = data_lookup (self->assets, source_asset);
+    if (e)
+        e->alert_active = zhash_lookup (self->active_alerts, source_asset) != NULL;
+}
+
+// device 'parent-asset' responds again
+// * resolve 'outage' alerts of the assets attached to it
+// * give them a fresh expiration window, they were not reachable until now
+static void
+s_osrv_recover_children (s_osrv_t* self, const char* parent_asset, uint64_t now_sec)
+{
+    zhashx_t *children = data_get_children (self->assets, parent_asset);
+    if (!children)
+        return;
+
+    logging_debug ("\t\tparent=%s recovered, refreshing %zu children", parent_asset, zhashx_size (children));
+    for (void *it = zhashx_first (children);
+               it != NULL;
+               it = zhashx_next (children))
+    {
+        const char *child = (const char *) zhashx_cursor (children);
+        s_osrv_resolve_alert (self, child);
+        expiration_t *e = data_lookup (self->assets, child);
+        if (e) {
+            expiration_update (e, now_sec);
+            s_osrv_status_update (self, child);
+        }
+    }
+}
+
+// return true if the device, asset 'source-asset' is attached to, does not
+// respond either, so the outage is already covered by the alert of the parent
+static bool
+s_osrv_parent_is_dead (s_osrv_t* self, const char* source_asset, uint64_t now_sec)
+{
+    const char *parent = data_get_parent (self->assets, source_asset);
+    if (!parent)
+        return false;
+    expiration_t *e = data_lookup (self->assets, parent);
+    return e && expiration_get (e) <= now_sec;
+}
+
+// metric for asset 'source-asset' has been seen
+// * resolve 'outage' alert, if any
+// * link the asset to 'parent-asset' it has been seen through (sensors)
+// * update expiration time of the asset
+// the asset is looked up only once, the alert only on a real state change
+// runs on the actor thread only, data_t and its parent index are not locked
+static void
+s_osrv_touch_asset (s_osrv_t* self, const char* source_asset, const char* parent_asset, uint64_t timestamp, uint64_t ttl, uint64_t now_sec)
+{
+    expiration_t *e = data_lookup (self->assets, source_asset);
+    if (s_osrv_alert_is_active (self, source_asset, e)) {
+        s_osrv_resolve_alert (self, source_asset);
+        s_osrv_recover_children (self, source_asset, now_sec);
+    }
+    if (!e)
+        return;
+    if (parent_asset && (!e->parent || !streq (e->parent, parent_asset)))
+        data_set_parent (self->assets, source_asset, parent_asset);
+    stats_add (self->stats, STATS_ASSETS_TOUCHED, 1);
+    int rv = expiration_touch (e, source_asset, timestamp, ttl, now_sec);
+    if ( rv == -1 )
+        log_error ("asset: name = %s, topic=%s metric is from future! ignore it", source_asset, mlm_client_subject (self->client));
+    else
+        s_osrv_status_update (self, source_asset);
+}
+
 // switch asset 'source-asset' to maintenance mode
 // this implies putting a long TTL, so that no 'outage' alert is generated
 // return -1, if operation failed
@@ -141,57 +445,71 @@ s_osrv_resolve_alert (s_osrv_t* self, const char* source_asset)
 static int
 s_osrv_maintenance_mode (s_osrv_t* self, const char* source_asset, int mode, int expiration_ttl)
 {
-    int rv = -1;
-
     assert (self);
     assert (source_asset);
 
-    uint64_t now_sec = zclock_time() / 1000;
-
-    if (zhashx_lookup (self->assets->assets, source_asset)) {
-
-        // The asset is already known
-        // so resolve the existing alert if mode == ENABLE_MAINTENANCE
-        log_debug ("outage: maintenance mode: asset '%s' found, so updating it and resolving current alert", source_asset);
-
-        if (mode == ENABLE_MAINTENANCE)
-            s_osrv_resolve_alert (self, source_asset);
+    uint64_t now_sec = vclock_time () / 1000;
 
-        // Note: when mode == DISABLE_MAINTENANCE, restore the default expiration
-        rv = data_touch_asset (self->assets, source_asset, now_sec,
-                               (mode==ENABLE_MAINTENANCE)?expiration_ttl:self->assets->default_expiry_sec,
-                               now_sec);
-        if ( rv == -1 ) {
-            // FIXME: use agent name from fty-common
-            log_error ("outage: failed to %sable maintenance mode for asset '%s'",
-                       (mode==ENABLE_MAINTENANCE)?"en":"dis", source_asset);
-        }
-        else
-            log_info ("outage: maintenance mode %sabled for asset '%s'",
-                       (mode==ENABLE_MAINTENANCE)?"en":"dis", source_asset);
+    expiration_t *e = data_lookup (self->assets, source_asset);
+    if (e) {
+        log_debug ("outage: maintenance mode: asset '%s' found, so updating it", source_asset);
     }
     else {
         log_debug ("outage: maintenance mode: asset '%s' not found, so creating it", source_asset);
 
-        // The asset is already known, so add it to the tracking list
+        // The asset is not known, so add it to the tracking list
         // theoretically, this is only needed when generating the outage alert
         // so not applicable here!
         // zhashx_insert (self->assets->asset_enames, asset_name, (void*) fty_proto_ext_string (proto, "name", ""));
 
-        expiration_t *e = (expiration_t *) zhashx_lookup (self->assets->assets, source_asset);
-        if ( e == NULL ) {
-            // FIXME: check if the 2nd param is really needed, seems not used!
-            fty_proto_t *msg = fty_proto_new (FTY_PROTO_ASSET);
-            e = expiration_new ((mode==ENABLE_MAINTENANCE)?expiration_ttl:self->assets->default_expiry_sec, &msg);
-            expiration_update (e, now_sec);
-            log_debug ("asset: ADDED name='%s', last_seen=%" PRIu64 "[s], ttl= %" PRIu64 "[s], expires_at=%" PRIu64 "[s]", source_asset, e->last_time_seen_sec, e->ttl_sec, expiration_get (e));
-            zhashx_insert (self->assets->assets, source_asset, e);
-            rv = 0;
-        }
+        // FIXME: check if the 2nd param is really needed, seems not used!
+        fty_proto_t *msg = fty_proto_new (FTY_PROTO_ASSET);
+        e = expiration_new (self->assets->default_expiry_sec, &msg);
+        expiration_update (e, now_sec);
+        log_debug ("asset: ADDED name='%s', last_seen=%" PRIu64 "[s], ttl= %" PRIu64 "[s], expires_at=%" PRIu64 "[s]", source_asset, e->last_time_seen_sec, e->ttl_sec, expiration_get (e));
+        e->alert_active = zhash_lookup (self->active_alerts, source_asset) != NULL;
+        zhashx_insert (self->assets->assets, source_asset, e);
+    }
+
+    // maintenance window is kept aside of learned ttl, which stays untouched
+    if (mode == ENABLE_MAINTENANCE) {
+        s_osrv_resolve_alert (self, source_asset);
+        uint64_t until_sec = now_sec + (expiration_ttl > 0 ? expiration_ttl : 0);
+        data_set_maintenance (self->assets, source_asset, until_sec);
+        s_osrv_journal (self, JOURNAL_MAINTENANCE_ENABLE, source_asset, until_sec);
+        blackbox_record (BLACKBOX_MAINTENANCE_ON, source_asset, until_sec, 0);
+    }
+    else {
+        data_set_maintenance (self->assets, source_asset, 0);
+        // device gets whole ttl to report itself after maintenance
+        expiration_update (e, now_sec);
+        s_osrv_journal (self, JOURNAL_MAINTENANCE_DISABLE, source_asset, 0);
+        blackbox_record (BLACKBOX_MAINTENANCE_OFF, source_asset, 0, 0);
     }
+    s_osrv_status_update (self, source_asset);
     log_info ("outage: maintenance mode %sabled for asset '%s' with TTL %i",
                (mode==ENABLE_MAINTENANCE)?"en":"dis", source_asset, expiration_ttl);
-    return rv;
+    return 0;
+}
+
+// end maintenance windows, which are over
+static void
+s_osrv_expire_maintenance (s_osrv_t *self, uint64_t now_sec)
+{
+    assert (self);
+
+    if (deadline_size (self->assets->maintenance) == 0 || deadline_next (self->assets->maintenance) > now_sec)
+        return;
+    zlistx_t *expired = data_expire_maintenance (self->assets, now_sec);
+    for (void *it = expired ? zlistx_first (expired) : NULL;
+               it != NULL;
+               it = zlistx_next (expired))
+    {
+        log_info ("outage: maintenance mode expired for asset '%s'", (const char *) it);
+        blackbox_record (BLACKBOX_MAINTENANCE_OFF, (const char *) it, 0, 0);
+        s_osrv_status_update (self, (const char *) it);
+    }
+    zlistx_destroy (&expired);
 }
 
 // if for asset 'source-asset' the 'outage' alert is NOT tracked
@@ -207,66 +525,261 @@ s_osrv_activate_alert (s_osrv_t* self, const char* source_asset)
         log_info ("\t\tsend ACTIVE alert for source=%s", source_asset);
         s_osrv_send_alert (self, source_asset, "ACTIVE");
         zhash_insert (self->active_alerts, source_asset, TRUE);
+        s_osrv_journal (self, JOURNAL_ALERT_ACTIVE, source_asset, 0);
+        expiration_t *e = data_lookup (self->assets, source_asset);
+        if (e) {
+            e->alert_active = true;
+            s_osrv_status_update (self, source_asset);
+        }
     }
-    else {
+    else
+    if (self->resend_active) {
         /// XXX: Send the alert nevertheless, unexplained behavior change from last release.
-        log_debug ("\t\talert already active for source=%s (sending alert anyway)", source_asset);
+        logging_debug ("\t\talert already active for source=%s (sending alert anyway)", source_asset);
         s_osrv_send_alert (self, source_asset, "ACTIVE");
     }
 }
 
-static int
-s_osrv_save (s_osrv_t *self)
+// append current outage set to the message
+// <sequence>/<time>/<count>/asset1/.../assetN
+static void
+s_osrv_outage_snapshot (s_osrv_t* self, zmsg_t *msg)
 {
     assert (self);
+    assert (msg);
 
-    if (!self->state_file) {
-        log_warning ("There is no state path set-up, can't store the state");
-        return -1;
+    zmsg_addstrf (msg, "%" PRIu64, ++self->snapshot_seq);
+    zmsg_addstrf (msg, "%" PRIu64, (uint64_t) vclock_time () / 1000);
+    zmsg_addstrf (msg, "%zu", zhash_size (self->active_alerts));
+    for (void *it = zhash_first (self->active_alerts);
+               it != NULL;
+               it = zhash_next (self->active_alerts))
+    {
+        zmsg_addstr (msg, zhash_cursor (self->active_alerts));
     }
+}
 
-    zconfig_t *root = zconfig_new ("root", NULL);
-    assert (root);
+// publish current outage set on its own stream, so consumers can resync,
+// it is not fty_proto, so it must not go to the alert stream
+// OUTAGE_SNAPSHOT/<sequence>/<time>/<count>/asset1/.../assetN
+static void
+s_osrv_publish_snapshot (s_osrv_t* self)
+{
+    assert (self);
+
+    if (!self->snapshot_client) {
+        log_warning ("Outage snapshot not published, no SNAPSHOT-PRODUCER");
+        return;
+    }
 
-    zconfig_t *active_alerts = zconfig_new ("alerts", root);
-    assert (active_alerts);
+    zmsg_t *msg = zmsg_new ();
+    zmsg_addstr (msg, "OUTAGE_SNAPSHOT");
+    s_osrv_outage_snapshot (self, msg);
+    log_debug ("Publish outage snapshot #%" PRIu64 " with %zu alerts", self->snapshot_seq, zhash_size (self->active_alerts));
+    int rv = mlm_client_send (self->snapshot_client, "outage/snapshot", &msg);
+    if ( rv != 0 ) {
+        log_error ("Cannot send outage snapshot (mlm_client_send)");
+        stats_add (self->stats, STATS_SEND_ERRORS, 1);
+        zmsg_destroy (&msg);
+    }
+}
 
-    size_t i = 0;
+// copy outage state to a new state_t, return NULL on memory error
+static state_t *
+s_osrv_snapshot (s_osrv_t *self)
+{
+    assert (self);
+
+    state_t *state = state_new (vclock_time () / 1000);
+    if (!state)
+        return NULL;
+
+    int ret = 0;
+    zhashx_t *assets = self->assets->assets;
+    for (expiration_t *e = (expiration_t *) zhashx_first (assets);
+                       e != NULL && ret == 0;
+                       e = (expiration_t *) zhashx_next (assets))
+    {
+        uint32_t flags = STATE_FLAG_TRACKED;
+        if (e->alert_active)
+            flags |= STATE_FLAG_ALERT_ACTIVE;
+        ret = state_add (state, (const char *) zhashx_cursor (assets), flags,
+                         e->last_time_seen_sec, e->ttl_sec, e->maintenance_until_sec);
+    }
+
+    // restored assets, which were not announced since restart (yet)
+    zhashx_t *restored = self->assets->restored;
+    for (expiration_t *e = (expiration_t *) zhashx_first (restored);
+                       e != NULL && ret == 0;
+                       e = (expiration_t *) zhashx_next (restored))
+    {
+        const char *asset_name = (const char *) zhashx_cursor (restored);
+        uint32_t flags = STATE_FLAG_TRACKED;
+        if (zhash_lookup (self->active_alerts, asset_name))
+            flags |= STATE_FLAG_ALERT_ACTIVE;
+        ret = state_add (state, asset_name, flags, e->last_time_seen_sec, e->ttl_sec, e->maintenance_until_sec);
+    }
+
+    // alerts of assets, which are not tracked (yet)
     for (void*  it = zhash_first (self->active_alerts);
-                it != NULL;
+                it != NULL && ret == 0;
                 it = zhash_next (self->active_alerts))
     {
-        const char *value = (const char*) zhash_cursor (self->active_alerts);
-        char *key = zsys_sprintf ("%zu", i++);
-        zconfig_put (active_alerts, key, value);
-        zstr_free (&key);
+        const char *asset_name = zhash_cursor (self->active_alerts);
+        if (!data_lookup (self->assets, asset_name) && !zhashx_lookup (self->assets->restored, asset_name))
+            ret = state_add (state, asset_name, STATE_FLAG_ALERT_ACTIVE, 0, 0, 0);
     }
 
-    int ret = zconfig_save (root, self->state_file);
-    log_debug ("outage_actor: save state to %s", self->state_file);
-    zconfig_destroy (&root);
+    if (ret != 0)
+        state_destroy (&state);
+    return state;
+}
+
+// copy tracked assets to a new catalog_t, return NULL on memory error
+static catalog_t *
+s_osrv_catalog (s_osrv_t *self)
+{
+    assert (self);
+
+    catalog_t *catalog = catalog_new ();
+    if (!catalog)
+        return NULL;
+
+    zhashx_t *assets = self->assets->assets;
+    for (expiration_t *e = (expiration_t *) zhashx_first (assets);
+                       e != NULL;
+                       e = (expiration_t *) zhashx_next (assets))
+    {
+        const char *asset_name = (const char *) zhashx_cursor (assets);
+        if (catalog_add (catalog, asset_name, data_get_asset_ename (self->assets, asset_name),
+                         e->subtype, e->parent) != 0) {
+            catalog_destroy (&catalog);
+            return NULL;
+        }
+    }
+    return catalog;
+}
+
+// rename imported state file of older releases once the state is on disk,
+// so it is never imported again
+static void
+s_osrv_retire_legacy (s_osrv_t *self)
+{
+    assert (self);
+
+    if (!self->legacy_state_file)
+        return;
+    if (zsys_file_exists (self->legacy_state_file)) {
+        char *imported = zsys_sprintf ("%s.imported", self->legacy_state_file);
+        if (rename (self->legacy_state_file, imported) == 0)
+            log_info ("outage_actor: %s is replaced by %s, renamed to %s",
+                      self->legacy_state_file, self->state_file, imported);
+        else
+            log_error ("Can't rename %s to %s: %m", self->legacy_state_file, imported);
+        zstr_free (&imported);
+    }
+    zstr_free (&self->legacy_state_file);
+}
+
+// save the state, waiting until it is on disk
+// shutdown marks the state as exact, times of assets can be trusted on load
+static int
+s_osrv_save (s_osrv_t *self, bool shutdown)
+{
+    assert (self);
+
+    if (!self->state_file) {
+        log_warning ("There is no state path set-up, can't store the state");
+        return -1;
+    }
+
+    state_t *state = s_osrv_snapshot (self);
+    if (!state) {
+        log_error ("Can't save state (memory error)");
+        return -1;
+    }
+
+    if (shutdown)
+        state_set_flags (state, STATE_CLEAN_SHUTDOWN);
+    int64_t start_us = zclock_usecs ();
+    int ret = state_save (state, self->state_file);
+    log_debug ("outage_actor: save state (%zu assets) to %s", state_size (state), self->state_file);
+    state_destroy (&state);
+    if (ret == 0)
+        s_osrv_retire_legacy (self);
+
+    if (self->catalog_file && data_changed (self->assets)) {
+        catalog_t *catalog = s_osrv_catalog (self);
+        if (catalog && catalog_save (catalog, self->catalog_file) == 0)
+            data_clear_changed (self->assets);
+        else
+            log_error ("Can't save asset catalog to %s", self->catalog_file);
+        catalog_destroy (&catalog);
+    }
+
+    // journaled transitions are part of the saved state now
+    if (ret == 0 && self->journal)
+        ret = journal_truncate (self->journal);
+    stats_record_since (self->stats, STATS_SAVE, start_us);
     return ret;
 }
 
+// take snapshot of the state and hand it over to the writer actor, journal
+// is rotated, so transitions made while the snapshot is written are kept
 static int
-s_osrv_load (s_osrv_t *self)
+s_osrv_save_background (s_osrv_t *self, zactor_t *writer)
 {
     assert (self);
+    assert (writer);
 
     if (!self->state_file) {
-        log_warning ("There is no state path set-up, can't load the state");
+        log_warning ("There is no state path set-up, can't store the state");
         return -1;
     }
 
-    zconfig_t *root = zconfig_load (self->state_file);
+    int64_t start_us = zclock_usecs ();
+    state_t *state = s_osrv_snapshot (self);
+    if (!state) {
+        log_error ("Can't save state (memory error)");
+        return -1;
+    }
+    if (self->journal && journal_rotate (self->journal) != 0) {
+        state_destroy (&state);
+        return -1;
+    }
+    // catalog is written only when assets changed, it is marked as changed
+    // again if the save fails
+    catalog_t *catalog = NULL;
+    if (self->catalog_file && data_changed (self->assets)) {
+        catalog = s_osrv_catalog (self);
+        if (catalog)
+            data_clear_changed (self->assets);
+    }
+    size_t count = state_size (state);
+    zsock_send (writer, "sspsp", "SAVE", self->state_file, state,
+                self->catalog_file ? self->catalog_file : "", catalog);
+    log_info ("outage_actor: state snapshot (%zu assets) taken in %" PRIi64 " us, saving to %s",
+              count, zclock_usecs () - start_us, self->state_file);
+    stats_record_since (self->stats, STATS_SAVE, start_us);
+    return 0;
+}
+
+// import active alerts from zconfig state file of older releases
+static int
+s_osrv_load_legacy (s_osrv_t *self, const char *legacy_state_file)
+{
+    assert (self);
+    assert (legacy_state_file);
+
+    zconfig_t *root = zconfig_load (legacy_state_file);
     if (!root) {
-        log_error ("Can't load configuration from %s: %m", self->state_file);
+        log_error ("Can't load configuration from %s: %m", legacy_state_file);
         return -1;
     }
 
     zconfig_t *active_alerts = zconfig_locate (root, "alerts");
     if (!active_alerts) {
-        log_error ("Can't find 'alerts' in %s", self->state_file);
+        log_error ("Can't find 'alerts' in %s", legacy_state_file);
         zconfig_destroy (&root);
         return -1;
     }
@@ -276,38 +789,373 @@ s_osrv_load (s_osrv_t *self)
                     child = zconfig_next (child))
     {
         zhash_insert (self->active_alerts, zconfig_value (child), TRUE);
+        s_osrv_sync_alert_flag (self, zconfig_value (child));
     }
 
     zconfig_destroy (&root);
+    log_info ("outage_actor: imported %zu alerts from %s", zhash_size (self->active_alerts), legacy_state_file);
+    return 0;
+}
+
+static int
+s_osrv_load (s_osrv_t *self)
+{
+    assert (self);
+
+    if (!self->state_file) {
+        log_warning ("There is no state path set-up, can't load the state");
+        return -1;
+    }
+
+    // damaged snapshot must not bring back alerts of the older release
+    if (!zsys_file_exists (self->state_file)
+    &&  self->legacy_state_file && zsys_file_exists (self->legacy_state_file))
+        return s_osrv_load_legacy (self, self->legacy_state_file);
+
+    state_t *state = state_load (self->state_file);
+    if (!state) {
+        log_error ("Can't load state from %s", self->state_file);
+        return -1;
+    }
+
+    // after crash, assets may have been seen after the snapshot was taken
+    uint64_t seen_at_least_sec = (state_flags (state) & STATE_CLEAN_SHUTDOWN) ? 0 : state_time (state);
+    size_t restored = 0;
+    for (size_t i = 0; i < state_size (state); i++) {
+        const state_record_t *record = state_record (state, i);
+        const char *asset_name = state_record_name (state, record);
+        if (!asset_name)
+            continue;
+        if (record->flags & STATE_FLAG_TRACKED) {
+            uint64_t last_time_seen_sec = record->last_time_seen_sec;
+            if (last_time_seen_sec < seen_at_least_sec)
+                last_time_seen_sec = seen_at_least_sec;
+            data_restore (self->assets, asset_name, last_time_seen_sec, record->ttl_sec,
+                          record->maintenance_until_sec);
+            restored++;
+        }
+        if (record->flags & STATE_FLAG_ALERT_ACTIVE) {
+            zhash_insert (self->active_alerts, asset_name, TRUE);
+            s_osrv_sync_alert_flag (self, asset_name);
+        }
+    }
+    log_info ("outage_actor: restored %zu assets and %zu alerts from %s (%s)", restored,
+              zhash_size (self->active_alerts), self->state_file,
+              seen_at_least_sec ? "unclean shutdown" : state_time (state) ? "clean shutdown" : "older format");
+
+    state_destroy (&state);
     return 0;
 }
 
+// add tracked assets from the catalog, before they are announced on stream
+static int
+s_osrv_load_catalog (s_osrv_t *self)
+{
+    assert (self);
+    assert (self->catalog_file);
+
+    catalog_t *catalog = catalog_load (self->catalog_file);
+    if (!catalog)
+        return -1;
+
+    int64_t start_ms = zclock_mono ();
+    for (size_t i = 0; i < catalog_size (catalog); i++) {
+        const catalog_record_t *record = catalog_record (catalog, i);
+        const char *asset_name = catalog_string (catalog, record->name_offset);
+        const char *subtype = catalog_string (catalog, record->subtype_offset);
+        if (!asset_name || !subtype)
+            continue;
+        data_add_asset (self->assets, asset_name, catalog_string (catalog, record->ename_offset),
+                        subtype, catalog_string (catalog, record->parent_offset));
+        s_osrv_sync_alert_flag (self, asset_name);
+    }
+    // catalog is up to date
+    data_clear_changed (self->assets);
+    log_info ("outage_actor: loaded %zu assets from %s in %" PRIi64 " ms",
+              catalog_size (catalog), self->catalog_file, zclock_mono () - start_ms);
+    catalog_destroy (&catalog);
+    return 0;
+}
+
+// ask asset agent for existing devices, so assets restored from the catalog
+// and deleted while we were not running are forgotten
+// * GET/<uuid>/device - subject ASSETS
+static void
+s_osrv_request_catalog_check (s_osrv_t *self, const char *asset_agent)
+{
+    assert (self);
+    assert (asset_agent);
+
+    zuuid_t *uuid = zuuid_new ();
+    zstr_free (&self->catalog_check);
+    self->catalog_check = strdup (zuuid_str_canonical (uuid));
+    zuuid_destroy (&uuid);
+
+    zmsg_t *request = zmsg_new ();
+    zmsg_addstr (request, "GET");
+    zmsg_addstr (request, self->catalog_check);
+    zmsg_addstr (request, "device");
+    if (mlm_client_sendto (self->client, asset_agent, "ASSETS", NULL, 5000, &request) != 0) {
+        log_error ("Can't ask %s for existing assets, assets are deleted only when announced so", asset_agent);
+        zmsg_destroy (&request);
+        zstr_free (&self->catalog_check);
+    }
+}
+
+// forget restored assets, which are not in the reply of asset agent
+// * <uuid>/OK/asset1/.../assetN
+static void
+s_osrv_catalog_check (s_osrv_t *self, zmsg_t *reply)
+{
+    assert (self);
+    assert (reply);
+
+    char *uuid = zmsg_popstr (reply);
+    if (!self->catalog_check || !uuid || !streq (uuid, self->catalog_check)) {
+        log_warning ("Unexpected list of assets, ignoring it");
+        zstr_free (&uuid);
+        return;
+    }
+    zstr_free (&uuid);
+    zstr_free (&self->catalog_check);
+
+    char *status = zmsg_popstr (reply);
+    if (!status || !streq (status, "OK")) {
+        char *reason = zmsg_popstr (reply);
+        log_error ("Can't get list of existing assets: %s", reason ? reason : "");
+        zstr_free (&reason);
+        zstr_free (&status);
+        return;
+    }
+    zstr_free (&status);
+
+    zhashx_t *listed = zhashx_new ();
+    char *name;
+    while ((name = zmsg_popstr (reply)) != NULL) {
+        zhashx_insert (listed, name, (void *) "");
+        zstr_free (&name);
+    }
+    zlistx_t *deleted = data_restore_check (self->assets, listed);
+    for (void *it = deleted ? zlistx_first (deleted) : NULL;
+               it != NULL;
+               it = zlistx_next (deleted))
+    {
+        s_osrv_resolve_alert (self, (const char *) it);
+        s_osrv_journal (self, JOURNAL_ASSET_DELETE, (const char *) it, 0);
+        s_osrv_status_update (self, (const char *) it);
+    }
+    log_info ("outage: %zu assets exist, %zu restored assets were deleted meanwhile",
+              zhashx_size (listed), deleted ? zlistx_size (deleted) : 0);
+    zlistx_destroy (&deleted);
+    zhashx_destroy (&listed);
+}
+
+// apply transition journaled after the last saved state
+static void
+s_osrv_journal_replay (uint8_t type, const char *asset_name, uint64_t time_sec, uint64_t value, void *arg)
+{
+    s_osrv_t *self = (s_osrv_t *) arg;
+
+    switch (type) {
+        case JOURNAL_ALERT_ACTIVE:
+            zhash_insert (self->active_alerts, asset_name, TRUE);
+            break;
+        case JOURNAL_ALERT_RESOLVED:
+            zhash_delete (self->active_alerts, asset_name);
+            break;
+        case JOURNAL_MAINTENANCE_ENABLE:
+            // maintenance over meanwhile is ended by the main loop
+            data_set_maintenance (self->assets, asset_name, value);
+            break;
+        case JOURNAL_MAINTENANCE_DISABLE:
+            data_set_maintenance (self->assets, asset_name, 0);
+            break;
+        case JOURNAL_ASSET_DELETE:
+            // deleted after the snapshot, its restored times are stale
+            data_delete (self->assets, asset_name);
+            break;
+        default:
+            // assets are announced again after restart
+            break;
+    }
+    s_osrv_sync_alert_flag (self, asset_name);
+}
+
+// load the state from 'state-file' (or import 'legacy-state-file') and the
+// asset catalog, replay the journal on top of them and keep the journal open
+// for new transitions
+static void
+s_osrv_set_state_file (s_osrv_t *self, const char *state_file, const char *legacy_state_file)
+{
+    assert (self);
+    assert (state_file);
+
+    zstr_free (&self->state_file);
+    zstr_free (&self->legacy_state_file);
+    zstr_free (&self->catalog_file);
+    zstr_free (&self->schedule_file);
+    journal_destroy (&self->journal);
+    self->state_file = strdup (state_file);
+    self->catalog_file = zsys_sprintf ("%s.catalog", state_file);
+    self->schedule_file = zsys_sprintf ("%s.schedules", state_file);
+    if (legacy_state_file)
+        self->legacy_state_file = strdup (legacy_state_file);
+
+    int r = s_osrv_load (self);
+    if (r != 0)
+        log_error ("failed to load state file %s: %m", self->state_file);
+    // restored times of the state apply to the assets of the catalog
+    if (zsys_file_exists (self->catalog_file) && s_osrv_load_catalog (self) != 0)
+        log_error ("failed to load asset catalog %s", self->catalog_file);
+
+    if (zsys_file_exists (self->schedule_file)) {
+        int count = schedule_load (self->schedules, self->schedule_file, vclock_time () / 1000);
+        if (count < 0)
+            log_error ("failed to load maintenance schedules %s", self->schedule_file);
+        else
+            log_info ("outage_actor: loaded %d maintenance schedules from %s", count, self->schedule_file);
+    }
+
+    char *journal_file = zsys_sprintf ("%s.journal", self->state_file);
+    self->journal = journal_new (journal_file);
+    if (self->journal) {
+        int count = journal_replay (self->journal, s_osrv_journal_replay, self);
+        log_info ("outage_actor: replayed %d transitions from %s", count, journal_file);
+    }
+    else
+        log_error ("failed to open journal %s, transitions since last save will be lost on crash", journal_file);
+    zstr_free (&journal_file);
+    s_osrv_status_refresh (self);
+}
+
 static void
 s_osrv_check_dead_devices (s_osrv_t *self)
 {
     assert (self);
 
-    log_debug ("time to check dead devices");
-    zlistx_t *dead_devices = data_get_dead (self->assets);
+    logging_debug ("time to check dead devices");
+    int64_t start_us = zclock_usecs ();
+    uint64_t now_sec = vclock_time () / 1000;
+    zlistx_t *dead_devices = data_get_dead_at (self->assets, now_sec);
     if ( !dead_devices ) {
         log_error ("Can't get a list of dead devices (memory error)");
         return;
     }
-    log_debug ("dead_devices.size=%zu", zlistx_size (dead_devices));
+    logging_debug ("dead_devices.size=%zu", zlistx_size (dead_devices));
+    size_t folded = 0;
+    size_t dead = zlistx_size (dead_devices);
     for (void *it = zlistx_first (dead_devices);
             it != NULL;
             it = zlistx_next (dead_devices))
     {
         const char* source = (const char*) it;
-        log_debug ("\tsource=%s", source);
+        logging_debug ("\tsource=%s", source);
+        if (s_osrv_parent_is_dead (self, source, now_sec)) {
+            // folded into the alert of the parent device
+            logging_debug ("\t\tparent of source=%s is dead too", source);
+            s_osrv_resolve_alert (self, source);
+            folded++;
+            continue;
+        }
         s_osrv_activate_alert (self, source);
     }
+    if (folded > 0)
+        log_info ("%zu outages folded into alerts of their parent devices", folded);
     zlistx_destroy (&dead_devices);
+    stats_record_since (self->stats, STATS_CHECK_DEAD, start_us);
+    blackbox_record (BLACKBOX_SWEEP, NULL, (uint64_t) (zclock_usecs () - start_us), dead);
 }
 
+// copy each published status view to the shared memory table, so other
+// agents can look assets up without asking us
+// * FILE/path - (re)create the table at path
+// * PUBLISHED - new view was published
+static void
+s_osrv_status_writer (zsock_t *pipe, void *args)
+{
+    status_t *status = (status_t *) args;
+    int reader = status_reader_new (status);
+    if (reader < 0)
+        log_error ("Too many status readers, shared memory table won't be written");
+    zsock_signal (pipe, 0);
+
+    fty_outage_status_t *table = NULL;
+    uint64_t version = 0;
+    while (!zsys_interrupted) {
+        zmsg_t *msg = zmsg_recv (pipe);
+        if (!msg)
+            break;
+        char *command = zmsg_popstr (msg);
+        if (!command || streq (command, "$TERM")) {
+            zstr_free (&command);
+            zmsg_destroy (&msg);
+            break;
+        }
+        if (streq (command, "FILE")) {
+            char *path = zmsg_popstr (msg);
+            fty_outage_status_destroy (&table);
+            if (path) {
+                char *dir = strdup (path);
+                char *slash = strrchr (dir, '/');
+                if (slash && slash != dir) {
+                    *slash = '\0';
+                    zsys_dir_create ("%s", dir);
+                }
+                zstr_free (&dir);
+                table = fty_outage_status_create (path, 0);
+                if (!table)
+                    log_error ("Can't create status table %s", path);
+                version = 0;
+            }
+            zstr_free (&path);
+        }
+        else
+        if (streq (command, "PUBLISHED") && table && reader >= 0) {
+            const status_view_t *view = status_enter (status, reader);
+            if (view->version != version) {
+                int64_t start_us = zclock_usecs ();
+                size_t skipped = 0;
+                if (fty_outage_status_begin (table, status_view_size (view)) == 0) {
+                    for (size_t i = 0; i < status_view_size (view); i++) {
+                        const char *asset_name;
+                        const status_record_t *record = status_view_at (view, i, &asset_name);
+                        uint32_t flags = (record->flags & STATUS_ALERT_ACTIVE) ? FTY_OUTAGE_STATUS_ALERT_ACTIVE : 0;
+                        if (fty_outage_status_append (table, asset_name, record->last_time_seen_sec, record->ttl_sec,
+                                                      record->expires_sec, record->maintenance_until_sec, flags) != 0)
+                            skipped++;
+                    }
+                    fty_outage_status_commit (table, view->time_sec);
+                    version = view->version;
+                }
+                if (skipped > 0)
+                    log_warning ("%zu assets with too long names are not in status table", skipped);
+                log_debug ("status table: %zu assets written in %" PRIi64 " us",
+                           status_view_size (view), zclock_usecs () - start_us);
+            }
+            status_leave (status, reader);
+        }
+        zstr_free (&command);
+        zmsg_destroy (&msg);
+    }
+    fty_outage_status_destroy (&table);
+    if (reader >= 0)
+        status_reader_destroy (status, reader);
+}
+
+static void
+s_osrv_prime (s_osrv_t *self);
+
+static void
+metric_processing (fty::shm::shmMetrics& metrics, void* args);
+
+static void
+s_osrv_handle_message (s_osrv_t *self, const char *command, const char *address,
+                       const char *sender, const char *subject, zmsg_t **message_p, uint64_t now_sec);
+
 /*
  * return values :
  * 1 - $TERM recieved
+ * 2 - SYNC recieved, caller signals all previous commands are processed
  * 0 - message processed and deleted
  */
 
@@ -404,14 +1252,40 @@ s_osrv_actor_commands (s_osrv_t* self, zmsg_t **message_p)
     if (streq (command, "STATE-FILE"))
     {
         char *state_file = zmsg_popstr(message);
+        char *legacy_state_file = zmsg_popstr(message);
         if (state_file) {
-            self->state_file = strdup (state_file);
             log_debug ("STATE-FILE: %s", state_file);
-            int r = s_osrv_load (self);
-            if (r != 0)
-                log_error ("failed to load state file %s: %m", self->state_file);
+            s_osrv_set_state_file (self, state_file, legacy_state_file);
         }
         zstr_free(&state_file);
+        zstr_free(&legacy_state_file);
+    }
+    else
+    if (streq (command, "PRIME"))
+    {
+        s_osrv_prime (self);
+    }
+    else
+    if (streq (command, "CATALOG-CHECK"))
+    {
+        char *asset_agent = zmsg_popstr (message);
+        if (asset_agent)
+            s_osrv_request_catalog_check (self, asset_agent);
+        zstr_free (&asset_agent);
+    }
+    else
+    if (streq (command, "STATUS-FILE"))
+    {
+        char *status_file = zmsg_popstr(message);
+        zactor_destroy (&self->status_writer);
+        // empty path disables the table
+        if (status_file && *status_file) {
+            log_debug ("STATUS-FILE: %s", status_file);
+            self->status_writer = zactor_new (s_osrv_status_writer, self->status);
+            zstr_sendx (self->status_writer, "FILE", status_file, NULL);
+            zstr_send (self->status_writer, "PUBLISHED");
+        }
+        zstr_free(&status_file);
     }
     else
     if (streq (command, "VERBOSE"))
@@ -428,6 +1302,118 @@ s_osrv_actor_commands (s_osrv_t* self, zmsg_t **message_p)
         }
         zstr_free(&maintenance_expiration);
     }
+    else
+    if (streq (command, "RESEND-ACTIVE"))
+    {
+        char *resend = zmsg_popstr(message);
+        if (resend) {
+            self->resend_active = streq (resend, "true");
+            log_debug ("RESEND-ACTIVE: %s", resend);
+        }
+        zstr_free(&resend);
+    }
+    else
+    if (streq (command, "STATS-INTERVAL"))
+    {
+        char *interval = zmsg_popstr(message);
+        if (interval) {
+            self->stats_interval_ms = (uint64_t) atoll (interval);
+            log_debug ("STATS-INTERVAL: \"%s\"/%" PRIu64, interval, self->stats_interval_ms);
+        }
+        zstr_free(&interval);
+    }
+    else
+    if (streq (command, "STALL-THRESHOLD"))
+    {
+        char *threshold = zmsg_popstr(message);
+        if (threshold) {
+            watchdog_set_threshold (self->watchdog, (uint64_t) atoll (threshold));
+            log_debug ("STALL-THRESHOLD: \"%s\"", threshold);
+        }
+        zstr_free(&threshold);
+    }
+    else
+    if (streq (command, "RECORD"))
+    {
+        char *record_file = zmsg_popstr(message);
+        recording_destroy (&self->recording);
+        // empty path stops recording
+        if (record_file && *record_file) {
+            log_info ("RECORD: %s", record_file);
+            self->recording = recording_new (record_file);
+        }
+        zstr_free(&record_file);
+    }
+    else
+    if (streq (command, "METRICS"))
+    {
+        // metrics of a replayed recording, frame per metric
+        fty::shm::shmMetrics metrics;
+        zframe_t *frame;
+        while ((frame = zmsg_pop (message))) {
+            fty_proto_t *metric = s_osrv_recorded_metric (frame);
+            if (metric)
+                metrics.add (metric);
+            zframe_destroy (&frame);
+        }
+        stats_add (self->stats, STATS_METRICS, metrics.size ());
+        s_osrv_record_metrics (self, metrics);
+        metric_processing (metrics, self);
+    }
+    else
+    if (streq (command, "STREAM") || streq (command, "MAILBOX"))
+    {
+        // message of a replayed recording: [stream], sender, subject, message frames
+        bool stream = streq (command, "STREAM");
+        char *address = stream ? zmsg_popstr (message) : NULL;
+        char *sender = zmsg_popstr (message);
+        char *subject = zmsg_popstr (message);
+        if (sender && subject && (address || !stream))
+            s_osrv_handle_message (self, stream ? "STREAM DELIVER" : "MAILBOX DELIVER", address ? address : "",
+                sender, subject, message_p, vclock_time () / 1000);
+        zstr_free (&address);
+        zstr_free (&sender);
+        zstr_free (&subject);
+    }
+    else
+    if (streq (command, "SYNC"))
+    {
+        zstr_free (&command);
+        zmsg_destroy (message_p);
+        return 2;
+    }
+    else
+    if (streq (command, "SNAPSHOT-INTERVAL"))
+    {
+        char *interval = zmsg_popstr(message);
+        if (interval) {
+            self->snapshot_interval_ms = (uint64_t) atoll (interval);
+            log_debug ("SNAPSHOT-INTERVAL: \"%s\"/%" PRIu64, interval, self->snapshot_interval_ms);
+        }
+        zstr_free(&interval);
+    }
+    else
+    if (streq (command, "SNAPSHOT-PRODUCER"))
+    {
+        // own client, main one is the producer of alert stream
+        char *endpoint = zmsg_popstr (message);
+        char *name = zmsg_popstr (message);
+        char *stream = zmsg_popstr (message);
+
+        if (endpoint && name && stream) {
+            log_debug ("SNAPSHOT-PRODUCER: %s/%s/%s", endpoint, name, stream);
+            mlm_client_destroy (&self->snapshot_client);
+            self->snapshot_client = mlm_client_new ();
+            if (mlm_client_connect (self->snapshot_client, endpoint, 1000, name) == -1
+            ||  mlm_client_set_producer (self->snapshot_client, stream) == -1) {
+                log_error ("Cannot connect producer of outage snapshots to %s", endpoint);
+                mlm_client_destroy (&self->snapshot_client);
+            }
+        }
+        zstr_free (&endpoint);
+        zstr_free (&name);
+        zstr_free (&stream);
+    }
     else {
         log_error ("Unknown actor command: %s.\n", command);
     }
@@ -437,15 +1423,12 @@ s_osrv_actor_commands (s_osrv_t* self, zmsg_t **message_p)
     return 0;
 }
 
-void
-metric_processing (fty::shm::shmMetrics& metrics, void* args) {
-  
-  s_osrv_t *self = (s_osrv_t *) args;
-
-  for (auto &element : metrics) {
+// touch the asset a metric from shm comes from
+static void
+s_osrv_process_metric (s_osrv_t *self, fty_proto_t *element, uint64_t now_sec)
+{
     const char *is_computed = fty_proto_aux_string (element, "x-cm-count", NULL);
     if ( !is_computed ) {
-        uint64_t now_sec = zclock_time() / 1000;
         uint64_t timestamp = fty_proto_time (element);
         const char* port = fty_proto_aux_string (element, FTY_PROTO_METRICS_SENSOR_AUX_PORT, NULL);
 
@@ -456,35 +1439,45 @@ metric_processing (fty::shm::shmMetrics& metrics, void* args) {
             if (NULL == source) {
                 log_error("Sensor message malformed: found %s='%s' but %s is missing", FTY_PROTO_METRICS_SENSOR_AUX_PORT,
                         port, FTY_PROTO_METRICS_SENSOR_AUX_SNAME);
-                continue;
+                return;
             }
-            log_debug ("Sensor '%s' on '%s'/'%s' is still alive", source,  fty_proto_name (element), port);
-            s_osrv_resolve_alert (self, source);
-            int rv = data_touch_asset (self->assets, source, timestamp, fty_proto_ttl (element), now_sec);
-            if ( rv == -1 )
-                log_error ("asset: name = %s, topic=%s metric is from future! ignore it", source, mlm_client_subject (self->client));
+            logging_debug ("Sensor '%s' on '%s'/'%s' is still alive", source,  fty_proto_name (element), port);
+            s_osrv_touch_asset (self, source, fty_proto_name (element), timestamp, fty_proto_ttl (element), now_sec);
         }
         else {
             // is it from sensor? no
             const char *source = fty_proto_name (element);
-            s_osrv_resolve_alert (self, source);
-            int rv = data_touch_asset (self->assets, source, timestamp, fty_proto_ttl (element), now_sec);
-            if ( rv == -1 )
-                log_error ("asset: name = %s, topic=%s metric is from future! ignore it", source, mlm_client_subject (self->client));
+            s_osrv_touch_asset (self, source, NULL, timestamp, fty_proto_ttl (element), now_sec);
         }
     }
     else {
         // intentionally left empty
         // so it is metric from agent-cm -> it is not comming from the device itself ->ignore it
     }
-  }
 }
 
+// touch assets of a batch read from shm, called by the actor with a batch
+// handed over by the polling actor, never from the polling thread itself
+static void
+metric_processing (fty::shm::shmMetrics& metrics, void* args) {
+  
+  s_osrv_t *self = (s_osrv_t *) args;
+  // one timestamp for the whole batch
+  uint64_t now_sec = vclock_time () / 1000;
+
+  for (auto &element : metrics)
+    s_osrv_process_metric (self, element, now_sec);
+}
+
+// read metrics from shm each polling interval and pass them to the actor,
+// which owns the outage state; nothing of s_osrv_t is touched here
+// * STOP - stop reading shm, reply STOPPED after all batches sent so far
 void
 outage_metric_polling (zsock_t *pipe, void *args)
 {
   zpoller_t *poller = zpoller_new (pipe, NULL);
   zsock_signal (pipe, 0);
+  bool stopped = false;
 
   while (!zsys_interrupted)
   {
@@ -493,12 +1486,16 @@ outage_metric_polling (zsock_t *pipe, void *args)
           log_info ("outage_actor: Terminating.");
           break;
       }
-      if (zpoller_expired (poller)) {
-        fty::shm::shmMetrics result;
-        log_debug("read metrics");
-        fty::shm::read_metrics(".*", ".*", result);
-        log_debug("i have read %d metric", result.size());
-        metric_processing(result, args);
+      if (zpoller_expired (poller) && !stopped) {
+        fty::shm::shmMetrics *result = new fty::shm::shmMetrics ();
+        logging_debug ("read metrics");
+        FTY_OUTAGE_PROBE (shm__scan__start);
+        int64_t start_us = zclock_usecs ();
+        fty::shm::read_metrics(".*", ".*", *result);
+        uint64_t read_us = (uint64_t) (zclock_usecs () - start_us);
+        FTY_OUTAGE_PROBE2 (shm__scan__end, result->size (), read_us);
+        logging_debug ("i have read %zu metric", result->size());
+        zsock_send (pipe, "sp8", "METRICS", (void *) result, read_us);
       }
       if (which == pipe) {
       zmsg_t *msg = zmsg_recv (pipe);
@@ -510,6 +1507,10 @@ outage_metric_polling (zsock_t *pipe, void *args)
                     zmsg_destroy (&msg);
                     break;
                 }
+                if (streq (cmd, "STOP")) {
+                    stopped = true;
+                    zsock_send (pipe, "sp8", "STOPPED", NULL, (uint64_t) 0);
+                }
                 zstr_free (&cmd);
             }
             zmsg_destroy (&msg);
@@ -520,12 +1521,510 @@ outage_metric_polling (zsock_t *pipe, void *args)
   zpoller_destroy(&poller);
 }
 
+// delete metrics batches still queued on the pipe of polling actor, which
+// zactor_destroy would drop with the pointers; wait until the actor
+// confirms it stopped reading shm, or it is gone
+static void
+s_osrv_drain_metrics (zactor_t *metric_poll)
+{
+    zstr_send (metric_poll, "STOP");
+    zsock_set_rcvtimeo (zactor_sock (metric_poll), 1000);
+    size_t drained = 0;
+    while (true) {
+        zmsg_t *msg = zmsg_recv (metric_poll);
+        if (!msg || zmsg_signal (msg) >= 0) {
+            zmsg_destroy (&msg);
+            break;
+        }
+        char *command = zmsg_popstr (msg);
+        if (command && streq (command, "METRICS")) {
+            zframe_t *frame = zmsg_pop (msg);
+            if (frame && zframe_size (frame) == sizeof (void *)) {
+                fty::shm::shmMetrics *result;
+                memcpy (&result, zframe_data (frame), sizeof (result));
+                delete result;
+                drained++;
+            }
+            zframe_destroy (&frame);
+        }
+        bool stopped = command && streq (command, "STOPPED");
+        zstr_free (&command);
+        zmsg_destroy (&msg);
+        if (stopped)
+            break;
+    }
+    if (drained > 0)
+        log_debug ("outage_actor: dropped %zu metrics batches not processed before shutdown", drained);
+}
+
+// seed last seen times of tracked assets from shm before the first polling
+// cycle; shm is scanned once, metrics of assets we don't track are skipped
+static void
+s_osrv_prime (s_osrv_t *self)
+{
+    assert (self);
+
+    int64_t start_ms = zclock_mono ();
+    // metrics of sensors are published by the device they are attached to
+    zhashx_t *names = zhashx_new ();
+    zhashx_t *assets = self->assets->assets;
+    for (expiration_t *e = (expiration_t *) zhashx_first (assets);
+                       e != NULL;
+                       e = (expiration_t *) zhashx_next (assets))
+    {
+        const char *name = e->parent ? e->parent : (const char *) zhashx_cursor (assets);
+        zhashx_insert (names, name, (void *) "");
+    }
+
+    fty::shm::shmMetrics metrics;
+    fty::shm::read_metrics (".*", ".*", metrics);
+    int64_t read_ms = zclock_mono () - start_ms;
+    uint64_t now_sec = vclock_time () / 1000;
+    size_t used = 0;
+    for (auto &element : metrics) {
+        if (!zhashx_lookup (names, fty_proto_name (element)))
+            continue;
+        s_osrv_process_metric (self, element, now_sec);
+        used++;
+    }
+    log_info ("outage_actor: primed liveness of %zu assets from %zu of %zu metrics in %" PRIi64 " ms (shm read %" PRIi64 " ms)",
+              zhashx_size (names), used, metrics.size (), zclock_mono () - start_ms, read_ms);
+    zhashx_destroy (&names);
+}
+
 
 //  --------------------------------------------------------------------------
 //  Handle mailbox messages
 
+// return true if string is a number of seconds (TTL), not an asset name
+static bool
+s_is_ttl (const char *string)
+{
+    if (!string || !*string)
+        return false;
+    for (const char *p = string; *p; p++) {
+        if (!isdigit ((unsigned char) *p))
+            return false;
+    }
+    return true;
+}
+
+// select assets for bulk maintenance, names go to matched (tracked assets)
+// and missing (asked for by name, but not tracked)
+// return reason of error or NULL
+static const char *
+s_osrv_select_assets (s_osrv_t *self, const char *selector, zmsg_t *request,
+                      zlistx_t *matched, zlistx_t *missing)
+{
+    assert (self);
+    assert (selector);
+
+    if (streq (selector, "ASSETS")) {
+        char *asset_name;
+        while ((asset_name = zmsg_popstr (request)) != NULL) {
+            zlistx_add_end (data_lookup (self->assets, asset_name) ? matched : missing, asset_name);
+            zstr_free (&asset_name);
+        }
+        return NULL;
+    }
+
+    char *arg = zmsg_popstr (request);
+    if (!arg)
+        return "Missing selector argument";
+    zrex_t *rex = NULL;
+    if (streq (selector, "REGEX")) {
+        rex = zrex_new (arg);
+        if (!rex || !zrex_valid (rex)) {
+            zrex_destroy (&rex);
+            zstr_free (&arg);
+            return "Invalid regex";
+        }
+    }
+    else
+    if (!streq (selector, "SUBTYPE") && !streq (selector, "PARENT")) {
+        zstr_free (&arg);
+        return "Unsupported selector";
+    }
+
+    // single pass over tracked assets
+    zhashx_t *assets = self->assets->assets;
+    for (expiration_t *e = (expiration_t *) zhashx_first (assets);
+                       e != NULL;
+                       e = (expiration_t *) zhashx_next (assets))
+    {
+        const char *asset_name = (const char *) zhashx_cursor (assets);
+        bool match;
+        if (rex)
+            match = zrex_matches (rex, asset_name);
+        else
+        if (streq (selector, "SUBTYPE"))
+            match = e->subtype && streq (e->subtype, arg);
+        else
+            // device and everything attached to it
+            match = streq (asset_name, arg) || (e->parent && streq (e->parent, arg));
+        if (match)
+            zlistx_add_end (matched, (void *) asset_name);
+    }
+    zrex_destroy (&rex);
+    zstr_free (&arg);
+    return NULL;
+}
+
+// * REQUEST/'msg-correlation-id'/MAINTENANCE_BULK/<mode>/<expiration>/<selector>/<arguments>
+// reply OK/<number of assets switched>/<number of missing assets>/missing1/.../missingN
+static void
+s_osrv_maintenance_bulk (s_osrv_t *self, zmsg_t *request, zmsg_t *reply)
+{
+    assert (self);
+
+    char *mode_str = zmsg_popstr (request);
+    char *ttl_str = zmsg_popstr (request);
+    char *selector = zmsg_popstr (request);
+
+    if (!mode_str) {
+        zmsg_addstr (reply, "ERROR");
+        zmsg_addstr (reply, "Missing maintenance mode");
+    }
+    else
+    if (!streq (mode_str, "enable") && !streq (mode_str, "disable")) {
+        zmsg_addstr (reply, "ERROR");
+        zmsg_addstr (reply, "Unsupported maintenance mode");
+    }
+    else
+    if (!selector) {
+        zmsg_addstr (reply, "ERROR");
+        zmsg_addstr (reply, "Missing selector");
+    }
+    else {
+        int mode = streq (mode_str, "enable") ? ENABLE_MAINTENANCE : DISABLE_MAINTENANCE;
+        // empty expiration means the default one
+        int expiration_ttl = s_is_ttl (ttl_str) ? atoi (ttl_str) : self->default_maintenance_expiration;
+
+        zlistx_t *matched = zlistx_new ();
+        zlistx_t *missing = zlistx_new ();
+        zlistx_set_duplicator (matched, (zlistx_duplicator_fn *) strdup);
+        zlistx_set_destructor (matched, (zlistx_destructor_fn *) zstr_free);
+        zlistx_set_duplicator (missing, (zlistx_duplicator_fn *) strdup);
+        zlistx_set_destructor (missing, (zlistx_destructor_fn *) zstr_free);
+
+        const char *error = s_osrv_select_assets (self, selector, request, matched, missing);
+        if (error) {
+            zmsg_addstr (reply, "ERROR");
+            zmsg_addstr (reply, error);
+        }
+        else {
+            for (void *it = zlistx_first (matched); it != NULL; it = zlistx_next (matched))
+                s_osrv_maintenance_mode (self, (const char *) it, mode, expiration_ttl);
+            log_info ("outage: maintenance mode %sabled for %zu assets (%s), %zu assets not found",
+                      mode == ENABLE_MAINTENANCE ? "en" : "dis", zlistx_size (matched), selector, zlistx_size (missing));
+
+            zmsg_addstr (reply, "OK");
+            zmsg_addstrf (reply, "%zu", zlistx_size (matched));
+            zmsg_addstrf (reply, "%zu", zlistx_size (missing));
+            for (void *it = zlistx_first (missing); it != NULL; it = zlistx_next (missing))
+                zmsg_addstr (reply, (const char *) it);
+        }
+        zlistx_destroy (&matched);
+        zlistx_destroy (&missing);
+    }
+    zstr_free (&mode_str);
+    zstr_free (&ttl_str);
+    zstr_free (&selector);
+}
+
+// select assets by selector with arguments kept in a list (schedules)
+// return reason of error or NULL
+static const char *
+s_osrv_select_by_list (s_osrv_t *self, const char *selector, zlistx_t *arguments,
+                       zlistx_t *matched, zlistx_t *missing)
+{
+    zmsg_t *request = zmsg_new ();
+    for (void *it = zlistx_first (arguments); it != NULL; it = zlistx_next (arguments))
+        zmsg_addstr (request, (const char *) it);
+    const char *error = s_osrv_select_assets (self, selector, request, matched, missing);
+    zmsg_destroy (&request);
+    return error;
+}
+
+// put assets of the schedules, whose window opened, into maintenance until
+// the end of the window, which ends it without any further timer
+static void
+s_osrv_run_schedules (s_osrv_t *self, uint64_t now_sec)
+{
+    assert (self);
+
+    if (schedule_size (self->schedules) == 0 || schedule_next (self->schedules) > now_sec)
+        return;
+
+    schedule_entry_t *entry;
+    uint64_t window_end_sec;
+    while ((entry = schedule_pop (self->schedules, now_sec, &window_end_sec)) != NULL) {
+        zlistx_t *matched = zlistx_new ();
+        zlistx_t *missing = zlistx_new ();
+        zlistx_set_duplicator (matched, (zlistx_duplicator_fn *) strdup);
+        zlistx_set_destructor (matched, (zlistx_destructor_fn *) zstr_free);
+        zlistx_set_duplicator (missing, (zlistx_duplicator_fn *) strdup);
+        zlistx_set_destructor (missing, (zlistx_destructor_fn *) zstr_free);
+
+        const char *error = s_osrv_select_by_list (self, entry->selector, entry->arguments, matched, missing);
+        if (error)
+            log_error ("outage: maintenance schedule '%s': %s", entry->id, error);
+        size_t count = 0;
+        for (void *it = error ? NULL : zlistx_first (matched); it != NULL; it = zlistx_next (matched)) {
+            // longer maintenance requested by user is kept
+            expiration_t *e = data_lookup (self->assets, (const char *) it);
+            if (e && e->maintenance_until_sec >= window_end_sec)
+                continue;
+            s_osrv_maintenance_mode (self, (const char *) it, ENABLE_MAINTENANCE, (int) (window_end_sec - now_sec));
+            count++;
+        }
+        log_info ("outage: maintenance schedule '%s' opened window until %" PRIu64 " for %zu assets, next window at %" PRIu64,
+                  entry->id, window_end_sec, count, entry->next_sec);
+        zlistx_destroy (&matched);
+        zlistx_destroy (&missing);
+    }
+}
+
+static void
+s_osrv_save_schedules (s_osrv_t *self)
+{
+    if (self->schedule_file && schedule_save (self->schedules, self->schedule_file) != 0)
+        log_error ("failed to save maintenance schedules %s", self->schedule_file);
+}
+
+// * REQUEST/'msg-correlation-id'/SCHEDULE_ADD/<id>/<start>/<period>/<duration>/<selector>/<arguments>
+// reply OK/<start of the next window>
+static void
+s_osrv_schedule_add (s_osrv_t *self, zmsg_t *request, zmsg_t *reply)
+{
+    assert (self);
+
+    char *id = zmsg_popstr (request);
+    char *start = zmsg_popstr (request);
+    char *period = zmsg_popstr (request);
+    char *duration = zmsg_popstr (request);
+    char *selector = zmsg_popstr (request);
+    zlistx_t *arguments = zlistx_new ();
+    zlistx_set_destructor (arguments, (zlistx_destructor_fn *) zstr_free);
+    for (char *arg = zmsg_popstr (request); arg; arg = zmsg_popstr (request))
+        zlistx_add_end (arguments, arg);
+
+    const char *error = NULL;
+    if (!id || !*id || !s_is_ttl (start) || !s_is_ttl (period) || !s_is_ttl (duration) || !selector)
+        error = "Invalid schedule";
+    else {
+        // selector is checked now, not when the window opens
+        zlistx_t *matched = zlistx_new ();
+        zlistx_t *missing = zlistx_new ();
+        error = s_osrv_select_by_list (self, selector, arguments, matched, missing);
+        zlistx_destroy (&matched);
+        zlistx_destroy (&missing);
+    }
+    if (!error
+    &&  schedule_add (self->schedules, id, strtoull (start, NULL, 10), strtoull (period, NULL, 10),
+                      strtoull (duration, NULL, 10), selector, arguments, vclock_time () / 1000) != 0)
+        error = "Invalid schedule";
+
+    if (error) {
+        zmsg_addstr (reply, "ERROR");
+        zmsg_addstr (reply, error);
+    }
+    else {
+        s_osrv_save_schedules (self);
+        schedule_entry_t *entry = schedule_lookup (self->schedules, id);
+        log_info ("outage: maintenance schedule '%s' added, next window at %" PRIu64, id, entry->next_sec);
+        zmsg_addstr (reply, "OK");
+        zmsg_addstrf (reply, "%" PRIu64, entry->next_sec);
+    }
+    zlistx_destroy (&arguments);
+    zstr_free (&id);
+    zstr_free (&start);
+    zstr_free (&period);
+    zstr_free (&duration);
+    zstr_free (&selector);
+}
+
+// * REQUEST/'msg-correlation-id'/SCHEDULE_LIST
+// reply OK/<count>, then id/start/period/duration/next/selector/<number of arguments>/arguments for each schedule
+static void
+s_osrv_schedule_list (s_osrv_t *self, zmsg_t *reply)
+{
+    assert (self);
+
+    zhashx_t *entries = self->schedules->entries;
+    zmsg_addstr (reply, "OK");
+    zmsg_addstrf (reply, "%zu", zhashx_size (entries));
+    for (schedule_entry_t *entry = (schedule_entry_t *) zhashx_first (entries);
+                           entry != NULL;
+                           entry = (schedule_entry_t *) zhashx_next (entries))
+    {
+        zmsg_addstr (reply, entry->id);
+        zmsg_addstrf (reply, "%" PRIu64, entry->start_sec);
+        zmsg_addstrf (reply, "%" PRIu64, entry->period_sec);
+        zmsg_addstrf (reply, "%" PRIu64, entry->duration_sec);
+        zmsg_addstrf (reply, "%" PRIu64, entry->next_sec);
+        zmsg_addstr (reply, entry->selector);
+        zmsg_addstrf (reply, "%zu", zlistx_size (entry->arguments));
+        for (void *it = zlistx_first (entry->arguments); it != NULL; it = zlistx_next (entry->arguments))
+            zmsg_addstr (reply, (const char *) it);
+    }
+}
+
+// return status of the asset for queries, asset without any time seen has
+// no outage to report
+static const char *
+s_osrv_asset_status (const status_record_t *record, uint64_t now_sec)
+{
+    if (record->maintenance_until_sec > now_sec)
+        return "maintenance";
+    if (record->last_time_seen_sec == 0)
+        return "unknown";
+    if (record->expires_sec <= now_sec)
+        return "dead";
+    return "alive";
+}
+
+// * REQUEST/'msg-correlation-id'/LIST_DEAD/<limit>/<after>
+// * REQUEST/'msg-correlation-id'/LIST_MAINTENANCE/<limit>/<after>
+// reply OK/<total>/<count>/asset1/time1/.../assetN/timeN, assets ordered by
+// name and following 'after', time is last seen or end of maintenance
+// served from the status view, which is ordered by name already
+static void
+s_osrv_list_assets (s_osrv_t *self, const char *status, zmsg_t *request, zmsg_t *reply)
+{
+    assert (self);
+    assert (status);
+
+    char *limit_str = zmsg_popstr (request);
+    char *after = zmsg_popstr (request);
+    size_t limit = s_is_ttl (limit_str) ? (size_t) strtoul (limit_str, NULL, 10) : 0;
+    if (limit == 0)
+        limit = QUERY_PAGE_DEFAULT;
+    if (limit > QUERY_PAGE_MAX)
+        limit = QUERY_PAGE_MAX;
+
+    uint64_t now_sec = vclock_time () / 1000;
+    // last published view, at most STATUS_PUBLISH_MS behind the updates
+    const status_view_t *view = status_enter (self->status, self->status_reader);
+    size_t first = after && *after ? status_view_after (view, after) : 0;
+    std::vector<size_t> page;
+    page.reserve (limit);
+    size_t total = 0;
+    for (size_t i = 0; i < status_view_size (view); i++) {
+        const status_record_t *record = status_view_at (view, i, NULL);
+        if (!streq (s_osrv_asset_status (record, now_sec), status))
+            continue;
+        total++;
+        if (i >= first && page.size () < limit)
+            page.push_back (i);
+    }
+
+    zmsg_addstr (reply, "OK");
+    zmsg_addstrf (reply, "%zu", total);
+    zmsg_addstrf (reply, "%zu", page.size ());
+    for (size_t i : page) {
+        const char *asset_name = NULL;
+        const status_record_t *record = status_view_at (view, i, &asset_name);
+        zmsg_addstr (reply, asset_name);
+        zmsg_addstrf (reply, "%" PRIu64, streq (status, "maintenance") ? record->maintenance_until_sec : record->last_time_seen_sec);
+    }
+    status_leave (self->status, self->status_reader);
+    zstr_free (&limit_str);
+    zstr_free (&after);
+}
+
+// * REQUEST/'msg-correlation-id'/ASSET_STATUS/asset1/.../assetN
+// reply OK/<count>, then asset/status/last_seen/ttl/expires_at/maintenance_until/alert for each asset
+// status is alive, dead, maintenance or unknown (not tracked or never seen)
+static void
+s_osrv_asset_status_query (s_osrv_t *self, zmsg_t *request, zmsg_t *reply)
+{
+    assert (self);
+
+    if (zmsg_size (request) == 0) {
+        zmsg_addstr (reply, "ERROR");
+        zmsg_addstr (reply, "Missing asset");
+        return;
+    }
+    if (zmsg_size (request) > QUERY_PAGE_MAX) {
+        zmsg_addstr (reply, "ERROR");
+        zmsg_addstr (reply, "Too many assets");
+        return;
+    }
+
+    uint64_t now_sec = vclock_time () / 1000;
+    // last published view, at most STATUS_PUBLISH_MS behind the updates
+    const status_view_t *view = status_enter (self->status, self->status_reader);
+    zmsg_addstr (reply, "OK");
+    zmsg_addstrf (reply, "%zu", zmsg_size (request));
+    char *asset_name;
+    while ((asset_name = zmsg_popstr (request)) != NULL) {
+        const status_record_t *record = status_view_lookup (view, asset_name);
+        zmsg_addstr (reply, asset_name);
+        zmsg_addstr (reply, record ? s_osrv_asset_status (record, now_sec) : "unknown");
+        zmsg_addstrf (reply, "%" PRIu64, record ? record->last_time_seen_sec : 0);
+        zmsg_addstrf (reply, "%" PRIu64, record ? record->ttl_sec : 0);
+        zmsg_addstrf (reply, "%" PRIu64, record ? record->expires_sec : 0);
+        zmsg_addstrf (reply, "%" PRIu64, record ? record->maintenance_until_sec : 0);
+        zmsg_addstr (reply, record && (record->flags & STATUS_ALERT_ACTIVE) ? "1" : "0");
+        zstr_free (&asset_name);
+    }
+    status_leave (self->status, self->status_reader);
+}
+
+static void
+s_osrv_stats_add (const char *key, uint64_t value, void *arg)
+{
+    zmsg_t *pairs = (zmsg_t *) arg;
+    zmsg_addstr (pairs, key);
+    zmsg_addstrf (pairs, "%" PRIu64, value);
+}
+
+// reply with performance counters and latencies
+// OK/count/key1/value1/.../keyN/valueN
+static void
+s_osrv_stats (s_osrv_t *self, zmsg_t *reply)
+{
+    assert (self);
+    assert (reply);
+
+    zmsg_t *pairs = zmsg_new ();
+    stats_report (self->stats, s_osrv_stats_add, pairs);
+    zmsg_addstr (reply, "OK");
+    zmsg_addstrf (reply, "%zu", zmsg_size (pairs) / 2);
+    zframe_t *frame;
+    while ((frame = zmsg_pop (pairs)) != NULL)
+        zmsg_append (reply, &frame);
+    zmsg_destroy (&pairs);
+}
+
+static void
+s_osrv_stats_write (const char *key, uint64_t value, void *arg)
+{
+    int ttl = *(int *) arg;
+    char *metric = zsys_sprintf ("outage.%s", key);
+    char *string = zsys_sprintf ("%" PRIu64, value);
+    if (fty::shm::write_metric (STATS_ASSET, metric, string, strstr (key, "_us") ? "us" : "", ttl) < 0)
+        log_debug ("Can't publish %s to shm", metric);
+    zstr_free (&string);
+    zstr_free (&metric);
+}
+
+// publish performance counters and latencies as metrics of STATS_ASSET
+// to shm, they expire if the agent stops publishing them
 static void
-fty_outage_handle_mailbox (s_osrv_t *self, zmsg_t **msg)
+s_osrv_publish_stats (s_osrv_t *self)
+{
+    assert (self);
+
+    int ttl = (int) (self->stats_interval_ms * 2 / 1000);
+    if (ttl < 1)
+        ttl = 1;
+    stats_report (self->stats, s_osrv_stats_write, &ttl);
+}
+
+static void
+fty_outage_handle_mailbox (s_osrv_t *self, const char *mb_sender, const char *mb_subject, zmsg_t **msg)
 {
     if (self->verbose)
         zmsg_print (*msg);
@@ -542,8 +2041,9 @@ fty_outage_handle_mailbox (s_osrv_t *self, zmsg_t **msg)
             return;
         }
         char *command = zmsg_popstr (*msg);
-        char *sender = strdup (mlm_client_sender (self->client));
-        char *subject = strdup (mlm_client_subject (self->client));
+        char *sender = strdup (mb_sender);
+        stats_add (self->stats, STATS_MAILBOX, 1);
+        char *subject = strdup (mb_subject);
 
         // message model always enforce reply
         zmsg_t *reply = zmsg_new ();
@@ -569,8 +2069,8 @@ fty_outage_handle_mailbox (s_osrv_t *self, zmsg_t **msg)
                 if (last_frame) {
                     last_str = zframe_strdup (last_frame);
                     log_debug("last_str: %s", last_str);
-                    // '-' means that it's asset name, otherwise the expiration TTL
-                    if (strchr(last_str, '-') == NULL)
+                    // number is the expiration TTL, otherwise it's asset name
+                    if (s_is_ttl (last_str))
                         expiration_ttl = atoi(last_str);
                     zstr_free(&last_str);
                 }
@@ -584,24 +2084,24 @@ fty_outage_handle_mailbox (s_osrv_t *self, zmsg_t **msg)
                     log_debug("Maintenance mode: %s", mode_str);
 
                     if ( (streq (mode_str, "disable")) || (streq (mode_str, "enable")) ) {
-                        if (streq (mode_str, "disable")) {
+                        if (streq (mode_str, "disable"))
                             mode = DISABLE_MAINTENANCE;
-                            // also restore default TTL
-                            expiration_ttl = DEFAULT_ASSET_EXPIRATION_TIME_SEC;
-                        }
-                        // loop on assets...
+                        // loop on assets, command fails if any of them fails
                         int rv = -1;
+                        bool failed = false;
                         char *maint_asset = zmsg_popstr(*msg);
                         while (maint_asset) {
                             // trim potential ttl (last frame)
-                            if (strchr(maint_asset, '-') != NULL)
+                            if (!s_is_ttl (maint_asset)) {
                                 rv = s_osrv_maintenance_mode (self, maint_asset, mode, expiration_ttl);
+                                failed = failed || rv != 0;
+                            }
 
                             zstr_free(&maint_asset);
                             maint_asset = zmsg_popstr(*msg);
                         }
                         // Process result at the end
-                        if (rv == 0)
+                        if (rv == 0 && !failed)
                             zmsg_addstr (reply, "OK");
                         else {
                             zmsg_addstr (reply, "ERROR");
@@ -617,9 +2117,72 @@ fty_outage_handle_mailbox (s_osrv_t *self, zmsg_t **msg)
                 }
                 else {
                     zmsg_addstr (reply, "ERROR");
-                    zmsg_addstr (reply, "Missing maintenance mode");
+                    zmsg_addstr (reply, "Missing maintenance mode");
+                }
+
+            }
+            else if (streq (command, "MAINTENANCE_BULK")) {
+                // * REQUEST/'msg-correlation-id'/MAINTENANCE_BULK/<mode>/<expiration>/<selector>/<arguments>
+                // ex: bmsg request fty-outage GET REQUEST 1234 MAINTENANCE_BULK enable 3600 SUBTYPE epdu
+                s_osrv_maintenance_bulk (self, *msg, reply);
+            }
+            else if (streq (command, "SCHEDULE_ADD")) {
+                // * REQUEST/'msg-correlation-id'/SCHEDULE_ADD/<id>/<start>/<period>/<duration>/<selector>/<arguments>
+                // ex: bmsg request fty-outage GET REQUEST 1234 SCHEDULE_ADD fw 1600000000 604800 7200 SUBTYPE epdu
+                s_osrv_schedule_add (self, *msg, reply);
+            }
+            else if (streq (command, "SCHEDULE_DEL")) {
+                // * REQUEST/'msg-correlation-id'/SCHEDULE_DEL/<id>
+                char *id = zmsg_popstr (*msg);
+                if (id && schedule_delete (self->schedules, id) == 0) {
+                    s_osrv_save_schedules (self);
+                    log_info ("outage: maintenance schedule '%s' deleted", id);
+                    zmsg_addstr (reply, "OK");
+                }
+                else {
+                    zmsg_addstr (reply, "ERROR");
+                    zmsg_addstr (reply, "Unknown schedule");
                 }
-
+                zstr_free (&id);
+            }
+            else if (streq (command, "SCHEDULE_LIST")) {
+                // * REQUEST/'msg-correlation-id'/SCHEDULE_LIST
+                s_osrv_schedule_list (self, reply);
+            }
+            else if (streq (command, "LIST_DEAD")) {
+                // * REQUEST/'msg-correlation-id'/LIST_DEAD/<limit>/<after>
+                s_osrv_list_assets (self, "dead", *msg, reply);
+            }
+            else if (streq (command, "LIST_MAINTENANCE")) {
+                // * REQUEST/'msg-correlation-id'/LIST_MAINTENANCE/<limit>/<after>
+                s_osrv_list_assets (self, "maintenance", *msg, reply);
+            }
+            else if (streq (command, "ASSET_STATUS")) {
+                // * REQUEST/'msg-correlation-id'/ASSET_STATUS/asset1/.../assetN
+                s_osrv_asset_status_query (self, *msg, reply);
+            }
+            else if (streq (command, "STATS")) {
+                // * REQUEST/'msg-correlation-id'/STATS - get performance counters and latencies
+                s_osrv_stats (self, reply);
+            }
+            else if (streq (command, "BLACKBOX")) {
+                // * REQUEST/'msg-correlation-id'/BLACKBOX - dump the flight recorder, reply OK/<file>/<events recorded>
+                if (blackbox_dump_file () == 0) {
+                    log_info ("outage: flight recorder dumped to %s", blackbox_file ());
+                    zmsg_addstr (reply, "OK");
+                    zmsg_addstr (reply, blackbox_file ());
+                    zmsg_addstrf (reply, "%" PRIu64, blackbox_head ());
+                }
+                else {
+                    log_error ("outage: can't dump flight recorder to '%s'", blackbox_file ());
+                    zmsg_addstr (reply, "ERROR");
+                    zmsg_addstr (reply, "Dump failed");
+                }
+            }
+            else if (streq (command, "OUTAGE_SNAPSHOT")) {
+                // * REQUEST/'msg-correlation-id'/OUTAGE_SNAPSHOT - get all active outage alerts at once
+                zmsg_addstr (reply, "OK");
+                s_osrv_outage_snapshot (self, reply);
             }
             else {
                 // command is not expected
@@ -645,7 +2208,7 @@ fty_outage_handle_mailbox (s_osrv_t *self, zmsg_t **msg)
                             5000,
                             &reply);
         if (reply) {
-            log_error ("Could not send message to %s", mlm_client_sender (self->client));
+            log_error ("Could not send message to %s", sender);
             zmsg_destroy (&reply);
         }
 
@@ -660,6 +2223,108 @@ fty_outage_handle_mailbox (s_osrv_t *self, zmsg_t **msg)
 }
 
 // --------------------------------------------------------------------------
+// react on message received from malamute (or replayed from a recording),
+// message is destroyed
+static void
+s_osrv_handle_message (s_osrv_t *self, const char *command, const char *address,
+                       const char *sender, const char *subject, zmsg_t **message_p, uint64_t now_sec)
+{
+    assert (self);
+    assert (message_p && *message_p);
+
+    s_osrv_record_message (self, command, address, sender, subject, *message_p);
+
+    if (!is_fty_proto(*message_p)) {
+        if (streq (address, FTY_PROTO_STREAM_METRICS_UNAVAILABLE)) {
+            char *foo = zmsg_popstr (*message_p);
+            if ( foo && streq (foo, "METRICUNAVAILABLE")) {
+                zstr_free (&foo);
+                foo = zmsg_popstr (*message_p); // topic in form aaaa@bbb
+                const char* source = strstr (foo, "@") + 1;
+                s_osrv_resolve_alert (self, source);
+                if (data_lookup (self->assets, source))
+                    s_osrv_journal (self, JOURNAL_ASSET_DELETE, source, 0);
+                data_delete (self->assets, source);
+                s_osrv_status_update (self, source);
+            }
+            zstr_free (&foo);
+        }
+        else if (streq (command, "MAILBOX DELIVER") && streq (subject, "ASSETS")) {
+            // reply of asset agent with existing assets
+            watchdog_phase (self->watchdog, WATCHDOG_MAILBOX);
+            s_osrv_catalog_check (self, *message_p);
+        }
+        else if (streq (command, "MAILBOX DELIVER")) {
+            // someone is addressing us directly
+            log_debug("%s: MAILBOX DELIVER", __func__);
+            watchdog_phase (self->watchdog, WATCHDOG_MAILBOX);
+            fty_outage_handle_mailbox(self, sender, subject, message_p);
+        }
+        zmsg_destroy(message_p);
+        return;
+    }
+
+    fty_proto_t *bmsg = fty_proto_decode (message_p);
+    if (!bmsg)
+        return;
+
+    // resolve sent alert
+    if (fty_proto_id (bmsg) == FTY_PROTO_METRIC || streq (address, FTY_PROTO_STREAM_METRICS_SENSOR)) {
+        const char *is_computed = fty_proto_aux_string (bmsg, "x-cm-count", NULL);
+        stats_add (self->stats, STATS_METRICS, 1);
+        if ( !is_computed ) {
+            uint64_t timestamp = fty_proto_time (bmsg);
+            const char* port = fty_proto_aux_string (bmsg, FTY_PROTO_METRICS_SENSOR_AUX_PORT, NULL);
+
+            if (port != NULL ) {
+                // is it from sensor? yes
+                // get sensors attached to the 'asset' on the 'port'! we can have more then 1!
+                const char *source = fty_proto_aux_string (bmsg, FTY_PROTO_METRICS_SENSOR_AUX_SNAME, NULL);
+                if (NULL == source) {
+                    log_error("Sensor message malformed: found %s='%s' but %s is missing", FTY_PROTO_METRICS_SENSOR_AUX_PORT,
+                            port, FTY_PROTO_METRICS_SENSOR_AUX_SNAME);
+                    fty_proto_destroy (&bmsg);
+                    return;
+                }
+                logging_debug ("Sensor '%s' on '%s'/'%s' is still alive", source,  fty_proto_name (bmsg), port);
+                s_osrv_touch_asset (self, source, fty_proto_name (bmsg), timestamp, fty_proto_ttl (bmsg), now_sec);
+            }
+            else {
+                // is it from sensor? no
+                const char *source = fty_proto_name (bmsg);
+                s_osrv_touch_asset (self, source, NULL, timestamp, fty_proto_ttl (bmsg), now_sec);
+            }
+        }
+        else {
+            // intentionally left empty
+            // so it is metric from agent-cm -> it is not comming from the device itself ->ignore it
+        }
+    }
+    else
+    if (fty_proto_id (bmsg) == FTY_PROTO_ASSET) {
+        if (streq (fty_proto_operation (bmsg), FTY_PROTO_ASSET_OP_DELETE)
+             || !streq (fty_proto_aux_string (bmsg, FTY_PROTO_ASSET_STATUS, "active"), "active") )
+        {
+            const char* source = fty_proto_name (bmsg);
+            s_osrv_resolve_alert (self, source);
+        }
+        char *source = strdup (fty_proto_name (bmsg));
+        bool known = data_lookup (self->assets, source) != NULL;
+        data_put (self->assets, &bmsg);
+        bool tracked = data_lookup (self->assets, source) != NULL;
+        if (!known && tracked)
+            s_osrv_journal (self, JOURNAL_ASSET_ADD, source, 0);
+        else
+        if (known && !tracked)
+            s_osrv_journal (self, JOURNAL_ASSET_DELETE, source, 0);
+        // newly added asset must know whether it has an alert
+        s_osrv_sync_alert_flag (self, source);
+        s_osrv_status_update (self, source);
+        zstr_free (&source);
+    }
+    fty_proto_destroy (&bmsg);
+}
+
 // Create a new fty_outage_server
 void
 fty_outage_server (zsock_t *pipe, void *args)
@@ -667,21 +2332,50 @@ fty_outage_server (zsock_t *pipe, void *args)
     s_osrv_t *self = s_osrv_new ();
     assert (self);
 
-    zpoller_t *poller = zpoller_new (pipe, mlm_client_msgpipe (self->client), NULL);
+    zactor_t *metric_poll = zactor_new (outage_metric_polling, NULL);
+    assert (metric_poll);
+
+    zactor_t *writer = zactor_new (state_writer, NULL);
+    assert (writer);
+
+    zpoller_t *poller = zpoller_new (pipe, mlm_client_msgpipe (self->client), metric_poll, writer, NULL);
     assert (poller);
 
     zsock_signal (pipe, 0);
     log_info ("outage_actor: Started");
     //    poller timeout
-    uint64_t now_ms = zclock_mono ();
+    uint64_t now_ms = vclock_mono ();
     uint64_t last_dead_check_ms = now_ms;
     uint64_t last_save_ms = now_ms;
+    uint64_t last_snapshot_ms = now_ms;
+    uint64_t last_status_ms = now_ms;
+    uint64_t last_stats_ms = now_ms;
+    bool save_pending = false;
+    bool iterated = false;
 
-    zactor_t *metric_poll = zactor_new(outage_metric_polling, (void*) self);
     while (!zsys_interrupted)
     {
+        // previous iteration ends here, whichever way it went
+        if (iterated)
+            watchdog_end (self->watchdog);
+        watchdog_beat (self->watchdog);
+
         self->timeout_ms = fty_get_polling_interval() * 1000;
-        void *which = zpoller_wait (poller, self->timeout_ms);
+        // wake up sooner to sync pending journal records, publish status
+        // and keep the systemd watchdog fed
+        bool journal_wait = self->journal && journal_pending (self->journal) > 0;
+        bool status_wait = status_changed (self->status);
+        uint64_t wait_ms = self->timeout_ms;
+        if (journal_wait && wait_ms > JOURNAL_SYNC_MS)
+            wait_ms = JOURNAL_SYNC_MS;
+        if (status_wait && wait_ms > STATUS_PUBLISH_MS)
+            wait_ms = STATUS_PUBLISH_MS;
+        bool heartbeat_wait = watchdog_systemd (self->watchdog) && wait_ms > watchdog_interval (self->watchdog);
+        if (heartbeat_wait)
+            wait_ms = watchdog_interval (self->watchdog);
+        void *which = zpoller_wait (poller, (int) wait_ms);
+        watchdog_start (self->watchdog);
+        iterated = true;
 
         if (which == NULL) {
             if (zpoller_terminated(poller) || zsys_interrupted) {
@@ -690,24 +2384,63 @@ fty_outage_server (zsock_t *pipe, void *args)
             }
         }
 
-        now_ms = zclock_mono ();
+        now_ms = vclock_mono ();
+        uint64_t now_sec = vclock_time () / 1000;
+        // level of logging of hot paths follows the logger (verbose mode,
+        // reloaded log configuration)
+        logging_refresh ();
+
+        // transitions of the previous iterations are synced together
+        watchdog_phase (self->watchdog, WATCHDOG_JOURNAL);
+        if (self->journal)
+            journal_sync (self->journal, false);
+
+        // changes of the previous iterations are published together
+        watchdog_phase (self->watchdog, WATCHDOG_STATUS);
+        if (status_changed (self->status) && (now_ms - last_status_ms) >= STATUS_PUBLISH_MS) {
+            s_osrv_status_publish (self, now_sec);
+            last_status_ms = now_ms;
+        }
 
-        // save the state
-        if ((now_ms - last_save_ms) > SAVE_INTERVAL_MS) {
-            int r = s_osrv_save (self);
+        // save the state in background
+        watchdog_phase (self->watchdog, WATCHDOG_SAVE);
+        if (!save_pending
+        &&  ((now_ms - last_save_ms) > SAVE_INTERVAL_MS
+        ||   (self->journal && journal_size (self->journal) > JOURNAL_COMPACT_SIZE))) {
+            int r = s_osrv_save_background (self, writer);
             if (r != 0)
                 log_error ("failed to save state file %s", self->state_file);
+            save_pending = r == 0;
             last_save_ms = now_ms;
         }
 
+        watchdog_phase (self->watchdog, WATCHDOG_MAINTENANCE);
+        s_osrv_run_schedules (self, now_sec);
+        s_osrv_expire_maintenance (self, now_sec);
+
         // send alerts
-        if (zpoller_expired (poller) || (now_ms - last_dead_check_ms) > self->timeout_ms) {
+        watchdog_phase (self->watchdog, WATCHDOG_CHECK_DEAD);
+        if ((zpoller_expired (poller) && !journal_wait && !status_wait && !heartbeat_wait) || (now_ms - last_dead_check_ms) > self->timeout_ms) {
             s_osrv_check_dead_devices (self);
-            last_dead_check_ms = zclock_mono ();
+            last_dead_check_ms = vclock_mono ();
+        }
+
+        // publish outage snapshot
+        watchdog_phase (self->watchdog, WATCHDOG_PUBLISH);
+        if (self->snapshot_interval_ms > 0 && (now_ms - last_snapshot_ms) > self->snapshot_interval_ms) {
+            s_osrv_publish_snapshot (self);
+            last_snapshot_ms = now_ms;
+        }
+
+        // publish stats to shm
+        if (self->stats_interval_ms > 0 && (now_ms - last_stats_ms) > self->stats_interval_ms) {
+            s_osrv_publish_stats (self);
+            last_stats_ms = now_ms;
         }
 
         if (which == pipe) {
-            log_trace ("which == pipe");
+            logging_trace ("which == pipe");
+            watchdog_phase (self->watchdog, WATCHDOG_COMMAND);
             zmsg_t *msg = zmsg_recv(pipe);
             if (!msg)
                 break;
@@ -715,95 +2448,70 @@ fty_outage_server (zsock_t *pipe, void *args)
             int rv = s_osrv_actor_commands (self, &msg);
             if (rv == 1)
                 break;
+            if (rv == 2)
+                zsock_signal (pipe, 0);
+            continue;
+        }
+        else
+        if (which == metric_poll) {
+            watchdog_phase (self->watchdog, WATCHDOG_METRICS);
+            char *command = NULL;
+            void *metrics = NULL;
+            uint64_t read_us = 0;
+            if (zsock_recv (metric_poll, "sp8", &command, &metrics, &read_us) == 0 && command && streq (command, "METRICS")) {
+                fty::shm::shmMetrics *result = (fty::shm::shmMetrics *) metrics;
+                stats_record (self->stats, STATS_READ_METRICS, read_us);
+                stats_add (self->stats, STATS_METRICS, result->size ());
+                s_osrv_record_metrics (self, *result);
+                int64_t start_us = zclock_usecs ();
+                metric_processing (*result, self);
+                stats_record_since (self->stats, STATS_METRIC_PROCESSING, start_us);
+                delete result;
+            }
+            zstr_free (&command);
+            continue;
+        }
+        else
+        if (which == writer) {
+            watchdog_phase (self->watchdog, WATCHDOG_WRITER);
+            char *command = NULL;
+            int rv = -1;
+            if (zsock_recv (writer, "si", &command, &rv) == 0 && command && streq (command, "SAVED")) {
+                save_pending = false;
+                // rotated transitions are part of the saved state now,
+                // otherwise they are kept and replayed on start
+                if (rv == 0) {
+                    s_osrv_retire_legacy (self);
+                    if (self->journal)
+                        journal_discard_rotated (self->journal);
+                }
+                else {
+                    log_error ("failed to save state file %s", self->state_file);
+                    self->assets->changed = true;
+                }
+            }
+            zstr_free (&command);
             continue;
         }
         // react on incoming messages
         else
         if (which == mlm_client_msgpipe (self->client)) {
-            log_trace ("which == mlm_client_msgpipe");
+            logging_trace ("which == mlm_client_msgpipe");
+            watchdog_phase (self->watchdog, WATCHDOG_STREAM);
 
             zmsg_t *message = mlm_client_recv (self->client);
             if (!message)
                 break;
-
-            if (!is_fty_proto(message)) {
-                if (streq (mlm_client_address (self->client), FTY_PROTO_STREAM_METRICS_UNAVAILABLE)) {
-                    char *foo = zmsg_popstr (message);
-                    if ( foo && streq (foo, "METRICUNAVAILABLE")) {
-                        zstr_free (&foo);
-                        foo = zmsg_popstr (message); // topic in form aaaa@bbb
-                        const char* source = strstr (foo, "@") + 1;
-                        s_osrv_resolve_alert (self, source);
-                        data_delete (self->assets, source);
-                    }
-                    zstr_free (&foo);
-                }
-                else if (streq (mlm_client_command (self->client), "MAILBOX DELIVER")) {
-                    // someone is addressing us directly
-                    log_debug("%s: MAILBOX DELIVER", __func__);
-                    fty_outage_handle_mailbox(self, &message);
-                }
-                zmsg_destroy(&message);
-                continue;
-            }
-
-            fty_proto_t *bmsg = fty_proto_decode (&message);
-            if (!bmsg)
-                continue;
-
-            // resolve sent alert
-            if (fty_proto_id (bmsg) == FTY_PROTO_METRIC || streq (mlm_client_address (self->client), FTY_PROTO_STREAM_METRICS_SENSOR)) {
-                const char *is_computed = fty_proto_aux_string (bmsg, "x-cm-count", NULL);
-                if ( !is_computed ) {
-                    uint64_t now_sec = zclock_time() / 1000;
-                    uint64_t timestamp = fty_proto_time (bmsg);
-                    const char* port = fty_proto_aux_string (bmsg, FTY_PROTO_METRICS_SENSOR_AUX_PORT, NULL);
-
-                    if (port != NULL ) {
-                        // is it from sensor? yes
-                        // get sensors attached to the 'asset' on the 'port'! we can have more then 1!
-                        const char *source = fty_proto_aux_string (bmsg, FTY_PROTO_METRICS_SENSOR_AUX_SNAME, NULL);
-                        if (NULL == source) {
-                            log_error("Sensor message malformed: found %s='%s' but %s is missing", FTY_PROTO_METRICS_SENSOR_AUX_PORT,
-                                    port, FTY_PROTO_METRICS_SENSOR_AUX_SNAME);
-                            continue;
-                        }
-                        log_debug ("Sensor '%s' on '%s'/'%s' is still alive", source,  fty_proto_name (bmsg), port);
-                        s_osrv_resolve_alert (self, source);
-                        int rv = data_touch_asset (self->assets, source, timestamp, fty_proto_ttl (bmsg), now_sec);
-                        if ( rv == -1 )
-                            log_error ("asset: name = %s, topic=%s metric is from future! ignore it", source, mlm_client_subject (self->client));
-                    }
-                    else {
-                        // is it from sensor? no
-                        const char *source = fty_proto_name (bmsg);
-                        s_osrv_resolve_alert (self, source);
-                        int rv = data_touch_asset (self->assets, source, timestamp, fty_proto_ttl (bmsg), now_sec);
-                        if ( rv == -1 )
-                            log_error ("asset: name = %s, topic=%s metric is from future! ignore it", source, mlm_client_subject (self->client));
-                    }
-                }
-                else {
-                    // intentionally left empty
-                    // so it is metric from agent-cm -> it is not comming from the device itself ->ignore it
-                }
-            }
-            else
-            if (fty_proto_id (bmsg) == FTY_PROTO_ASSET) {
-                if (streq (fty_proto_operation (bmsg), FTY_PROTO_ASSET_OP_DELETE)
-                     || !streq (fty_proto_aux_string (bmsg, FTY_PROTO_ASSET_STATUS, "active"), "active") )
-                {
-                    const char* source = fty_proto_name (bmsg);
-                    s_osrv_resolve_alert (self, source);
-                }
-                data_put (self->assets, &bmsg);
-            }
-            fty_proto_destroy (&bmsg);
+            s_osrv_handle_message (self, mlm_client_command (self->client), mlm_client_address (self->client),
+                mlm_client_sender (self->client), mlm_client_subject (self->client), &message, now_sec);
         }
     }
+    s_osrv_drain_metrics (metric_poll);
     zactor_destroy (&metric_poll);
+    // writer finishes pending save first
+    zactor_destroy (&writer);
     zpoller_destroy (&poller);
-    int r = s_osrv_save (self);
+    int r = s_osrv_save (self, true);
     if (r != 0)
         log_error ("outage_actor: failed to save state file %s: %m", self->state_file);
     s_osrv_destroy (&self);
@@ -813,6 +2521,41 @@ fty_outage_server (zsock_t *pipe, void *args)
 // --------------------------------------------------------------------------
 // Self test of this class
 
+typedef struct {
+    int counts [RECORDING_ALERT + 1];   // records of each type
+    char first_alert [64];              // asset/state of the first alert recorded
+    zmsg_t *asset;                      // first ASSETS message recorded
+} test_recording_t;
+
+static void
+s_test_blackbox (const blackbox_event_t *event, void *arg)
+{
+    if (event->type == BLACKBOX_ALERT_ACTIVE && streq (event->asset, "UPS-42"))
+        (*(int *) arg)++;
+}
+
+static void
+s_test_recording (uint8_t type, int64_t time_ms, zmsg_t *msg, void *arg)
+{
+    test_recording_t *recording = (test_recording_t *) arg;
+    assert (time_ms > 0);
+    assert (type >= RECORDING_STREAM && type <= RECORDING_ALERT);
+    recording->counts [type]++;
+    if (type == RECORDING_ALERT && recording->counts [type] == 1) {
+        char *asset = zmsg_popstr (msg);
+        char *state = zmsg_popstr (msg);
+        snprintf (recording->first_alert, sizeof (recording->first_alert), "%s/%s", asset, state);
+        zstr_free (&asset);
+        zstr_free (&state);
+    }
+    if (type == RECORDING_STREAM && !recording->asset) {
+        char *stream = zmsg_popstr (msg);
+        if (streq (stream, "ASSETS"))
+            recording->asset = zmsg_dup (msg);
+        zstr_free (&stream);
+    }
+}
+
 void
 fty_outage_server_test (bool verbose)
 {
@@ -842,6 +2585,9 @@ fty_outage_server_test (bool verbose)
     assert (self);
 
     //    actor commands
+    unlink ("src/fty_outage_server_test.rec");
+    blackbox_reset ();
+    zstr_sendx (self, "RECORD", "src/fty_outage_server_test.rec", NULL);
     zstr_sendx (self, "CONNECT", endpoint, "fty-outage", NULL);
     zstr_sendx (self, "CONSUMER", "METRICS", ".*", NULL);
     zstr_sendx (self, "CONSUMER", "ASSETS", ".*", NULL);
@@ -850,6 +2596,7 @@ fty_outage_server_test (bool verbose)
     zstr_sendx (self, "PRODUCER", "_ALERTS_SYS", NULL);
     zstr_sendx (self, "TIMEOUT", "1000", NULL);
     zstr_sendx (self, "ASSET-EXPIRY-SEC", "3", NULL);
+    zstr_sendx (self, "STALL-THRESHOLD", "500", NULL);
     zstr_sendx (server, "DEFAULT_MAINTENANCE_EXPIRATION", "30", NULL);
     if (verbose)
         zstr_sendx (self, "VERBOSE", NULL);
@@ -1026,6 +2773,91 @@ fty_outage_server_test (bool verbose)
     assert (streq (fty_proto_name (bmsg), "UPS-42"));
     assert (streq (fty_proto_state (bmsg), "ACTIVE"));
     fty_proto_destroy (&bmsg);
+
+    // test case 04b: ask for the snapshot of active outages
+    log_debug ("fty-outage: Test #4b");
+    request = zmsg_new ();
+    zmsg_addstr (request, "REQUEST");
+    zmsg_addstr (request, zuuid_str);
+    zmsg_addstr (request, "OUTAGE_SNAPSHOT");
+    rv = mlm_client_sendto (mb_client, "fty-outage", "TEST", NULL, 1000, &request);
+    assert (rv >= 0);
+
+    recv = mlm_client_recv (mb_client);
+    assert (recv);
+    answer = zmsg_popstr (recv);
+    assert (streq (zuuid_str, answer));
+    zstr_free(&answer);
+    answer = zmsg_popstr (recv);
+    assert (streq ("REPLY", answer));
+    zstr_free(&answer);
+    answer = zmsg_popstr (recv);
+    assert (streq ("OK", answer));
+    zstr_free(&answer);
+    answer = zmsg_popstr (recv); // sequence
+    assert (atoi (answer) == 1);
+    zstr_free(&answer);
+    answer = zmsg_popstr (recv); // time
+    assert (answer);
+    zstr_free(&answer);
+    answer = zmsg_popstr (recv);
+    assert (streq ("1", answer));
+    zstr_free(&answer);
+    answer = zmsg_popstr (recv);
+    assert (streq ("UPS-42", answer));
+    zstr_free(&answer);
+    zmsg_destroy (&recv);
+
+    // test case 04b2: published snapshot goes to its own stream
+    log_debug ("fty-outage: Test #4b2");
+    mlm_client_t *snapshot_consumer = mlm_client_new ();
+    rv = mlm_client_connect (snapshot_consumer, endpoint, 5000, "snapshot-consumer");
+    assert (rv >= 0);
+    rv = mlm_client_set_consumer (snapshot_consumer, FTY_OUTAGE_STREAM_SNAPSHOT, ".*");
+    assert (rv >= 0);
+    zstr_sendx (self, "SNAPSHOT-PRODUCER", endpoint, "fty-outage-snapshot", FTY_OUTAGE_STREAM_SNAPSHOT, NULL);
+    zstr_sendx (self, "SNAPSHOT-INTERVAL", "100", NULL);
+    recv = mlm_client_recv (snapshot_consumer);
+    assert (recv);
+    assert (streq (mlm_client_subject (snapshot_consumer), "outage/snapshot"));
+    answer = zmsg_popstr (recv);
+    assert (streq ("OUTAGE_SNAPSHOT", answer));
+    zstr_free(&answer);
+    zmsg_destroy (&recv);
+    zstr_sendx (self, "SNAPSHOT-INTERVAL", "0", NULL);
+    mlm_client_destroy (&snapshot_consumer);
+
+    // test case 04c: dump the flight recorder, it knows about the alert
+    log_debug ("fty-outage: Test #4c");
+    unlink ("src/fty_outage_server_test.bbx");
+    blackbox_set_file ("src/fty_outage_server_test.bbx");
+    request = zmsg_new ();
+    zmsg_addstr (request, "REQUEST");
+    zmsg_addstr (request, zuuid_str);
+    zmsg_addstr (request, "BLACKBOX");
+    rv = mlm_client_sendto (mb_client, "fty-outage", "TEST", NULL, 1000, &request);
+    assert (rv >= 0);
+
+    recv = mlm_client_recv (mb_client);
+    assert (recv);
+    answer = zmsg_popstr (recv);
+    assert (streq (zuuid_str, answer));
+    zstr_free(&answer);
+    answer = zmsg_popstr (recv);
+    assert (streq ("REPLY", answer));
+    zstr_free(&answer);
+    answer = zmsg_popstr (recv);
+    assert (streq ("OK", answer));
+    zstr_free(&answer);
+    answer = zmsg_popstr (recv);
+    assert (streq ("src/fty_outage_server_test.bbx", answer));
+    zstr_free(&answer);
+    zmsg_destroy (&recv);
+    int blackbox_alerts = 0;
+    assert (blackbox_read ("src/fty_outage_server_test.bbx", s_test_blackbox, &blackbox_alerts) > 0);
+    assert (blackbox_alerts == 1);
+    blackbox_set_file (NULL);
+    unlink ("src/fty_outage_server_test.bbx");
     zuuid_destroy (&zuuid);
 
     // test case 05: RESOLVE alert when device is retired
@@ -1060,6 +2892,16 @@ fty_outage_server_test (bool verbose)
     mlm_client_destroy (&mb_client);
     zactor_destroy (&server);
 
+    // inputs and alerts were recorded
+    test_recording_t recording;
+    memset (&recording, 0, sizeof (recording));
+    assert (recording_read ("src/fty_outage_server_test.rec", s_test_recording, &recording) > 0);
+    assert (recording.counts [RECORDING_STREAM] > 0);
+    assert (recording.counts [RECORDING_MAILBOX] > 0);
+    assert (recording.counts [RECORDING_ALERT] > 0);
+    assert (streq (recording.first_alert, "UPS33/ACTIVE"));
+    assert (recording.asset);
+
     //  @end
 
     // Those are PRIVATE to actor, so won't be a part of documentation
@@ -1068,12 +2910,12 @@ fty_outage_server_test (bool verbose)
     zhash_insert (self2->active_alerts, "DEVICE2", TRUE);
     zhash_insert (self2->active_alerts, "DEVICE3", TRUE);
     zhash_insert (self2->active_alerts, "DEVICE WITH SPACE", TRUE);
-    self2->state_file = strdup ("src/state.zpl");
-    s_osrv_save (self2);
+    self2->state_file = strdup ("src/state.bin");
+    s_osrv_save (self2, false);
     s_osrv_destroy (&self2);
 
     self2 = s_osrv_new ();
-    self2->state_file = strdup ("src/state.zpl");
+    self2->state_file = strdup ("src/state.bin");
     s_osrv_load (self2);
 
     assert (zhash_size (self2->active_alerts) == 4);
@@ -1084,7 +2926,608 @@ fty_outage_server_test (bool verbose)
     assert (!zhash_lookup (self2->active_alerts, "DEVICE4"));
 
     s_osrv_destroy (&self2);
+    unlink ("src/state.bin");
 
+    // state of older releases is imported
+    zconfig_t *legacy = zconfig_new ("root", NULL);
+    zconfig_t *legacy_alerts = zconfig_new ("alerts", legacy);
+    zconfig_put (legacy_alerts, "0", "DEVICE1");
+    zconfig_put (legacy_alerts, "1", "DEVICE WITH SPACE");
+    zconfig_save (legacy, "src/state.zpl");
+    zconfig_destroy (&legacy);
+
+    self2 = s_osrv_new ();
+    self2->state_file = strdup ("src/state.bin");
+    self2->legacy_state_file = strdup ("src/state.zpl");
+    assert (s_osrv_load (self2) == 0);
+    assert (zhash_size (self2->active_alerts) == 2);
+    assert (zhash_lookup (self2->active_alerts, "DEVICE1"));
+    assert (zhash_lookup (self2->active_alerts, "DEVICE WITH SPACE"));
+    // first saved state retires the imported file
+    assert (s_osrv_save (self2, false) == 0);
+    assert (!zsys_file_exists ("src/state.zpl"));
+    assert (zsys_file_exists ("src/state.zpl.imported"));
+    s_osrv_destroy (&self2);
+    unlink ("src/state.zpl.imported");
+
+    // damaged state does not import the file of older releases
+    legacy = zconfig_new ("root", NULL);
+    legacy_alerts = zconfig_new ("alerts", legacy);
+    zconfig_put (legacy_alerts, "0", "DEVICE1");
+    zconfig_save (legacy, "src/state.zpl");
+    zconfig_destroy (&legacy);
+    FILE *damaged = fopen ("src/state.bin", "w");
+    assert (damaged);
+    fputs ("damaged", damaged);
+    fclose (damaged);
+    self2 = s_osrv_new ();
+    self2->state_file = strdup ("src/state.bin");
+    self2->legacy_state_file = strdup ("src/state.zpl");
+    assert (s_osrv_load (self2) == -1);
+    assert (zhash_size (self2->active_alerts) == 0);
+    s_osrv_destroy (&self2);
+    unlink ("src/state.bin");
     unlink ("src/state.zpl");
+
+    // transitions after the last save are replayed from the journal
+    self2 = s_osrv_new ();
+    s_osrv_set_state_file (self2, "src/state.bin", NULL);
+    assert (self2->journal);
+    assert (zhash_size (self2->active_alerts) == 0);
+    zhash_insert (self2->active_alerts, "DEVICE1", TRUE);
+    zhash_insert (self2->active_alerts, "DEVICE2", TRUE);
+    assert (s_osrv_save (self2, false) == 0);
+    zhash_insert (self2->active_alerts, "DEVICE3", TRUE);
+    s_osrv_journal (self2, JOURNAL_ALERT_ACTIVE, "DEVICE3", 0);
+    zhash_delete (self2->active_alerts, "DEVICE1");
+    s_osrv_journal (self2, JOURNAL_ALERT_RESOLVED, "DEVICE1", 0);
+    // stop without saving the state
+    s_osrv_destroy (&self2);
+
+    self2 = s_osrv_new ();
+    s_osrv_set_state_file (self2, "src/state.bin", NULL);
+    assert (zhash_size (self2->active_alerts) == 2);
+    assert (!zhash_lookup (self2->active_alerts, "DEVICE1"));
+    assert (zhash_lookup (self2->active_alerts, "DEVICE2"));
+    assert (zhash_lookup (self2->active_alerts, "DEVICE3"));
+    // saved state makes the journal empty
+    assert (s_osrv_save (self2, false) == 0);
+    assert (journal_size (self2->journal) == 0);
+    s_osrv_destroy (&self2);
+
+    // background save keeps transitions made while the snapshot is written
+    self2 = s_osrv_new ();
+    s_osrv_set_state_file (self2, "src/state.bin", NULL);
+    for (int i = 0; i < 10000; i++) {
+        char name [32];
+        snprintf (name, sizeof (name), "ups-%d", i);
+        zhash_insert (self2->active_alerts, name, TRUE);
+    }
+    size_t alerts = zhash_size (self2->active_alerts);
+    zactor_t *writer = zactor_new (state_writer, NULL);
+    assert (writer);
+    int64_t start_us = zclock_usecs ();
+    assert (s_osrv_save_background (self2, writer) == 0);
+    int64_t pause_us = zclock_usecs () - start_us;
+    zhash_delete (self2->active_alerts, "DEVICE2");
+    s_osrv_journal (self2, JOURNAL_ALERT_RESOLVED, "DEVICE2", 0);
+    char *command = NULL;
+    rv = -1;
+    assert (zsock_recv (writer, "si", &command, &rv) == 0);
+    assert (streq (command, "SAVED"));
+    assert (rv == 0);
+    zstr_free (&command);
+    int64_t saved_us = zclock_usecs () - start_us;
+    journal_discard_rotated (self2->journal);
+    zactor_destroy (&writer);
+    log_info ("%s: background save of %zu alerts: pause %" PRIi64 " us, saved after %" PRIi64 " us",
+              __func__, alerts, pause_us, saved_us);
+    s_osrv_destroy (&self2);
+
+    self2 = s_osrv_new ();
+    s_osrv_set_state_file (self2, "src/state.bin", NULL);
+    assert (zhash_size (self2->active_alerts) == 10001);
+    assert (!zhash_lookup (self2->active_alerts, "DEVICE2"));
+    assert (zhash_lookup (self2->active_alerts, "DEVICE3"));
+    s_osrv_destroy (&self2);
+
+    // warm restart restores last seen times and ttls of tracked assets
+    uint64_t now_sec = zclock_time () / 1000;
+    for (int clean = 1; clean >= 0; clean--) {
+        self2 = s_osrv_new ();
+        self2->state_file = strdup ("src/state.bin");
+        aux = zhash_new ();
+        zhash_insert (aux, FTY_PROTO_ASSET_TYPE, (void *) "device");
+        zhash_insert (aux, FTY_PROTO_ASSET_SUBTYPE, (void *) "ups");
+        sendmsg = fty_proto_encode_asset (aux, "UPS-77", FTY_PROTO_ASSET_OP_CREATE, NULL);
+        bmsg = fty_proto_decode (&sendmsg);
+        data_put (self2->assets, &bmsg);
+        expiration_t *e = data_lookup (self2->assets, "UPS-77");
+        assert (e);
+        e->last_time_seen_sec = now_sec - 1000;
+        e->ttl_sec = 60;
+        assert (s_osrv_save (self2, clean == 1) == 0);
+        s_osrv_destroy (&self2);
+
+        self2 = s_osrv_new ();
+        self2->state_file = strdup ("src/state.bin");
+        assert (s_osrv_load (self2) == 0);
+        sendmsg = fty_proto_encode_asset (aux, "UPS-77", FTY_PROTO_ASSET_OP_CREATE, NULL);
+        bmsg = fty_proto_decode (&sendmsg);
+        data_put (self2->assets, &bmsg);
+        zhash_destroy (&aux);
+        e = data_lookup (self2->assets, "UPS-77");
+        assert (e);
+        assert (e->ttl_sec == 60);
+        if (clean)
+            assert (e->last_time_seen_sec == now_sec - 1000);
+        else
+            // asset may have been seen until the snapshot was taken
+            assert (e->last_time_seen_sec >= now_sec);
+        s_osrv_destroy (&self2);
+    }
+
+    // tracked assets are known from the catalog right after restart
+    self2 = s_osrv_new ();
+    s_osrv_set_state_file (self2, "src/state.bin", NULL);
+    aux = zhash_new ();
+    zhash_insert (aux, FTY_PROTO_ASSET_TYPE, (void *) "device");
+    zhash_insert (aux, FTY_PROTO_ASSET_SUBTYPE, (void *) "epdu");
+    zhash_t *ext = zhash_new ();
+    zhash_insert (ext, "name", (void *) "ePDU 88");
+    sendmsg = fty_proto_encode_asset (aux, "epdu-88", FTY_PROTO_ASSET_OP_CREATE, ext);
+    bmsg = fty_proto_decode (&sendmsg);
+    data_put (self2->assets, &bmsg);
+    zhash_destroy (&ext);
+    zhash_update (aux, FTY_PROTO_ASSET_SUBTYPE, (void *) "sensor");
+    zhash_insert (aux, "parent_name.1", (void *) "epdu-88");
+    sendmsg = fty_proto_encode_asset (aux, "sensor-88", FTY_PROTO_ASSET_OP_CREATE, NULL);
+    bmsg = fty_proto_decode (&sendmsg);
+    data_put (self2->assets, &bmsg);
+    zhash_destroy (&aux);
+    assert (s_osrv_save (self2, true) == 0);
+    assert (!data_changed (self2->assets));
+    s_osrv_destroy (&self2);
+
+    self2 = s_osrv_new ();
+    s_osrv_set_state_file (self2, "src/state.bin", NULL);
+    expiration_t *e = data_lookup (self2->assets, "epdu-88");
+    assert (e);
+    assert (!e->announced);
+    assert (streq (e->subtype, "epdu"));
+    assert (streq (data_get_asset_ename (self2->assets, "epdu-88"), "ePDU 88"));
+    assert (streq (data_get_parent (self2->assets, "sensor-88"), "epdu-88"));
+    assert (!data_changed (self2->assets));
+
+    // assets deleted meanwhile are forgotten, once asset agent lists existing ones
+    self2->catalog_check = strdup ("uuid-1");
+    zmsg_t *assets_reply = zmsg_new ();
+    zmsg_addstr (assets_reply, "uuid-0");
+    zmsg_addstr (assets_reply, "OK");
+    s_osrv_catalog_check (self2, assets_reply);
+    zmsg_destroy (&assets_reply);
+    assert (data_lookup (self2->assets, "sensor-88"));
+    assets_reply = zmsg_new ();
+    zmsg_addstr (assets_reply, "uuid-1");
+    zmsg_addstr (assets_reply, "OK");
+    zmsg_addstr (assets_reply, "epdu-88");
+    s_osrv_catalog_check (self2, assets_reply);
+    zmsg_destroy (&assets_reply);
+    assert (!self2->catalog_check);
+    assert (data_lookup (self2->assets, "epdu-88"));
+    assert (!data_lookup (self2->assets, "sensor-88"));
+    s_osrv_destroy (&self2);
+
+    // maintenance does not depend on learned ttl and survives restart
+    self2 = s_osrv_new ();
+    s_osrv_set_state_file (self2, "src/state.bin", NULL);
+    now_sec = zclock_time () / 1000;
+    assert (data_add_asset (self2->assets, "ups-m", "UPS M", "ups", NULL) == 0);
+    e = data_lookup (self2->assets, "ups-m");
+    e->ttl_sec = 1;
+    e->last_time_seen_sec = now_sec - 100;
+    assert (s_osrv_maintenance_mode (self2, "ups-m", ENABLE_MAINTENANCE, 3600) == 0);
+    assert (e->ttl_sec == 1);
+    assert (e->maintenance_until_sec == now_sec + 3600 || e->maintenance_until_sec == now_sec + 3601);
+    zlistx_t *dead = data_get_dead (self2->assets);
+    assert (zlistx_size (dead) == 0);
+    zlistx_destroy (&dead);
+    assert (s_osrv_save (self2, true) == 0);
+    s_osrv_destroy (&self2);
+
+    self2 = s_osrv_new ();
+    s_osrv_set_state_file (self2, "src/state.bin", NULL);
+    e = data_lookup (self2->assets, "ups-m");
+    assert (e && e->maintenance_until_sec >= now_sec + 3600);
+    assert (deadline_size (self2->assets->maintenance) == 1);
+    assert (s_osrv_maintenance_mode (self2, "ups-m", DISABLE_MAINTENANCE, 0) == 0);
+    assert (e->maintenance_until_sec == 0);
+    assert (e->ttl_sec == 1);
+    s_osrv_destroy (&self2);
+
+    // disabled maintenance is replayed from the journal
+    self2 = s_osrv_new ();
+    s_osrv_set_state_file (self2, "src/state.bin", NULL);
+    e = data_lookup (self2->assets, "ups-m");
+    assert (e && e->maintenance_until_sec == 0);
+    s_osrv_destroy (&self2);
+
+    // bulk maintenance by selector
+    self2 = s_osrv_new ();
+    assert (data_add_asset (self2->assets, "ups-b1", "UPS B1", "ups", NULL) == 0);
+    assert (data_add_asset (self2->assets, "ups-b2", "UPS B2", "ups", NULL) == 0);
+    assert (data_add_asset (self2->assets, "epdu-b1", "ePDU B1", "epdu", NULL) == 0);
+    assert (data_add_asset (self2->assets, "sensor-b1", "Sensor B1", "sensor", "epdu-b1") == 0);
+    const char *bulk_requests [][6] = {
+        // request                                              reply
+        {"enable", "60", "SUBTYPE", "ups", NULL,                "OK/2/0"},
+        {"enable", "", "PARENT", "epdu-b1", NULL,               "OK/2/0"},
+        {"disable", "", "REGEX", "^(ups|epdu)-b1$", NULL,       "OK/2/0"},
+        {"enable", "60", "ASSETS", "ups-b1", "ghost-1",         "OK/1/1/ghost-1"},
+        {"enable", "60", "LOCATION", "row-1", NULL,             "ERROR/Unsupported selector"},
+        {"enable", "60", "REGEX", "(", NULL,                    "ERROR/Invalid regex"},
+        {"pause", "60", "SUBTYPE", "ups", NULL,                 "ERROR/Unsupported maintenance mode"},
+    };
+    for (size_t i = 0; i < sizeof (bulk_requests) / sizeof (bulk_requests [0]); i++) {
+        request = zmsg_new ();
+        for (int j = 0; j < 5 && bulk_requests [i][j]; j++)
+            zmsg_addstr (request, bulk_requests [i][j]);
+        zmsg_t *reply = zmsg_new ();
+        s_osrv_maintenance_bulk (self2, request, reply);
+        char *reply_str = NULL;
+        for (char *frame = zmsg_popstr (reply); frame; frame = zmsg_popstr (reply)) {
+            char *joined = reply_str ? zsys_sprintf ("%s/%s", reply_str, frame) : strdup (frame);
+            zstr_free (&reply_str);
+            zstr_free (&frame);
+            reply_str = joined;
+        }
+        if (verbose)
+            log_debug ("bulk request %zu: %s", i, reply_str);
+        assert (reply_str && streq (reply_str, bulk_requests [i][5]));
+        zstr_free (&reply_str);
+        zmsg_destroy (&reply);
+        zmsg_destroy (&request);
+    }
+    // ups-b2 enabled, ups-b1 and epdu-b1 disabled, then ups-b1 enabled again
+    assert (data_lookup (self2->assets, "ups-b2")->maintenance_until_sec > 0);
+    assert (data_lookup (self2->assets, "ups-b1")->maintenance_until_sec > 0);
+    assert (data_lookup (self2->assets, "epdu-b1")->maintenance_until_sec == 0);
+    assert (data_lookup (self2->assets, "sensor-b1")->maintenance_until_sec > 0);
+    s_osrv_destroy (&self2);
+
+    // recurring maintenance windows
+    self2 = s_osrv_new ();
+    s_osrv_set_state_file (self2, "src/state.bin", NULL);
+    assert (data_add_asset (self2->assets, "ups-s1", "UPS S1", "ups", NULL) == 0);
+    assert (data_add_asset (self2->assets, "epdu-s1", "ePDU S1", "epdu", NULL) == 0);
+    now_sec = zclock_time () / 1000;
+    {
+        // window opened 10s ago, it is open for 50s more
+        zmsg_t *reply = zmsg_new ();
+        request = zmsg_new ();
+        zmsg_addstr (request, "nightly");
+        zmsg_addstrf (request, "%" PRIu64, now_sec - 10);
+        zmsg_addstr (request, "86400");
+        zmsg_addstr (request, "60");
+        zmsg_addstr (request, "SUBTYPE");
+        zmsg_addstr (request, "ups");
+        s_osrv_schedule_add (self2, request, reply);
+        char *status = zmsg_popstr (reply);
+        assert (status && streq (status, "OK"));
+        zstr_free (&status);
+        zmsg_destroy (&reply);
+        zmsg_destroy (&request);
+
+        // invalid selector and window are refused
+        const char *bad_requests [][6] = {
+            {"bad", "0", "3600", "60", "LOCATION", "row-1"},
+            {"bad", "0", "3600", "7200", "SUBTYPE", "ups"},
+            {"bad", "now", "3600", "60", "SUBTYPE", "ups"},
+        };
+        for (size_t i = 0; i < sizeof (bad_requests) / sizeof (bad_requests [0]); i++) {
+            reply = zmsg_new ();
+            request = zmsg_new ();
+            for (int j = 0; j < 6; j++)
+                zmsg_addstr (request, bad_requests [i][j]);
+            s_osrv_schedule_add (self2, request, reply);
+            status = zmsg_popstr (reply);
+            assert (status && streq (status, "ERROR"));
+            zstr_free (&status);
+            zmsg_destroy (&reply);
+            zmsg_destroy (&request);
+        }
+        assert (schedule_size (self2->schedules) == 1);
+
+        reply = zmsg_new ();
+        s_osrv_schedule_list (self2, reply);
+        assert (zmsg_size (reply) == 2 + 8);
+        zmsg_destroy (&reply);
+    }
+    s_osrv_run_schedules (self2, now_sec);
+    e = data_lookup (self2->assets, "ups-s1");
+    assert (e && e->maintenance_until_sec == now_sec + 50);
+    e = data_lookup (self2->assets, "epdu-s1");
+    assert (e && e->maintenance_until_sec == 0);
+    assert (schedule_next (self2->schedules) == now_sec - 10 + 86400);
+    s_osrv_destroy (&self2);
+
+    // schedules are kept over restart
+    self2 = s_osrv_new ();
+    s_osrv_set_state_file (self2, "src/state.bin", NULL);
+    assert (schedule_lookup (self2->schedules, "nightly"));
+    assert (schedule_delete (self2->schedules, "nightly") == 0);
+    s_osrv_save_schedules (self2);
+    s_osrv_destroy (&self2);
+    self2 = s_osrv_new ();
+    s_osrv_set_state_file (self2, "src/state.bin", NULL);
+    assert (schedule_size (self2->schedules) == 0);
+    s_osrv_destroy (&self2);
+
+    // status queries
+    self2 = s_osrv_new ();
+    now_sec = zclock_time () / 1000;
+    for (int i = 4; i >= 0; i--) {
+        char name [32];
+        snprintf (name, sizeof (name), "ups-d%d", i);
+        assert (data_add_asset (self2->assets, name, name, "ups", NULL) == 0);
+    }
+    assert (data_add_asset (self2->assets, "ups-alive", "UPS alive", "ups", NULL) == 0);
+    expiration_update (data_lookup (self2->assets, "ups-alive"), now_sec);
+    assert (data_add_asset (self2->assets, "ups-maint", "UPS maint", "ups", NULL) == 0);
+    assert (data_set_maintenance (self2->assets, "ups-maint", now_sec + 600) == 0);
+    // never seen, so not dead
+    assert (data_add_asset (self2->assets, "ups-never", "UPS never", "ups", NULL) == 0);
+    data_lookup (self2->assets, "ups-never")->last_time_seen_sec = 0;
+    s_osrv_status_refresh (self2);
+    {
+        // queries see updates once they are published
+        request = zmsg_new ();
+        zmsg_t *reply = zmsg_new ();
+        s_osrv_list_assets (self2, "dead", request, reply);
+        char *status = zmsg_popstr (reply);
+        char *total = zmsg_popstr (reply);
+        assert (streq (status, "OK") && streq (total, "0"));
+        zstr_free (&status);
+        zstr_free (&total);
+        zmsg_destroy (&reply);
+        zmsg_destroy (&request);
+        s_osrv_status_publish (self2, now_sec);
+
+        // pages of dead assets follow each other
+        const char *pages [][2] = {{"2", ""}, {"2", "ups-d1"}, {"2", "ups-d3"}};
+        const char *expected [][2] = {{"ups-d0", "ups-d1"}, {"ups-d2", "ups-d3"}, {"ups-d4", NULL}};
+        for (int i = 0; i < 3; i++) {
+            request = zmsg_new ();
+            zmsg_addstr (request, pages [i][0]);
+            zmsg_addstr (request, pages [i][1]);
+            zmsg_t *reply = zmsg_new ();
+            s_osrv_list_assets (self2, "dead", request, reply);
+            char *status = zmsg_popstr (reply);
+            char *total = zmsg_popstr (reply);
+            char *count = zmsg_popstr (reply);
+            assert (streq (status, "OK") && streq (total, "5"));
+            assert (atoi (count) == (expected [i][1] ? 2 : 1));
+            for (int j = 0; j < atoi (count); j++) {
+                char *asset_name = zmsg_popstr (reply);
+                char *last_seen = zmsg_popstr (reply);
+                assert (streq (asset_name, expected [i][j]));
+                zstr_free (&asset_name);
+                zstr_free (&last_seen);
+            }
+            assert (zmsg_size (reply) == 0);
+            zstr_free (&status);
+            zstr_free (&total);
+            zstr_free (&count);
+            zmsg_destroy (&reply);
+            zmsg_destroy (&request);
+        }
+
+        request = zmsg_new ();
+        reply = zmsg_new ();
+        s_osrv_list_assets (self2, "maintenance", request, reply);
+        assert (zmsg_size (reply) == 5);
+        zmsg_destroy (&reply);
+        zmsg_destroy (&request);
+
+        request = zmsg_new ();
+        zmsg_addstr (request, "ups-alive");
+        zmsg_addstr (request, "ghost-1");
+        reply = zmsg_new ();
+        s_osrv_asset_status_query (self2, request, reply);
+        assert (zmsg_size (reply) == 2 + 2 * 7);
+        // OK/2/ups-alive/alive/...
+        for (int i = 0; i < 4; i++) {
+            char *frame = zmsg_popstr (reply);
+            assert (streq (frame, i == 0 ? "OK" : i == 1 ? "2" : i == 2 ? "ups-alive" : "alive"));
+            zstr_free (&frame);
+        }
+        zmsg_destroy (&reply);
+        zmsg_destroy (&request);
+    }
+    s_osrv_destroy (&self2);
+
+    // hot paths are measured
+    self2 = s_osrv_new ();
+    now_sec = zclock_time () / 1000;
+    assert (data_add_asset (self2->assets, "ups-s1", "UPS S1", "ups", NULL) == 0);
+    s_osrv_touch_asset (self2, "ups-s1", NULL, now_sec, 60, now_sec);
+    s_osrv_touch_asset (self2, "ups-s1", NULL, now_sec, 60, now_sec);
+    s_osrv_check_dead_devices (self2);
+    assert (stats_counter (self2->stats, STATS_ASSETS_TOUCHED) == 2);
+    assert (stats_count (self2->stats, STATS_CHECK_DEAD) == 1);
+    {
+        zmsg_t *reply = zmsg_new ();
+        s_osrv_stats (self2, reply);
+        char *status = zmsg_popstr (reply);
+        char *count = zmsg_popstr (reply);
+        assert (streq (status, "OK"));
+        assert (zmsg_size (reply) == (size_t) atoi (count) * 2);
+        bool found = false;
+        int found_loop = 0;
+        for (int i = 0; i < atoi (count); i++) {
+            char *key = zmsg_popstr (reply);
+            char *value = zmsg_popstr (reply);
+            if (streq (key, "assets_touched")) {
+                assert (streq (value, "2"));
+                found = true;
+            }
+            if (streq (key, "loop.max_us") || streq (key, "stalls") || streq (key, "heartbeats"))
+                found_loop++;
+            zstr_free (&key);
+            zstr_free (&value);
+        }
+        assert (found);
+        assert (found_loop == 3);
+        zstr_free (&status);
+        zstr_free (&count);
+        zmsg_destroy (&reply);
+    }
+    s_osrv_destroy (&self2);
+
+    // changes are seen by readers after the batch is published
+    self2 = s_osrv_new ();
+    now_sec = zclock_time () / 1000;
+    assert (data_add_asset (self2->assets, "ups-v1", "UPS V1", "ups", NULL) == 0);
+    s_osrv_touch_asset (self2, "ups-v1", NULL, now_sec, 60, now_sec);
+    assert (s_osrv_maintenance_mode (self2, "ups-v2", ENABLE_MAINTENANCE, 600) == 0);
+    {
+        int reader = status_reader_new (self2->status);
+        assert (reader >= 0);
+        const status_view_t *view = status_enter (self2->status, reader);
+        assert (status_view_size (view) == 0);
+        status_leave (self2->status, reader);
+
+        assert (status_publish (self2->status, now_sec) == 0);
+        view = status_enter (self2->status, reader);
+        const status_record_t *record = status_view_lookup (view, "ups-v1");
+        assert (record && record->last_time_seen_sec == now_sec && record->ttl_sec == 60);
+        record = status_view_lookup (view, "ups-v2");
+        assert (record && record->maintenance_until_sec >= now_sec + 600);
+        status_leave (self2->status, reader);
+        status_reader_destroy (self2->status, reader);
+    }
+    // and by other agents in shared memory
+    {
+        const char *status_file = "src/selftest-rw/outage-status";
+        zmsg_t *command = zmsg_new ();
+        zmsg_addstr (command, "STATUS-FILE");
+        zmsg_addstr (command, status_file);
+        assert (s_osrv_actor_commands (self2, &command) == 0);
+        fty_outage_status_t *table = NULL;
+        fty_outage_status_record_t record;
+        for (int i = 0; i < 100; i++) {
+            if (!table)
+                table = fty_outage_status_open (status_file);
+            if (table && fty_outage_status_lookup (table, "ups-v1", &record) == 0)
+                break;
+            zclock_sleep (10);
+        }
+        assert (table);
+        assert (fty_outage_status_lookup (table, "ups-v1", &record) == 0);
+        assert (record.last_time_seen_sec == now_sec);
+        assert (streq (fty_outage_status_state (&record, now_sec), "alive"));
+        assert (fty_outage_status_lookup (table, "ups-v2", &record) == 0);
+        assert (streq (fty_outage_status_state (&record, now_sec), "maintenance"));
+        fty_outage_status_destroy (&table);
+        unlink (status_file);
+    }
+    s_osrv_destroy (&self2);
+
+    // recorded inputs are replayed through actor commands
+    self2 = s_osrv_new ();
+    {
+        zmsg_t *command = recording.asset;
+        recording.asset = NULL;
+        zmsg_pushstr (command, "ASSETS");
+        zmsg_pushstr (command, "STREAM");
+        assert (s_osrv_actor_commands (self2, &command) == 0);
+        assert (data_lookup (self2->assets, "UPS33"));
+        assert (streq (data_get_asset_ename (self2->assets, "UPS33"), "ename_of_ups33"));
+
+        now_sec = vclock_time () / 1000;
+        command = zmsg_new ();
+        zmsg_addstr (command, "METRICS");
+        fty_proto_t *metric = fty_proto_new (FTY_PROTO_METRIC);
+        fty_proto_set_name (metric, "%s", "UPS33");
+        fty_proto_set_type (metric, "%s", "dev");
+        fty_proto_set_value (metric, "%s", "1");
+        fty_proto_set_time (metric, now_sec);
+        fty_proto_set_ttl (metric, 300);
+        s_osrv_record_metric (command, metric);
+        // computed metrics are not recorded
+        fty_proto_aux_insert (metric, "x-cm-count", "%s", "2");
+        s_osrv_record_metric (command, metric);
+        fty_proto_destroy (&metric);
+        // metric of a sensor keeps its port and name
+        metric = fty_proto_new (FTY_PROTO_METRIC);
+        fty_proto_set_name (metric, "%s", "UPS33");
+        fty_proto_set_time (metric, now_sec);
+        fty_proto_set_ttl (metric, 300);
+        fty_proto_aux_insert (metric, FTY_PROTO_METRICS_SENSOR_AUX_PORT, "%s", "1");
+        fty_proto_aux_insert (metric, FTY_PROTO_METRICS_SENSOR_AUX_SNAME, "%s", "sensor-33");
+        s_osrv_record_metric (command, metric);
+        fty_proto_destroy (&metric);
+        assert (zmsg_size (command) == 3);
+        metric = s_osrv_recorded_metric (zmsg_last (command));
+        assert (metric);
+        assert (streq (fty_proto_name (metric), "UPS33"));
+        assert (fty_proto_time (metric) == now_sec);
+        assert (fty_proto_ttl (metric) == 300);
+        assert (streq (fty_proto_aux_string (metric, FTY_PROTO_METRICS_SENSOR_AUX_SNAME, ""), "sensor-33"));
+        fty_proto_destroy (&metric);
+        assert (s_osrv_actor_commands (self2, &command) == 0);
+        e = data_lookup (self2->assets, "UPS33");
+        assert (e && e->last_time_seen_sec == now_sec);
+
+        command = zmsg_new ();
+        zmsg_addstr (command, "SYNC");
+        assert (s_osrv_actor_commands (self2, &command) == 2);
+    }
+    s_osrv_destroy (&self2);
+    unlink ("src/fty_outage_server_test.rec");
+
+    // polling actor confirms it stopped, so no batch is left on its pipe
+    {
+        zactor_t *metric_poll = zactor_new (outage_metric_polling, NULL);
+        assert (metric_poll);
+        int64_t drain_start_ms = zclock_mono ();
+        s_osrv_drain_metrics (metric_poll);
+        assert (zclock_mono () - drain_start_ms < 1000);
+        zactor_destroy (&metric_poll);
+    }
+
+    // startup primes liveness of tracked assets from shm
+    assert (fty_shm_set_test_dir ("src/selftest-rw") == 0);
+    const int prime_count = 1000;
+    for (int i = 0; i < prime_count; i += 2) {
+        char name [32];
+        snprintf (name, sizeof (name), "ups-%d", i);
+        assert (fty::shm::write_metric (name, "load.default", "42", "%", 300) >= 0);
+    }
+    int64_t start_ms = zclock_mono ();
+    self2 = s_osrv_new ();
+    for (int i = 0; i < prime_count; i++) {
+        char name [32];
+        snprintf (name, sizeof (name), "ups-%d", i);
+        assert (data_add_asset (self2->assets, name, name, "ups", NULL) == 0);
+        data_lookup (self2->assets, name)->last_time_seen_sec = 0;
+    }
+    s_osrv_prime (self2);
+    int64_t primed_ms = zclock_mono () - start_ms;
+    for (int i = 0; i < prime_count; i++) {
+        char name [32];
+        snprintf (name, sizeof (name), "ups-%d", i);
+        e = data_lookup (self2->assets, name);
+        assert ((i % 2 == 0) == (e->last_time_seen_sec > 0));
+    }
+    log_info ("%s: startup of %d assets to steady state in %" PRIi64 " ms",
+              __func__, prime_count, primed_ms);
+    s_osrv_destroy (&self2);
+    fty_shm_delete_test_dir ();
+
+    unlink ("src/state.bin");
+    unlink ("src/state.bin.journal");
+    unlink ("src/state.bin.catalog");
+    unlink ("src/state.bin.schedules");
     printf ("OK\n");
 }
@@ -0,0 +1,620 @@
+/*  =========================================================================
+    fty_outage_status - Shared memory table of outage status
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    fty_outage_status - Shared memory table of outage status
+@discuss
+    The agent publishes status of all assets into a memory mapped file, so
+    other processes on the box look assets up without a round trip over
+    malamute. The file holds two tables of records ordered by asset name.
+    The agent writes the table readers do not use and then switches them
+    over. Each table is guarded by a sequence number, odd while the table
+    is written, so a reader retries in the rare case its copy was torn.
+    Neither side takes a lock. When the table is too small, the agent
+    writes the content to a bigger file first, and only once it is
+    committed replaces the old file and marks it as replaced, so readers
+    reopen the file and never see it empty.
+
+    Layout (native byte order):
+        header
+        table header, records [capacity]    (table 0)
+        table header, records [capacity]    (table 1)
+@end
+*/
+
+#include "fty_outage_classes.h"
+#include <sys/mman.h>
+
+#define STATUS_FILE_MAGIC   "FTYOUTST"
+#define STATUS_FILE_VERSION 1
+#define STATUS_FILE_CAPACITY 1024   // records per table, if not asked for more
+#define STATUS_LOOKUP_TRIES 1000    // give up lookup, if the table keeps changing
+
+typedef struct {
+    char magic [8];                 // STATUS_FILE_MAGIC, not zero terminated
+    uint32_t version;               // STATUS_FILE_VERSION
+    uint32_t record_size;           // sizeof (fty_outage_status_record_t)
+    uint64_t capacity;              // records per table
+    uint32_t active;                // table to read from
+    uint32_t replaced;              // 1 if the file was replaced by another one
+    uint64_t reserved [4];
+} s_file_header_t;
+
+typedef struct {
+    uint64_t seq;                   // odd while the table is written
+    uint64_t count;                 // records used
+    uint64_t time_sec;              // [s] time of the content
+    uint64_t reserved;
+} s_table_header_t;
+
+//  Structure of our class
+struct _fty_outage_status_t {
+    char *path;                     // path of the file
+    void *map;                      // mapped file
+    size_t map_size;                // [B] size of the file
+    s_file_header_t *header;
+    s_table_header_t *tables [2];
+    fty_outage_status_record_t *records [2];
+    bool writer;                    // created by fty_outage_status_create
+    uint32_t writing;               // table being written
+    size_t written;                 // records appended to it so far
+    void *old_map;                  // file still read while a bigger one is written, NULL if none
+    size_t old_map_size;            // [B] size of the old file
+};
+
+static size_t
+s_file_size (uint64_t capacity)
+{
+    return sizeof (s_file_header_t)
+        + 2 * (sizeof (s_table_header_t) + capacity * sizeof (fty_outage_status_record_t));
+}
+
+// set pointers to the tables of the mapped file
+static void
+s_map_tables (fty_outage_status_t *self)
+{
+    self->header = (s_file_header_t *) self->map;
+    char *table = (char *) self->map + sizeof (s_file_header_t);
+    for (int i = 0; i < 2; i++) {
+        self->tables [i] = (s_table_header_t *) table;
+        self->records [i] = (fty_outage_status_record_t *) (table + sizeof (s_table_header_t));
+        table += sizeof (s_table_header_t) + self->header->capacity * sizeof (fty_outage_status_record_t);
+    }
+}
+
+static void
+s_unmap (fty_outage_status_t *self)
+{
+    if (self->map)
+        munmap (self->map, self->map_size);
+    self->map = NULL;
+    self->map_size = 0;
+}
+
+// map file at path for reading, return -1 if it's missing or unknown
+static int
+s_map_file (fty_outage_status_t *self, const char *path)
+{
+    int fd = open (path, O_RDONLY);
+    if (fd == -1)
+        return -1;
+    struct stat st;
+    if (fstat (fd, &st) != 0 || (size_t) st.st_size < sizeof (s_file_header_t)) {
+        close (fd);
+        return -1;
+    }
+    size_t map_size = (size_t) st.st_size;
+    void *map = mmap (NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    s_file_header_t *header = (s_file_header_t *) map;
+    if (memcmp (header->magic, STATUS_FILE_MAGIC, sizeof (header->magic)) != 0
+    ||  header->version != STATUS_FILE_VERSION
+    ||  header->record_size != sizeof (fty_outage_status_record_t)
+    ||  s_file_size (header->capacity) != map_size) {
+        munmap (map, map_size);
+        return -1;
+    }
+    s_unmap (self);
+    self->map = map;
+    self->map_size = map_size;
+    s_map_tables (self);
+    return 0;
+}
+
+// create file with tables of capacity records at tmp_path and map it
+// return NULL on error
+static void *
+s_new_file (const char *tmp_path, uint64_t capacity, size_t *map_size_p)
+{
+    int fd = open (tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        log_error ("Can't create %s: %m", tmp_path);
+        return NULL;
+    }
+    size_t map_size = s_file_size (capacity);
+    void *map = MAP_FAILED;
+    if (ftruncate (fd, (off_t) map_size) == 0)
+        map = mmap (NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        log_error ("Can't map %s: %m", tmp_path);
+        unlink (tmp_path);
+        return NULL;
+    }
+
+    // new file is complete before readers can open it
+    s_file_header_t *header = (s_file_header_t *) map;
+    memcpy (header->magic, STATUS_FILE_MAGIC, sizeof (header->magic));
+    header->version = STATUS_FILE_VERSION;
+    header->record_size = sizeof (fty_outage_status_record_t);
+    header->capacity = capacity;
+    *map_size_p = map_size;
+    return map;
+}
+
+// mark file mapped at map as replaced, so its readers reopen the path
+static void
+s_mark_replaced (void *map)
+{
+    s_file_header_t *header = (s_file_header_t *) map;
+    if (memcmp (header->magic, STATUS_FILE_MAGIC, sizeof (header->magic)) == 0)
+        __atomic_store_n (&header->replaced, 1, __ATOMIC_RELEASE);
+}
+
+// create empty file with tables of capacity records, which replaces the
+// file of the previous run at path
+static int
+s_create_file (fty_outage_status_t *self, const char *path, uint64_t capacity)
+{
+    char *tmp_path = zsys_sprintf ("%s.tmp", path);
+    size_t map_size = 0;
+    void *map = s_new_file (tmp_path, capacity, &map_size);
+    if (!map) {
+        zstr_free (&tmp_path);
+        return -1;
+    }
+
+    // file of the previous run may be still mapped by readers
+    int old_fd = open (path, O_RDWR);
+    if (rename (tmp_path, path) != 0) {
+        log_error ("Can't replace %s: %m", path);
+        munmap (map, map_size);
+        unlink (tmp_path);
+        zstr_free (&tmp_path);
+        if (old_fd != -1)
+            close (old_fd);
+        return -1;
+    }
+    zstr_free (&tmp_path);
+
+    struct stat st;
+    if (old_fd != -1 && fstat (old_fd, &st) == 0 && (size_t) st.st_size >= sizeof (s_file_header_t)) {
+        void *old_map = mmap (NULL, sizeof (s_file_header_t), PROT_READ | PROT_WRITE, MAP_SHARED, old_fd, 0);
+        if (old_map != MAP_FAILED) {
+            s_mark_replaced (old_map);
+            munmap (old_map, sizeof (s_file_header_t));
+        }
+    }
+    if (old_fd != -1)
+        close (old_fd);
+    self->map = map;
+    self->map_size = map_size;
+    s_map_tables (self);
+    return 0;
+}
+
+// start a bigger file, which is written instead of the mapped one and
+// replaces it at commit; readers keep using the old file meanwhile
+static int
+s_grow_file (fty_outage_status_t *self, uint64_t capacity)
+{
+    char *tmp_path = zsys_sprintf ("%s.tmp", self->path);
+    size_t map_size = 0;
+    void *map = s_new_file (tmp_path, capacity, &map_size);
+    zstr_free (&tmp_path);
+    if (!map)
+        return -1;
+
+    if (self->old_map)
+        // previous bigger file was not committed, readers never saw it
+        s_unmap (self);
+    else {
+        self->old_map = self->map;
+        self->old_map_size = self->map_size;
+    }
+    self->map = map;
+    self->map_size = map_size;
+    s_map_tables (self);
+    return 0;
+}
+
+// replace the old file by the bigger one with committed content
+static void
+s_replace_file (fty_outage_status_t *self)
+{
+    char *tmp_path = zsys_sprintf ("%s.tmp", self->path);
+    if (rename (tmp_path, self->path) != 0)
+        // retried by the next commit, readers stay on the old file
+        log_error ("Can't replace %s: %m", self->path);
+    else {
+        s_mark_replaced (self->old_map);
+        munmap (self->old_map, self->old_map_size);
+        self->old_map = NULL;
+        self->old_map_size = 0;
+    }
+    zstr_free (&tmp_path);
+}
+
+//  --------------------------------------------------------------------------
+//  Open the table published by the agent
+fty_outage_status_t *
+fty_outage_status_open (const char *path)
+{
+    assert (path);
+
+    fty_outage_status_t *self = (fty_outage_status_t *) zmalloc (sizeof (fty_outage_status_t));
+    if (!self)
+        return NULL;
+    self->path = strdup (path);
+    if (!self->path || s_map_file (self, path) != 0)
+        fty_outage_status_destroy (&self);
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Create (or replace) the table to publish status
+fty_outage_status_t *
+fty_outage_status_create (const char *path, size_t capacity)
+{
+    assert (path);
+
+    fty_outage_status_t *self = (fty_outage_status_t *) zmalloc (sizeof (fty_outage_status_t));
+    if (!self)
+        return NULL;
+    self->writer = true;
+    self->path = strdup (path);
+    if (!self->path || s_create_file (self, path, capacity ? capacity : STATUS_FILE_CAPACITY) != 0)
+        fty_outage_status_destroy (&self);
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Close the table
+void
+fty_outage_status_destroy (fty_outage_status_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        fty_outage_status_t *self = *self_p;
+        if (self->old_map) {
+            // bigger file was never committed
+            char *tmp_path = zsys_sprintf ("%s.tmp", self->path);
+            unlink (tmp_path);
+            zstr_free (&tmp_path);
+            munmap (self->old_map, self->old_map_size);
+        }
+        s_unmap (self);
+        zstr_free (&self->path);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Copy status of the asset to record
+int
+fty_outage_status_lookup (fty_outage_status_t *self, const char *asset_name,
+                          fty_outage_status_record_t *record)
+{
+    assert (self);
+    assert (asset_name);
+    assert (record);
+
+    for (int tries = 0; tries < STATUS_LOOKUP_TRIES; tries++) {
+        if (!self->writer && __atomic_load_n (&self->header->replaced, __ATOMIC_ACQUIRE)) {
+            if (s_map_file (self, self->path) != 0)
+                return -1;
+        }
+        uint32_t active = __atomic_load_n (&self->header->active, __ATOMIC_ACQUIRE) & 1;
+        s_table_header_t *table = self->tables [active];
+        uint64_t seq = __atomic_load_n (&table->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+
+        // records may be torn, result counts only if the table did not change
+        const fty_outage_status_record_t *records = self->records [active];
+        uint64_t count = table->count;
+        if (count > self->header->capacity)
+            count = self->header->capacity;
+        int found = -1;
+        uint64_t low = 0, high = count;
+        while (low < high) {
+            uint64_t middle = low + (high - low) / 2;
+            int cmp = strncmp (records [middle].name, asset_name, FTY_OUTAGE_STATUS_NAME_SIZE);
+            if (cmp == 0) {
+                memcpy (record, &records [middle], sizeof (fty_outage_status_record_t));
+                found = 0;
+                break;
+            }
+            if (cmp < 0)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+        if (__atomic_load_n (&table->seq, __ATOMIC_RELAXED) == seq) {
+            if (found == 0)
+                record->name [FTY_OUTAGE_STATUS_NAME_SIZE - 1] = '\0';
+            return found;
+        }
+    }
+    return -1;
+}
+
+//  --------------------------------------------------------------------------
+//  Return number of assets in the table
+size_t
+fty_outage_status_size (fty_outage_status_t *self)
+{
+    assert (self);
+    uint32_t active = __atomic_load_n (&self->header->active, __ATOMIC_ACQUIRE) & 1;
+    return (size_t) __atomic_load_n (&self->tables [active]->count, __ATOMIC_RELAXED);
+}
+
+//  --------------------------------------------------------------------------
+//  Return time the table was published
+uint64_t
+fty_outage_status_time (fty_outage_status_t *self)
+{
+    assert (self);
+    uint32_t active = __atomic_load_n (&self->header->active, __ATOMIC_ACQUIRE) & 1;
+    return __atomic_load_n (&self->tables [active]->time_sec, __ATOMIC_RELAXED);
+}
+
+//  --------------------------------------------------------------------------
+//  Return state of the asset
+const char *
+fty_outage_status_state (const fty_outage_status_record_t *record, uint64_t now_sec)
+{
+    assert (record);
+    if (record->maintenance_until_sec > now_sec)
+        return "maintenance";
+    if (record->last_time_seen_sec == 0)
+        return "unknown";
+    if (record->expires_sec <= now_sec)
+        return "dead";
+    return "alive";
+}
+
+//  --------------------------------------------------------------------------
+//  Start to write new content of the table
+int
+fty_outage_status_begin (fty_outage_status_t *self, size_t count)
+{
+    assert (self);
+    assert (self->writer);
+
+    if (count > self->header->capacity
+    &&  s_grow_file (self, 2 * count) != 0)
+        return -1;
+
+    self->writing = (__atomic_load_n (&self->header->active, __ATOMIC_RELAXED) + 1) & 1;
+    self->written = 0;
+    s_table_header_t *table = self->tables [self->writing];
+    __atomic_store_n (&table->seq, table->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Append status of the asset
+int
+fty_outage_status_append (fty_outage_status_t *self, const char *asset_name,
+                          uint64_t last_time_seen_sec, uint64_t ttl_sec, uint64_t expires_sec,
+                          uint64_t maintenance_until_sec, uint32_t flags)
+{
+    assert (self);
+    assert (asset_name);
+
+    size_t length = strlen (asset_name);
+    if (length >= FTY_OUTAGE_STATUS_NAME_SIZE || self->written >= self->header->capacity)
+        return -1;
+    fty_outage_status_record_t *record = &self->records [self->writing][self->written++];
+    memset (record->name, 0, sizeof (record->name));
+    memcpy (record->name, asset_name, length);
+    record->last_time_seen_sec = last_time_seen_sec;
+    record->ttl_sec = ttl_sec;
+    record->expires_sec = expires_sec;
+    record->maintenance_until_sec = maintenance_until_sec;
+    record->flags = flags;
+    record->reserved = 0;
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Make the new content visible to readers
+void
+fty_outage_status_commit (fty_outage_status_t *self, uint64_t time_sec)
+{
+    assert (self);
+
+    s_table_header_t *table = self->tables [self->writing];
+    table->count = self->written;
+    table->time_sec = time_sec;
+    __atomic_store_n (&table->seq, table->seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n (&self->header->active, self->writing, __ATOMIC_RELEASE);
+    if (self->old_map)
+        s_replace_file (self);
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+#define TEST_PUBLISHES 1000
+#define TEST_ASSETS 50
+
+// every record read must be consistent, writer sets expires to last seen + 2
+static void
+s_status_test_reader (zsock_t *pipe, void *args)
+{
+    fty_outage_status_t *table = fty_outage_status_open ((const char *) args);
+    zsock_signal (pipe, 0);
+
+    int errors = table ? 0 : 1;
+    uint64_t last_seen = 0;
+    while (table && last_seen < TEST_PUBLISHES) {
+        fty_outage_status_record_t record;
+        if (fty_outage_status_lookup (table, "ups-7", &record) != 0)
+            continue;
+        if (record.expires_sec != record.last_time_seen_sec + 2 || record.last_time_seen_sec < last_seen)
+            errors++;
+        last_seen = record.last_time_seen_sec;
+    }
+    fty_outage_status_destroy (&table);
+    zsock_send (pipe, "i", errors);
+
+    zmsg_t *msg = zmsg_recv (pipe);
+    zmsg_destroy (&msg);
+}
+
+void
+fty_outage_status_test (bool verbose)
+{
+    ftylog_setInstance("fty_outage_status_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * fty_outage_status: \n");
+
+    //  @selftest
+    const char *path = "src/status_test.shm";
+    unlink (path);
+    assert (fty_outage_status_open (path) == NULL);
+
+    fty_outage_status_t *writer = fty_outage_status_create (path, 2);
+    assert (writer);
+    fty_outage_status_t *reader = fty_outage_status_open (path);
+    assert (reader);
+    fty_outage_status_record_t record;
+    assert (fty_outage_status_size (reader) == 0);
+    assert (fty_outage_status_lookup (reader, "ups-1", &record) == -1);
+
+    assert (fty_outage_status_begin (writer, 2) == 0);
+    assert (fty_outage_status_append (writer, "ups-1", 100, 10, 120, 0, FTY_OUTAGE_STATUS_ALERT_ACTIVE) == 0);
+    assert (fty_outage_status_append (writer, "ups-2", 200, 20, 240, 500, 0) == 0);
+    // table is full
+    assert (fty_outage_status_append (writer, "ups-3", 300, 30, 360, 0, 0) == -1);
+    // nothing is visible before commit
+    assert (fty_outage_status_lookup (reader, "ups-1", &record) == -1);
+    fty_outage_status_commit (writer, 1000);
+
+    assert (fty_outage_status_size (reader) == 2);
+    assert (fty_outage_status_time (reader) == 1000);
+    assert (fty_outage_status_lookup (reader, "ups-1", &record) == 0);
+    assert (streq (record.name, "ups-1") && record.last_time_seen_sec == 100);
+    assert (record.flags & FTY_OUTAGE_STATUS_ALERT_ACTIVE);
+    assert (streq (fty_outage_status_state (&record, 110), "alive"));
+    assert (streq (fty_outage_status_state (&record, 120), "dead"));
+    assert (fty_outage_status_lookup (reader, "ups-2", &record) == 0);
+    assert (streq (fty_outage_status_state (&record, 300), "maintenance"));
+    record.last_time_seen_sec = 0;
+    assert (streq (fty_outage_status_state (&record, 600), "unknown"));
+    assert (fty_outage_status_lookup (reader, "ups-0", &record) == -1);
+    assert (fty_outage_status_lookup (reader, "ups-3", &record) == -1);
+
+    // name does not fit
+    char long_name [FTY_OUTAGE_STATUS_NAME_SIZE + 1];
+    memset (long_name, 'x', sizeof (long_name) - 1);
+    long_name [sizeof (long_name) - 1] = '\0';
+    assert (fty_outage_status_begin (writer, 1) == 0);
+    assert (fty_outage_status_append (writer, long_name, 1, 1, 1, 0, 0) == -1);
+    fty_outage_status_commit (writer, 1001);
+    assert (fty_outage_status_size (reader) == 0);
+
+    // bigger table replaces the file, reader follows it and never sees
+    // the table empty while it is regrown
+    assert (fty_outage_status_begin (writer, 1) == 0);
+    assert (fty_outage_status_append (writer, "ups-1", 100, 10, 120, 0, 0) == 0);
+    fty_outage_status_commit (writer, 1002);
+    assert (fty_outage_status_begin (writer, 3) == 0);
+    assert (fty_outage_status_lookup (reader, "ups-1", &record) == 0);
+    assert (fty_outage_status_append (writer, "ups-1", 100, 10, 120, 0, 0) == 0);
+    assert (fty_outage_status_append (writer, "ups-2", 200, 20, 240, 0, 0) == 0);
+    assert (fty_outage_status_lookup (reader, "ups-1", &record) == 0);
+    assert (fty_outage_status_lookup (reader, "ups-2", &record) == -1);
+    assert (fty_outage_status_append (writer, "ups-3", 300, 30, 360, 0, 0) == 0);
+    fty_outage_status_commit (writer, 1003);
+    assert (fty_outage_status_lookup (reader, "ups-3", &record) == 0);
+    assert (record.ttl_sec == 30);
+    assert (fty_outage_status_size (reader) == 3);
+    fty_outage_status_destroy (&reader);
+
+    // readers in other threads never see torn records
+    zactor_t *readers [2];
+    for (int i = 0; i < 2; i++)
+        readers [i] = zactor_new (s_status_test_reader, (void *) path);
+    for (uint64_t last_seen = 1; last_seen <= TEST_PUBLISHES; last_seen++) {
+        assert (fty_outage_status_begin (writer, TEST_ASSETS + 1) == 0);
+        for (int i = 0; i < TEST_ASSETS; i++) {
+            char asset [32];
+            snprintf (asset, sizeof (asset), "ups-%02d", i);
+            assert (fty_outage_status_append (writer, asset, last_seen, 1, last_seen + 2, 0, 0) == 0);
+        }
+        // "ups-7" sorts after "ups-49"
+        assert (fty_outage_status_append (writer, "ups-7", last_seen, 1, last_seen + 2, 0, 0) == 0);
+        fty_outage_status_commit (writer, last_seen);
+    }
+    for (int i = 0; i < 2; i++) {
+        int errors = -1;
+        assert (zsock_recv (readers [i], "i", &errors) == 0);
+        assert (errors == 0);
+        zactor_destroy (&readers [i]);
+    }
+
+    // lookup cost for a big site
+    const size_t count = 100000;
+    assert (fty_outage_status_begin (writer, count) == 0);
+    for (size_t i = 0; i < count; i++) {
+        char asset [32];
+        snprintf (asset, sizeof (asset), "ups-%06zu", i);
+        assert (fty_outage_status_append (writer, asset, i, 1, i + 2, 0, 0) == 0);
+    }
+    fty_outage_status_commit (writer, 1);
+    reader = fty_outage_status_open (path);
+    assert (reader);
+    int64_t start = zclock_usecs ();
+    for (size_t i = 0; i < count; i++) {
+        char asset [32];
+        snprintf (asset, sizeof (asset), "ups-%06zu", i);
+        assert (fty_outage_status_lookup (reader, asset, &record) == 0 && record.last_time_seen_sec == i);
+    }
+    log_info ("%s: %zu lookups in %" PRIi64 " us", __func__, count, zclock_usecs () - start);
+    fty_outage_status_destroy (&reader);
+    fty_outage_status_destroy (&writer);
+    unlink (path);
+    //  @end
+    printf ("OK\n");
+}
@@ -34,6 +34,13 @@ int main (int argc, char *argv [])
 {
     const char * logConfigFile = "";
     const char * maintenance_expiration = "";
+    const char * resend_active = "true";
+    const char * snapshot_interval = "0";
+    const char * status_file = FTY_OUTAGE_STATUS_FILE;
+    const char * stats_interval = "0";
+    const char * record_file = "";
+    const char * stall_threshold = "1000";
+    const char * blackbox_file = "/var/lib/fty/fty-outage/blackbox.bin";
     const char * config_file = CONFIG;
     ftylog_setInstance("fty-outage","");
     bool verbose = false;
@@ -49,6 +56,7 @@ int main (int argc, char *argv [])
             puts ("  --verbose / -v         verbose test output");
             puts ("  --help / -h            this information");
             puts ("  -c|--config            path to config file");
+            puts ("  --blackbox FILE        print dump of the flight recorder");
             return 0;
         }
         else
@@ -60,6 +68,14 @@ int main (int argc, char *argv [])
                 if (param) config_file = param;
                 ++argn;
         }
+        else
+        if (streq (argv [argn], "--blackbox")) {
+            if (!param) {
+                puts ("--blackbox needs a FILE");
+                return 1;
+            }
+            return blackbox_decode (param, stdout) < 0 ? 1 : 0;
+        }
         else {
             printf ("Unknown option: %s\n", argv [argn]);
         }
@@ -72,6 +88,25 @@ int main (int argc, char *argv [])
 
         // Get maintenance mode TTL
         maintenance_expiration = zconfig_get(cfg, "server/maintenance_expiration", DEFAULT_MAINTENANCE_EXPIRATION);
+
+        // Re-send active alerts each check / publish outage snapshot each interval
+        resend_active = zconfig_get(cfg, "server/resend_active", resend_active);
+        snapshot_interval = zconfig_get(cfg, "server/snapshot_interval", snapshot_interval);
+
+        // Shared memory table of asset status for other agents, empty disables it
+        status_file = zconfig_get(cfg, "server/status_file", status_file);
+
+        // Publish performance counters and latencies to shm, 0 disables it
+        stats_interval = zconfig_get(cfg, "server/stats_interval", stats_interval);
+
+        // Record inputs and alerts for replay, empty disables it
+        record_file = zconfig_get(cfg, "server/record_file", record_file);
+
+        // Report stalls of the main loop longer than threshold, 0 disables it
+        stall_threshold = zconfig_get(cfg, "server/stall_threshold", stall_threshold);
+
+        // Dump of the flight recorder, empty disables it
+        blackbox_file = zconfig_get(cfg, "server/blackbox_file", blackbox_file);
     }
 
     //If a log config file is configured, try to load it
@@ -86,21 +121,39 @@ int main (int argc, char *argv [])
         ftylog_setVeboseMode(ftylog_getInstance());
     }
 
+    blackbox_set_file (blackbox_file);
+    if (blackbox_catch (SIGUSR1) != 0)
+        log_error ("Can't dump the flight recorder on SIGUSR1");
+
     // FIXME: use agent name from fty-common
     zactor_t *server = zactor_new (fty_outage_server, (void *) "outage");
     //  Insert main code here
 
-    zstr_sendx (server, "STATE-FILE", "/var/lib/fty/fty-outage/state.zpl", NULL);
+    // record everything from the start
+    zstr_sendx (server, "RECORD", record_file, NULL);
+    zstr_sendx (server, "STATE-FILE", "/var/lib/fty/fty-outage/state.bin", "/var/lib/fty/fty-outage/state.zpl", NULL);
     zstr_sendx (server, "TIMEOUT", "30000", NULL);
     zstr_sendx (server, "CONNECT", "ipc://@/malamute", "fty-outage", NULL);
     zstr_sendx (server, "PRODUCER", FTY_PROTO_STREAM_ALERTS_SYS, NULL);
+    // seed liveness of cataloged assets from shm before ASSETS flood arrives,
+    // once we can publish alerts it resolves
+    zstr_sendx (server, "PRIME", NULL);
     //zstr_sendx (server, "CONSUMER", FTY_PROTO_STREAM_METRICS, ".*", NULL);
     zstr_sendx (server, "CONSUMER", FTY_PROTO_STREAM_METRICS_UNAVAILABLE, ".*", NULL);
     zstr_sendx (server, "CONSUMER", FTY_PROTO_STREAM_METRICS_SENSOR, ".*", NULL);
     zstr_sendx (server, "CONSUMER", FTY_PROTO_STREAM_ASSETS, ".*", NULL);
+    // assets deleted while we were not running, later deletes come on ASSETS
+    zstr_sendx (server, "CATALOG-CHECK", "asset-agent", NULL);
     if (verbose)
         zstr_send (server, "VERBOSE");
     zstr_sendx (server, "DEFAULT_MAINTENANCE_EXPIRATION", maintenance_expiration, NULL);
+    zstr_sendx (server, "RESEND-ACTIVE", resend_active, NULL);
+    zstr_sendx (server, "SNAPSHOT-INTERVAL", snapshot_interval, NULL);
+    if (atoll (snapshot_interval) > 0)
+        zstr_sendx (server, "SNAPSHOT-PRODUCER", "ipc://@/malamute", "fty-outage-snapshot", FTY_OUTAGE_STREAM_SNAPSHOT, NULL);
+    zstr_sendx (server, "STATUS-FILE", status_file, NULL);
+    zstr_sendx (server, "STATS-INTERVAL", stats_interval, NULL);
+    zstr_sendx (server, "STALL-THRESHOLD", stall_threshold, NULL);
 
     // src/malamute.c, under MPL license
     while (true) {
@@ -0,0 +1,1060 @@
+/*  =========================================================================
+    fty_outage_bench - Micro-benchmarks of the outage engine
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    fty_outage_bench - Micro-benchmarks of the outage engine
+@discuss
+    Drives data_put, data_touch_asset, data_get_dead and data_delete with
+    synthetic fleets and reports ns/op, allocations per op and RSS per
+    asset. Built and run by "make bench"; with --json each result is one
+    JSON object per line, so results of releases can be compared.
+@end
+*/
+
+#include "fty_outage_classes.h"
+#include <time.h>
+
+#define BATCH 10000                 // messages built at once outside of measured time
+#define DEAD_PERCENT 10             // share of the fleet, which is not seen anymore
+
+static const size_t s_default_sizes [] = {1000, 10000, 100000, 1000000, 0};
+
+//  --------------------------------------------------------------------------
+//  Allocations are counted by wrapping malloc of glibc, which is used by
+//  czmq and the library as well
+
+static uint64_t s_allocs = 0;
+
+#if defined (__GLIBC__)
+#define BENCH_COUNTS_ALLOCS 1
+extern "C" {
+void *__libc_malloc (size_t size);
+void *__libc_calloc (size_t count, size_t size);
+void *__libc_realloc (void *ptr, size_t size);
+
+void *
+malloc (size_t size)
+{
+    __atomic_add_fetch (&s_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc (size);
+}
+
+void *
+calloc (size_t count, size_t size)
+{
+    __atomic_add_fetch (&s_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc (count, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+    __atomic_add_fetch (&s_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_realloc (ptr, size);
+}
+}
+#else
+#define BENCH_COUNTS_ALLOCS 0
+#endif
+
+typedef struct {
+    const char *name;               // benchmark
+    size_t assets;                  // size of the fleet
+    uint64_t ops;                   // operations measured
+    uint64_t ns;                    // [ns] spent in them
+    uint64_t allocs;                // allocations made by them
+    int64_t rss;                    // [B] resident memory of the fleet, -1 if not measured
+} bench_result_t;
+
+static uint64_t
+s_now_ns (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+// [B] resident memory of the process
+static int64_t
+s_rss (void)
+{
+    FILE *file = fopen ("/proc/self/statm", "r");
+    if (!file)
+        return -1;
+    long size = 0, resident = 0;
+    int n = fscanf (file, "%ld %ld", &size, &resident);
+    fclose (file);
+    return n == 2 ? (int64_t) resident * sysconf (_SC_PAGESIZE) : -1;
+}
+
+// deterministic pseudo random numbers, same fleet for each run
+static uint64_t
+s_random (uint64_t *seed)
+{
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *seed >> 33;
+}
+
+// TTL [s] of metrics of the i-th asset: most devices are polled each
+// 30 or 60 seconds, some sensors and slow devices each 5, 15 or 60 minutes
+static uint64_t
+s_ttl (uint64_t *seed)
+{
+    uint64_t r = s_random (seed) % 100;
+    if (r < 40) return 30;
+    if (r < 70) return 60;
+    if (r < 90) return 300;
+    if (r < 98) return 900;
+    return 3600;
+}
+
+static void
+s_asset_name (char *buffer, size_t size, size_t i)
+{
+    snprintf (buffer, size, "%s-%zu", i % 5 == 4 ? "sensor" : i % 2 ? "epdu" : "ups", i);
+}
+
+// asset message as published on ASSETS stream, each fifth asset is
+// a sensor attached to the device before it
+static fty_proto_t *
+s_asset_message (size_t i)
+{
+    char name [64];
+    s_asset_name (name, sizeof (name), i);
+    fty_proto_t *msg = fty_proto_new (FTY_PROTO_ASSET);
+    fty_proto_set_name (msg, "%s", name);
+    fty_proto_set_operation (msg, "%s", FTY_PROTO_ASSET_OP_CREATE);
+    fty_proto_aux_insert (msg, FTY_PROTO_ASSET_TYPE, "%s", "device");
+    fty_proto_aux_insert (msg, FTY_PROTO_ASSET_STATUS, "%s", "active");
+    if (i % 5 == 4) {
+        char parent [64];
+        s_asset_name (parent, sizeof (parent), i - 1);
+        fty_proto_aux_insert (msg, FTY_PROTO_ASSET_SUBTYPE, "%s", "sensor");
+        fty_proto_aux_insert (msg, "parent_name.1", "%s", parent);
+    }
+    else
+        fty_proto_aux_insert (msg, FTY_PROTO_ASSET_SUBTYPE, "%s", i % 2 ? "epdu" : "ups");
+    fty_proto_ext_insert (msg, "name", "Device %zu", i);
+    return msg;
+}
+
+static void
+s_print (const bench_result_t *r, bool json)
+{
+    double ns_per_op = r->ops ? (double) r->ns / (double) r->ops : 0;
+    double allocs_per_op = r->ops ? (double) r->allocs / (double) r->ops : 0;
+    double rss_per_asset = r->rss >= 0 && r->assets ? (double) r->rss / (double) r->assets : -1;
+    if (json) {
+        printf ("{\"bench\":\"%s\",\"assets\":%zu,\"ops\":%" PRIu64 ",\"ns_per_op\":%.1f,",
+                r->name, r->assets, r->ops, ns_per_op);
+        if (BENCH_COUNTS_ALLOCS)
+            printf ("\"allocs_per_op\":%.2f,", allocs_per_op);
+        else
+            printf ("\"allocs_per_op\":null,");
+        if (rss_per_asset >= 0)
+            printf ("\"rss_per_asset\":%.1f}\n", rss_per_asset);
+        else
+            printf ("\"rss_per_asset\":null}\n");
+    }
+    else {
+        printf ("%-18s %8zu assets %12.1f ns/op %8.2f allocs/op", r->name, r->assets, ns_per_op, allocs_per_op);
+        if (rss_per_asset >= 0)
+            printf (" %8.1f B/asset", rss_per_asset);
+        printf ("\n");
+    }
+    fflush (stdout);
+}
+
+// run all benchmarks with a fleet of count assets
+static void
+s_bench_fleet (size_t count, bool json)
+{
+    bench_result_t r;
+    uint64_t seed = 42;
+    uint64_t now_sec = zclock_time () / 1000;
+    data_t *data = data_new ();
+    assert (data);
+    int64_t rss_start = s_rss ();
+
+    // data_put: fleet announced on ASSETS stream
+    memset (&r, 0, sizeof (r));
+    r.name = "data_put";
+    r.assets = count;
+    fty_proto_t **batch = (fty_proto_t **) zmalloc (BATCH * sizeof (fty_proto_t *));
+    for (size_t i = 0; i < count; i += BATCH) {
+        size_t n = count - i < BATCH ? count - i : BATCH;
+        for (size_t j = 0; j < n; j++)
+            batch [j] = s_asset_message (i + j);
+        uint64_t allocs = s_allocs;
+        uint64_t start = s_now_ns ();
+        for (size_t j = 0; j < n; j++)
+            data_put (data, &batch [j]);
+        r.ns += s_now_ns () - start;
+        r.allocs += s_allocs - allocs;
+        r.ops += n;
+    }
+    free (batch);
+    int64_t rss_end = s_rss ();
+    r.rss = rss_start >= 0 && rss_end >= 0 ? rss_end - rss_start : -1;
+    s_print (&r, json);
+
+    // data_touch_asset: each asset reports metrics several times, the last
+    // DEAD_PERCENT of them are not seen since long
+    char **names = (char **) zmalloc (count * sizeof (char *));
+    uint64_t *ttls = (uint64_t *) zmalloc (count * sizeof (uint64_t));
+    for (size_t i = 0; i < count; i++) {
+        char name [64];
+        s_asset_name (name, sizeof (name), i);
+        names [i] = strdup (name);
+        ttls [i] = s_ttl (&seed);
+    }
+    // announced assets are considered seen, the dead ones must be older
+    size_t alive = count - count * DEAD_PERCENT / 100;
+    for (size_t i = alive; i < count; i++) {
+        expiration_t *e = data_lookup (data, names [i]);
+        if (e)
+            e->last_time_seen_sec = 0;
+    }
+    memset (&r, 0, sizeof (r));
+    r.name = "data_touch_asset";
+    r.assets = count;
+    r.rss = -1;
+    uint64_t allocs = s_allocs;
+    uint64_t start = s_now_ns ();
+    for (int round = 3; round >= 0; round--) {
+        for (size_t i = 0; i < count; i++) {
+            uint64_t seen_sec = i < alive ? now_sec - round : now_sec - 4 * ttls [i] - round;
+            data_touch_asset (data, names [i], seen_sec, ttls [i], now_sec);
+        }
+    }
+    r.ns = s_now_ns () - start;
+    r.allocs = s_allocs - allocs;
+    r.ops = 4 * (uint64_t) count;
+    s_print (&r, json);
+
+    // per metric cost of disabled debug logging of data_touch_asset: fty_log
+    // evaluates the arguments before it checks the level, logging_debug not
+    if (!ftylog_isLogDebug (ftylog_getInstance ())) {
+        expiration_t **entries = (expiration_t **) zmalloc (count * sizeof (expiration_t *));
+        for (size_t i = 0; i < count; i++)
+            entries [i] = data_lookup (data, names [i]);
+        for (int gated = 0; gated < 2; gated++) {
+            memset (&r, 0, sizeof (r));
+            r.name = gated ? "logging_debug_off" : "log_debug_off";
+            r.assets = count;
+            r.rss = -1;
+            allocs = s_allocs;
+            start = s_now_ns ();
+            for (int round = 0; round < 4; round++) {
+                for (size_t i = 0; i < count; i++) {
+                    expiration_t *e = entries [i];
+                    if (!e)
+                        continue;
+                    if (gated)
+                        logging_debug ("asset: INFO UPDATED name='%s', last_seen=%" PRIu64 "[s], ttl= %" PRIu64 "[s], expires_at=%" PRIu64 "[s]",
+                                       names [i], e->last_time_seen_sec, e->ttl_sec, expiration_get (e));
+                    else
+                        log_debug ("asset: INFO UPDATED name='%s', last_seen=%" PRIu64 "[s], ttl= %" PRIu64 "[s], expires_at=%" PRIu64 "[s]",
+                                   names [i], e->last_time_seen_sec, e->ttl_sec, expiration_get (e));
+                }
+            }
+            r.ns = s_now_ns () - start;
+            r.allocs = s_allocs - allocs;
+            r.ops = 4 * (uint64_t) count;
+            s_print (&r, json);
+        }
+        free (entries);
+    }
+
+    // data_get_dead: one check of the whole fleet
+    memset (&r, 0, sizeof (r));
+    r.name = "data_get_dead";
+    r.assets = count;
+    r.rss = -1;
+    size_t rounds = count >= 100000 ? 3 : 1000000 / count;
+    size_t dead = 0;
+    allocs = s_allocs;
+    start = s_now_ns ();
+    for (size_t i = 0; i < rounds; i++) {
+        zlistx_t *list = data_get_dead (data);
+        dead = zlistx_size (list);
+        zlistx_destroy (&list);
+    }
+    r.ns = s_now_ns () - start;
+    r.allocs = s_allocs - allocs;
+    r.ops = rounds;
+    s_print (&r, json);
+    if (dead < count - alive)
+        log_warning ("only %zu of %zu assets are dead", dead, count - alive);
+
+    // data_delete: whole fleet is removed
+    memset (&r, 0, sizeof (r));
+    r.name = "data_delete";
+    r.assets = count;
+    r.rss = -1;
+    allocs = s_allocs;
+    start = s_now_ns ();
+    for (size_t i = 0; i < count; i++)
+        data_delete (data, names [i]);
+    r.ns = s_now_ns () - start;
+    r.allocs = s_allocs - allocs;
+    r.ops = count;
+    s_print (&r, json);
+
+    for (size_t i = 0; i < count; i++)
+        zstr_free (&names [i]);
+    free (names);
+    free (ttls);
+    data_destroy (&data);
+}
+
+//  --------------------------------------------------------------------------
+//  Soak: days of simulated time under continuous asset churn, metric gaps
+//  and maintenance toggles, memory must stay flat
+
+#define SOAK_STEP_SEC 60            // simulated time between two dead devices checks
+#define SOAK_SAMPLE_SEC 3600        // memory is sampled each simulated hour
+#define SOAK_CHURN_PERCENT 2        // of the fleet replaced each hour
+#define SOAK_GAP_PERCENT 5          // of the fleet, which stops sending metrics for a while each hour
+#define SOAK_MAINTENANCE_PERCENT 1  // of the fleet, which enters or leaves maintenance each hour
+#define SOAK_RSS_SLACK (8 * 1024 * 1024)    // [B] growth of RSS allowed after warm-up
+
+typedef struct {
+    char name [32];                 // current asset in the slot
+    uint64_t ttl_sec;               // [s] of its metrics
+    uint64_t next_sec;              // next metric is due
+    uint64_t gap_until_sec;         // no metrics until then
+} soak_asset_t;
+
+// announce a new asset in the slot, named by generation so names never repeat
+static void
+s_soak_create (data_t *data, soak_asset_t *asset, uint64_t generation, uint64_t *seed, uint64_t now_sec)
+{
+    size_t i = (size_t) generation;
+    fty_proto_t *msg = s_asset_message (i);
+    s_asset_name (asset->name, sizeof (asset->name), i);
+    data_put (data, &msg);
+    asset->ttl_sec = s_ttl (seed);
+    asset->next_sec = now_sec;
+    asset->gap_until_sec = 0;
+}
+
+// retire or delete the asset, as asset agent does
+static void
+s_soak_delete (data_t *data, soak_asset_t *asset, bool retire)
+{
+    fty_proto_t *msg = fty_proto_new (FTY_PROTO_ASSET);
+    fty_proto_set_name (msg, "%s", asset->name);
+    if (retire) {
+        fty_proto_set_operation (msg, "%s", FTY_PROTO_ASSET_OP_UPDATE);
+        fty_proto_aux_insert (msg, FTY_PROTO_ASSET_STATUS, "%s", "retired");
+    }
+    else
+        fty_proto_set_operation (msg, "%s", FTY_PROTO_ASSET_OP_DELETE);
+    data_put (data, &msg);
+}
+
+static void
+s_soak_print (uint64_t hour, int64_t rss, data_t *data, status_t *status, zhashx_t *alerts, bool json)
+{
+    if (json)
+        printf ("{\"bench\":\"soak\",\"hour\":%" PRIu64 ",\"rss\":%" PRIi64 ",\"assets\":%zu,\"enames\":%zu,"
+                "\"children\":%zu,\"restored\":%zu,\"maintenance\":%zu,\"status_slots\":%zu,\"alerts\":%zu}\n",
+                hour, rss, zhashx_size (data->assets), zhashx_size (data->asset_enames),
+                zhashx_size (data->children), zhashx_size (data->restored),
+                deadline_size (data->maintenance), status->slots, zhashx_size (alerts));
+    else
+        printf ("soak hour %5" PRIu64 " rss %8" PRIi64 " kB assets %7zu enames %7zu children %6zu restored %3zu"
+                " maintenance %6zu status %7zu alerts %6zu\n",
+                hour, rss / 1024, zhashx_size (data->assets), zhashx_size (data->asset_enames),
+                zhashx_size (data->children), zhashx_size (data->restored),
+                deadline_size (data->maintenance), status->slots, zhashx_size (alerts));
+    fflush (stdout);
+}
+
+// return 0 if memory stayed flat, -1 otherwise
+static int
+s_bench_soak (size_t count, int days, bool json)
+{
+    uint64_t seed = 42;
+    vclock_set_virtual (zclock_time ());
+    uint64_t now_sec = vclock_time () / 1000;
+    uint64_t start_sec = now_sec;
+    uint64_t end_sec = now_sec + (uint64_t) days * 24 * 3600;
+    data_t *data = data_new ();
+    status_t *status = status_new ();
+    zhashx_t *alerts = zhashx_new ();   // active outage alerts, as the agent keeps them
+    assert (data && status && alerts);
+
+    uint64_t generation = 0;
+    soak_asset_t *fleet = (soak_asset_t *) zmalloc (count * sizeof (soak_asset_t));
+    for (size_t i = 0; i < count; i++)
+        s_soak_create (data, &fleet [i], generation++, &seed, now_sec);
+
+    uint64_t hours = (uint64_t) days * 24;
+    uint64_t warmup_hours = hours / 4 > 0 ? hours / 4 : 1;
+    int64_t baseline_rss = 0;
+    int64_t last_rss = 0;
+    int rv = 0;
+    int64_t start_ms = zclock_mono ();
+    while (!zsys_interrupted) {
+        vclock_advance (SOAK_STEP_SEC * 1000);
+        now_sec = vclock_time () / 1000;
+        if (now_sec >= end_sec)
+            break;
+
+        // metrics of assets, which are due and not in a gap
+        for (size_t i = 0; i < count; i++) {
+            soak_asset_t *asset = &fleet [i];
+            if (asset->next_sec > now_sec || asset->gap_until_sec > now_sec)
+                continue;
+            data_touch_asset (data, asset->name, now_sec, asset->ttl_sec, now_sec);
+            zhashx_delete (alerts, asset->name);
+            expiration_t *e = data_lookup (data, asset->name);
+            if (e)
+                status_update (status, asset->name, e->last_time_seen_sec, e->ttl_sec,
+                               expiration_get (e), e->maintenance_until_sec, false);
+            asset->next_sec = now_sec + (asset->ttl_sec / 2 > SOAK_STEP_SEC ? asset->ttl_sec / 2 : SOAK_STEP_SEC);
+        }
+
+        // dead devices check
+        zlistx_t *expired = data_expire_maintenance (data, now_sec);
+        zlistx_destroy (&expired);
+        zlistx_t *dead = data_get_dead (data);
+        for (void *it = zlistx_first (dead); it != NULL; it = zlistx_next (dead))
+            zhashx_update (alerts, (const char *) it, (void *) "");
+        zlistx_destroy (&dead);
+        status_publish (status, now_sec);
+
+        if ((now_sec - start_sec) % SOAK_SAMPLE_SEC != 0)
+            continue;
+
+        // churn, gaps and maintenance of the next hour
+        for (size_t n = 0; n < count * SOAK_CHURN_PERCENT / 100; n++) {
+            soak_asset_t *asset = &fleet [s_random (&seed) % count];
+            s_soak_delete (data, asset, n % 2 == 0);
+            zhashx_delete (alerts, asset->name);
+            status_remove (status, asset->name);
+            s_soak_create (data, asset, generation++, &seed, now_sec);
+        }
+        for (size_t n = 0; n < count * SOAK_GAP_PERCENT / 100; n++) {
+            soak_asset_t *asset = &fleet [s_random (&seed) % count];
+            asset->gap_until_sec = now_sec + 2 * asset->ttl_sec + s_random (&seed) % (6 * 3600);
+        }
+        for (size_t n = 0; n < count * SOAK_MAINTENANCE_PERCENT / 100; n++) {
+            soak_asset_t *asset = &fleet [s_random (&seed) % count];
+            expiration_t *e = data_lookup (data, asset->name);
+            uint64_t until_sec = e && e->maintenance_until_sec ? 0 : now_sec + 600 + s_random (&seed) % (2 * 3600);
+            data_set_maintenance (data, asset->name, until_sec);
+        }
+
+        // memory must not grow after warm-up, structures must not outgrow the fleet
+        uint64_t hour = (now_sec - start_sec) / 3600;
+        last_rss = s_rss ();
+        s_soak_print (hour, last_rss, data, status, alerts, json);
+        if (hour == warmup_hours)
+            baseline_rss = last_rss;
+        if (zhashx_size (data->assets) > count
+        ||  zhashx_size (data->asset_enames) > count
+        ||  zhashx_size (data->children) > count
+        ||  zhashx_size (data->restored) > 0
+        ||  deadline_size (data->maintenance) > 2 * count
+        ||  status->slots > count
+        ||  zhashx_size (alerts) > count) {
+            log_error ("soak: internal structures outgrew fleet of %zu assets at hour %" PRIu64, count, hour);
+            rv = -1;
+            break;
+        }
+    }
+    if (rv == 0 && baseline_rss > 0 && last_rss > baseline_rss + baseline_rss / 10 + SOAK_RSS_SLACK) {
+        log_error ("soak: RSS grew from %" PRIi64 " kB to %" PRIi64 " kB after warm-up",
+                   baseline_rss / 1024, last_rss / 1024);
+        rv = -1;
+    }
+    log_info ("soak: %d days of %zu assets (%" PRIu64 " created) simulated in %" PRIi64 " ms: %s",
+              days, count, generation, zclock_mono () - start_ms, rv == 0 ? "OK" : "FAILED");
+
+    free (fleet);
+    zhashx_destroy (&alerts);
+    status_destroy (&status);
+    data_destroy (&data);
+    vclock_set_real ();
+    return rv;
+}
+
+#ifdef FTY_OUTAGE_BUILD_DRAFT_API
+//  --------------------------------------------------------------------------
+//  End-to-end detection latency: the agent runs with inproc malamute and
+//  metrics in a private shm directory, as in fty_outage_server_test
+
+#define E2E_ENDPOINT "inproc://fty-outage-bench"
+#define E2E_SHM_DIR "fty-outage-bench-shm"
+
+typedef struct {
+    char name [32];
+    bool stopped;                   // metrics are not written anymore
+    int64_t last_write_ms;          // zclock_mono of the last metric written
+    int64_t active_ms;              // ACTIVE alert received, 0 if not yet
+    int64_t resolved_ms;            // RESOLVED alert received, 0 if not yet
+} e2e_device_t;
+
+static void
+s_e2e_write (e2e_device_t *device, int ttl)
+{
+    if (fty::shm::write_metric (device->name, "load.default", "42", "%", ttl) < 0)
+        log_error ("Can't write metric of %s", device->name);
+    device->last_write_ms = zclock_mono ();
+}
+
+static int
+s_compare_latency (const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void
+s_e2e_print (const char *name, size_t devices, int64_t *latencies, size_t count,
+             int64_t floor_ms, bool json)
+{
+    qsort (latencies, count, sizeof (int64_t), s_compare_latency);
+    int64_t p50 = count ? latencies [(count - 1) / 2] : 0;
+    int64_t p90 = count ? latencies [(count - 1) * 90 / 100] : 0;
+    int64_t p99 = count ? latencies [(count - 1) * 99 / 100] : 0;
+    int64_t max = count ? latencies [count - 1] : 0;
+    if (json)
+        printf ("{\"bench\":\"%s\",\"devices\":%zu,\"count\":%zu,\"floor_ms\":%" PRIi64 ",\"p50_ms\":%" PRIi64
+                ",\"p90_ms\":%" PRIi64 ",\"p99_ms\":%" PRIi64 ",\"max_ms\":%" PRIi64 "}\n",
+                name, devices, count, floor_ms, p50, p90, p99, max);
+    else
+        printf ("%-18s %8zu devices %6zu alerts  floor %6" PRIi64 " ms  p50 %6" PRIi64 " ms  p90 %6" PRIi64
+                " ms  p99 %6" PRIi64 " ms  max %6" PRIi64 " ms\n",
+                name, devices, count, floor_ms, p50, p90, p99, max);
+    fflush (stdout);
+}
+
+// receive alerts until all stopped devices reach the state or timeout,
+// metrics of running devices are written each polling interval; without
+// stopped devices, alerts are received until timeout (warm-up)
+// return number of alerts received
+static size_t
+s_e2e_wait (mlm_client_t *consumer, e2e_device_t *devices, size_t count, const char *state,
+            int polling, int ttl, int64_t timeout_ms, size_t *unexpected_p)
+{
+    zpoller_t *poller = zpoller_new (mlm_client_msgpipe (consumer), NULL);
+    int64_t deadline_ms = zclock_mono () + timeout_ms;
+    int64_t next_write_ms = 0;
+    size_t received = 0;
+    size_t pending = 0;
+    for (size_t i = 0; i < count; i++)
+        if (devices [i].stopped)
+            pending++;
+    bool drain = pending == 0;
+
+    while ((pending > 0 || drain) && !zsys_interrupted && zclock_mono () < deadline_ms) {
+        int64_t now_ms = zclock_mono ();
+        if (now_ms >= next_write_ms) {
+            for (size_t i = 0; i < count; i++) {
+                // stopped devices write again only to recover
+                if (!devices [i].stopped || streq (state, "RESOLVED"))
+                    s_e2e_write (&devices [i], ttl);
+            }
+            next_write_ms = now_ms + polling * 1000;
+        }
+        if (!zpoller_wait (poller, (int) (next_write_ms - now_ms)))
+            continue;
+        zmsg_t *msg = mlm_client_recv (consumer);
+        if (!msg || !is_fty_proto (msg)) {
+            zmsg_destroy (&msg);
+            continue;
+        }
+        fty_proto_t *alert = fty_proto_decode (&msg);
+        if (!alert)
+            continue;
+        int64_t received_ms = zclock_mono ();
+        if (streq (fty_proto_state (alert), state)) {
+            for (size_t i = 0; i < count; i++) {
+                e2e_device_t *device = &devices [i];
+                if (!streq (device->name, fty_proto_name (alert)))
+                    continue;
+                int64_t *at_ms = streq (state, "ACTIVE") ? &device->active_ms : &device->resolved_ms;
+                if (!device->stopped)
+                    (*unexpected_p)++;
+                else
+                if (*at_ms == 0) {
+                    *at_ms = received_ms;
+                    received++;
+                    pending--;
+                }
+                break;
+            }
+        }
+        fty_proto_destroy (&alert);
+    }
+    zpoller_destroy (&poller);
+    return received;
+}
+
+// announce count devices, stop metrics of stop_percent of them and measure
+// time from their last metric to ACTIVE alert and from their next metric to
+// RESOLVED alert
+static void
+s_bench_e2e (size_t count, int stop_percent, int polling, bool json)
+{
+    int ttl = 2 * polling - 1;
+    zsys_dir_create (E2E_SHM_DIR);
+    fty_shm_set_default_polling_interval (polling);
+    if (fty_shm_set_test_dir (E2E_SHM_DIR) != 0) {
+        log_error ("Can't use %s for shm metrics", E2E_SHM_DIR);
+        return;
+    }
+
+    zactor_t *broker = zactor_new (mlm_server, (void *) "Malamute");
+    zstr_sendx (broker, "BIND", E2E_ENDPOINT, NULL);
+    zactor_t *agent = zactor_new (fty_outage_server, (void *) "outage");
+    zstr_sendx (agent, "CONNECT", E2E_ENDPOINT, "fty-outage", NULL);
+    zstr_sendx (agent, "CONSUMER", "ASSETS", ".*", NULL);
+    zstr_sendx (agent, "PRODUCER", "_ALERTS_SYS", NULL);
+    zstr_sendx (agent, "RESEND-ACTIVE", "false", NULL);
+
+    mlm_client_t *producer = mlm_client_new ();
+    mlm_client_connect (producer, E2E_ENDPOINT, 5000, "bench-assets");
+    mlm_client_set_producer (producer, "ASSETS");
+    mlm_client_t *consumer = mlm_client_new ();
+    mlm_client_connect (consumer, E2E_ENDPOINT, 5000, "bench-alerts");
+    mlm_client_set_consumer (consumer, "_ALERTS_SYS", ".*");
+    zclock_sleep (1000);
+
+    // fleet is announced and seen by the agent
+    uint64_t seed = 42;
+    e2e_device_t *devices = (e2e_device_t *) zmalloc (count * sizeof (e2e_device_t));
+    for (size_t i = 0; i < count; i++) {
+        snprintf (devices [i].name, sizeof (devices [i].name), "ups-%zu", i);
+        zhash_t *aux = zhash_new ();
+        zhash_insert (aux, FTY_PROTO_ASSET_TYPE, (void *) "device");
+        zhash_insert (aux, FTY_PROTO_ASSET_SUBTYPE, (void *) "ups");
+        zhash_insert (aux, FTY_PROTO_ASSET_STATUS, (void *) "active");
+        zmsg_t *msg = fty_proto_encode_asset (aux, devices [i].name, FTY_PROTO_ASSET_OP_CREATE, NULL);
+        zhash_destroy (&aux);
+        mlm_client_send (producer, devices [i].name, &msg);
+        s_e2e_write (&devices [i], ttl);
+    }
+    size_t unexpected = 0;
+    s_e2e_wait (consumer, devices, count, "ACTIVE", polling, ttl, 2 * polling * 1000, &unexpected);
+
+    // random subset stops sending metrics
+    size_t stopped = 0;
+    for (size_t i = 0; i < count; i++) {
+        devices [i].stopped = (int) (s_random (&seed) % 100) < stop_percent;
+        stopped += devices [i].stopped;
+    }
+    int64_t timeout_ms = (2 * ttl + 10 * polling) * 1000;
+    s_e2e_wait (consumer, devices, count, "ACTIVE", polling, ttl, timeout_ms, &unexpected);
+
+    int64_t *latencies = (int64_t *) zmalloc ((stopped + 1) * sizeof (int64_t));
+    size_t detected = 0;
+    int64_t first_ms = 0, last_ms = 0;
+    for (size_t i = 0; i < count; i++) {
+        e2e_device_t *device = &devices [i];
+        if (!device->stopped || device->active_ms == 0)
+            continue;
+        latencies [detected++] = device->active_ms - device->last_write_ms;
+        if (first_ms == 0 || device->active_ms < first_ms)
+            first_ms = device->active_ms;
+        if (device->active_ms > last_ms)
+            last_ms = device->active_ms;
+    }
+    s_e2e_print ("e2e_detect", count, latencies, detected, 2 * ttl * 1000, json);
+
+    // stopped devices send metrics again
+    int64_t recover_ms = zclock_mono ();
+    s_e2e_wait (consumer, devices, count, "RESOLVED", polling, ttl, timeout_ms, &unexpected);
+    size_t recovered = 0;
+    for (size_t i = 0; i < count; i++) {
+        e2e_device_t *device = &devices [i];
+        if (device->stopped && device->resolved_ms > 0)
+            latencies [recovered++] = device->resolved_ms - recover_ms;
+    }
+    s_e2e_print ("e2e_recover", count, latencies, recovered, polling * 1000, json);
+
+    // alerts of one dead devices check are published in a burst
+    double rate = last_ms > first_ms ? (double) detected * 1000.0 / (double) (last_ms - first_ms) : 0;
+    if (json)
+        printf ("{\"bench\":\"e2e_alert_rate\",\"devices\":%zu,\"alerts\":%zu,\"alerts_per_sec\":%.1f,\"unexpected\":%zu}\n",
+                count, detected, rate, unexpected);
+    else
+        printf ("%-18s %8zu devices %6zu alerts  %.1f alerts/s  %zu unexpected\n",
+                "e2e_alert_rate", count, detected, rate, unexpected);
+    if (detected < stopped || recovered < detected)
+        log_warning ("%zu of %zu outages detected, %zu recovered", detected, stopped, recovered);
+
+    free (latencies);
+    free (devices);
+    mlm_client_destroy (&consumer);
+    mlm_client_destroy (&producer);
+    zactor_destroy (&agent);
+    zactor_destroy (&broker);
+    fty_shm_delete_test_dir ();
+}
+
+//  --------------------------------------------------------------------------
+//  Replay of a recording (server/record_file): recorded inputs are fed to
+//  the agent through its actor pipe in simulated time, which starts at the
+//  time of the first record, and published alerts are compared with the
+//  recorded ones
+
+#define REPLAY_NAME "bench-replay"
+#define REPLAY_SYNC_MS 1000         // agent catches up before simulated time moves by more
+
+typedef struct {
+    uint8_t type;                   // RECORDING_*
+    int64_t time_ms;                // simulated time of the record
+    zmsg_t *msg;
+} replay_record_t;
+
+typedef struct {
+    zlistx_t *records;              // replay_record_t of recorded inputs
+    zhashx_t *expected;             // asset -> recorded transitions, e.g. "ACTIVE RESOLVED"
+} replay_t;
+
+// append state to transitions of the asset, re-sent alerts are not transitions
+static void
+s_replay_transition (zhashx_t *transitions, const char *asset, const char *state)
+{
+    const char *old = (const char *) zhashx_lookup (transitions, asset);
+    const char *last = old ? strrchr (old, ' ') : NULL;
+    last = last ? last + 1 : old;
+    if (last && streq (last, state))
+        return;
+    zhashx_update (transitions, asset, old ? zsys_sprintf ("%s %s", old, state) : strdup (state));
+}
+
+static void
+s_replay_load (uint8_t type, int64_t time_ms, zmsg_t *msg, void *arg)
+{
+    replay_t *replay = (replay_t *) arg;
+    if (type == RECORDING_ALERT) {
+        char *asset = zmsg_popstr (msg);
+        char *state = zmsg_popstr (msg);
+        if (asset && state)
+            s_replay_transition (replay->expected, asset, state);
+        zstr_free (&asset);
+        zstr_free (&state);
+        return;
+    }
+    replay_record_t *record = (replay_record_t *) zmalloc (sizeof (replay_record_t));
+    record->type = type;
+    record->time_ms = time_ms;
+    record->msg = zmsg_dup (msg);
+    zlistx_add_end (replay->records, record);
+}
+
+// receive alerts for up to timeout_ms, return number of alerts received
+static size_t
+s_replay_receive (mlm_client_t *consumer, zhashx_t *received, int64_t timeout_ms)
+{
+    zpoller_t *poller = zpoller_new (mlm_client_msgpipe (consumer), NULL);
+    int64_t deadline_ms = zclock_mono () + timeout_ms;
+    size_t count = 0;
+    while (!zsys_interrupted) {
+        int64_t wait_ms = deadline_ms - zclock_mono ();
+        if (!zpoller_wait (poller, wait_ms > 0 ? (int) wait_ms : 0))
+            break;
+        // replies to replayed mailbox requests are dropped
+        zmsg_t *msg = mlm_client_recv (consumer);
+        if (!msg || !is_fty_proto (msg)) {
+            zmsg_destroy (&msg);
+            continue;
+        }
+        fty_proto_t *alert = fty_proto_decode (&msg);
+        if (alert && fty_proto_id (alert) == FTY_PROTO_ALERT) {
+            s_replay_transition (received, fty_proto_name (alert), fty_proto_state (alert));
+            count++;
+        }
+        fty_proto_destroy (&alert);
+    }
+    zpoller_destroy (&poller);
+    return count;
+}
+
+// wait until the agent processed all commands sent so far
+static void
+s_replay_sync (zactor_t *agent)
+{
+    zstr_send (agent, "SYNC");
+    zsock_wait (agent);
+}
+
+// replay recording at speed (times real time, 0 = as fast as possible),
+// return number of assets with different alert transitions
+static int
+s_bench_replay (const char *path, double speed, bool json)
+{
+    replay_t replay;
+    replay.records = zlistx_new ();
+    replay.expected = zhashx_new ();
+    zhashx_set_destructor (replay.expected, (zhashx_destructor_fn *) zstr_free);
+    int rv = recording_read (path, s_replay_load, &replay);
+    replay_record_t *first = (replay_record_t *) zlistx_first (replay.records);
+    if (rv == -1 || !first) {
+        log_error ("Nothing to replay in %s", path);
+        zlistx_destroy (&replay.records);
+        zhashx_destroy (&replay.expected);
+        return -1;
+    }
+
+    zsys_dir_create (E2E_SHM_DIR);
+    if (fty_shm_set_test_dir (E2E_SHM_DIR) != 0)
+        log_error ("Can't use %s for shm metrics", E2E_SHM_DIR);
+
+    zactor_t *broker = zactor_new (mlm_server, (void *) "Malamute");
+    zstr_sendx (broker, "BIND", E2E_ENDPOINT, NULL);
+    zactor_t *agent = zactor_new (fty_outage_server, (void *) "outage");
+    zstr_sendx (agent, "TIMEOUT", "30000", NULL);
+    zstr_sendx (agent, "CONNECT", E2E_ENDPOINT, "fty-outage", NULL);
+    zstr_sendx (agent, "PRODUCER", "_ALERTS_SYS", NULL);
+
+    mlm_client_t *consumer = mlm_client_new ();
+    mlm_client_connect (consumer, E2E_ENDPOINT, 5000, REPLAY_NAME);
+    mlm_client_set_consumer (consumer, "_ALERTS_SYS", ".*");
+    zclock_sleep (1000);
+
+    zhashx_t *received = zhashx_new ();
+    zhashx_set_destructor (received, (zhashx_destructor_fn *) zstr_free);
+    size_t records = zlistx_size (replay.records);
+    size_t alerts = 0;
+    int64_t first_ms = first->time_ms;
+    int64_t synced_ms = first_ms;
+    int64_t last_ms = first_ms;
+    vclock_set_virtual (first_ms);
+    int64_t start_ms = zclock_mono ();
+
+    for (replay_record_t *record = first; record && !zsys_interrupted;
+         record = (replay_record_t *) zlistx_next (replay.records))
+    {
+        if (speed > 0) {
+            int64_t due_ms = start_ms + (int64_t) ((double) (record->time_ms - first_ms) / speed);
+            while (!zsys_interrupted && zclock_mono () < due_ms)
+                alerts += s_replay_receive (consumer, received, due_ms - zclock_mono ());
+        }
+        // simulated time moves only after the agent processed everything before
+        if (record->time_ms - synced_ms >= REPLAY_SYNC_MS) {
+            s_replay_sync (agent);
+            vclock_advance (record->time_ms - vclock_time ());
+            synced_ms = record->time_ms;
+        }
+        if (record->time_ms > last_ms)
+            last_ms = record->time_ms;
+
+        zmsg_t *msg = record->msg;
+        record->msg = NULL;
+        if (record->type == RECORDING_STREAM)
+            zmsg_pushstr (msg, "STREAM");
+        else
+        if (record->type == RECORDING_MAILBOX) {
+            // replies come to us instead of the original sender
+            zframe_t *sender = zmsg_pop (msg);
+            zframe_destroy (&sender);
+            zmsg_pushstr (msg, REPLAY_NAME);
+            zmsg_pushstr (msg, "MAILBOX");
+        }
+        else
+            zmsg_pushstr (msg, "METRICS");
+        zmsg_send (&msg, agent);
+        alerts += s_replay_receive (consumer, received, 0);
+    }
+    s_replay_sync (agent);
+    int64_t replay_ms = zclock_mono () - start_ms;
+    alerts += s_replay_receive (consumer, received, 1000);
+
+    // assets with different transitions in recording and replay
+    int mismatched = 0;
+    for (const char *expected = (const char *) zhashx_first (replay.expected); expected;
+         expected = (const char *) zhashx_next (replay.expected))
+    {
+        const char *asset = (const char *) zhashx_cursor (replay.expected);
+        const char *got = (const char *) zhashx_lookup (received, asset);
+        if (!got || !streq (got, expected)) {
+            log_warning ("%s: recorded '%s', replayed '%s'", asset, expected, got ? got : "");
+            mismatched++;
+        }
+    }
+    for (const char *got = (const char *) zhashx_first (received); got;
+         got = (const char *) zhashx_next (received))
+    {
+        const char *asset = (const char *) zhashx_cursor (received);
+        if (!zhashx_lookup (replay.expected, asset)) {
+            log_warning ("%s: recorded '', replayed '%s'", asset, got);
+            mismatched++;
+        }
+    }
+
+    double recorded_sec = (double) (last_ms - first_ms) / 1000.0;
+    double rate = replay_ms > 0 ? (double) records * 1000.0 / (double) replay_ms : 0;
+    if (json)
+        printf ("{\"bench\":\"replay\",\"records\":%zu,\"recorded_sec\":%.1f,\"replay_ms\":%" PRIi64
+                ",\"records_per_sec\":%.1f,\"alerts\":%zu,\"assets_alerted\":%zu,\"mismatched\":%d}\n",
+                records, recorded_sec, replay_ms, rate, alerts, zhashx_size (replay.expected), mismatched);
+    else
+        printf ("%-18s %8zu records  %.1f s recorded  replayed in %" PRIi64 " ms  %.1f records/s  "
+                "%zu alerts  %zu assets alerted  %d mismatched\n",
+                "replay", records, recorded_sec, replay_ms, rate, alerts, zhashx_size (replay.expected), mismatched);
+
+    vclock_set_real ();
+    zhashx_destroy (&received);
+    mlm_client_destroy (&consumer);
+    zactor_destroy (&agent);
+    zactor_destroy (&broker);
+    fty_shm_delete_test_dir ();
+    for (replay_record_t *record = (replay_record_t *) zlistx_first (replay.records); record;
+         record = (replay_record_t *) zlistx_next (replay.records))
+    {
+        zmsg_destroy (&record->msg);
+        free (record);
+    }
+    zlistx_destroy (&replay.records);
+    zhashx_destroy (&replay.expected);
+    return mismatched;
+}
+#endif // FTY_OUTAGE_BUILD_DRAFT_API
+
+int
+main (int argc, char *argv [])
+{
+    ftylog_setInstance ("fty_outage_bench", "");
+    logging_refresh ();
+    bool json = false;
+    size_t e2e_devices = 0;
+    int stop_percent = 10;
+    int polling = 5;
+    int soak_days = 0;
+    const char *replay_file = NULL;
+    double speed = 1;
+    zlistx_t *sizes = zlistx_new ();
+    int argn;
+    for (argn = 1; argn < argc; argn++) {
+        char *param = NULL;
+        if (argn < argc - 1) param = argv [argn+1];
+
+        if (streq (argv [argn], "--help")
+        ||  streq (argv [argn], "-h")) {
+            puts ("fty_outage_bench [options] ...");
+            puts ("  --json / -j            one JSON object per result");
+            puts ("  --size / -s N          size of the fleet (repeatable)");
+            puts ("  --e2e / -e N           detection latency of agent with N devices");
+            puts ("  --stop PERCENT         devices, which stop sending metrics (e2e)");
+            puts ("  --polling SEC          polling interval of the agent (e2e)");
+            puts ("  --soak DAYS            simulate DAYS of churn of the fleet, fail on memory growth");
+            puts ("  --replay FILE          replay recording of the agent, fail if alerts differ");
+            puts ("  --speed X              replay X times faster than recorded, 0 = no waiting");
+            puts ("  --help / -h            this information");
+            zlistx_destroy (&sizes);
+            return 0;
+        }
+        else
+        if (streq (argv [argn], "--json") || streq (argv [argn], "-j")) {
+            json = true;
+        }
+        else
+        if (streq (argv [argn], "--size") || streq (argv [argn], "-s")) {
+            if (param && atoll (param) > 0)
+                zlistx_add_end (sizes, (void *) (uintptr_t) atoll (param));
+            ++argn;
+        }
+        else
+        if (streq (argv [argn], "--e2e") || streq (argv [argn], "-e")) {
+            if (param && atoll (param) > 0)
+                e2e_devices = (size_t) atoll (param);
+            ++argn;
+        }
+        else
+        if (streq (argv [argn], "--stop")) {
+            if (param && atoi (param) > 0 && atoi (param) <= 100)
+                stop_percent = atoi (param);
+            ++argn;
+        }
+        else
+        if (streq (argv [argn], "--soak")) {
+            if (param && atoi (param) > 0)
+                soak_days = atoi (param);
+            ++argn;
+        }
+        else
+        if (streq (argv [argn], "--replay")) {
+            replay_file = param;
+            ++argn;
+        }
+        else
+        if (streq (argv [argn], "--speed")) {
+            if (param && atof (param) >= 0)
+                speed = atof (param);
+            ++argn;
+        }
+        else
+        if (streq (argv [argn], "--polling")) {
+            if (param && atoi (param) > 0)
+                polling = atoi (param);
+            ++argn;
+        }
+        else {
+            printf ("Unknown option: %s\n", argv [argn]);
+            zlistx_destroy (&sizes);
+            return 1;
+        }
+    }
+    if (e2e_devices > 0) {
+#ifdef FTY_OUTAGE_BUILD_DRAFT_API
+        s_bench_e2e (e2e_devices, stop_percent, polling, json);
+#else
+        log_error ("end-to-end benchmark needs draft API (--enable-drafts)");
+#endif
+        zlistx_destroy (&sizes);
+        return 0;
+    }
+    if (replay_file) {
+        int rv = -1;
+#ifdef FTY_OUTAGE_BUILD_DRAFT_API
+        rv = s_bench_replay (replay_file, speed, json);
+#else
+        log_error ("replay needs draft API (--enable-drafts)");
+#endif
+        zlistx_destroy (&sizes);
+        return rv == 0 ? 0 : 1;
+    }
+    if (soak_days > 0) {
+        size_t count = zlistx_size (sizes) ? (size_t) (uintptr_t) zlistx_first (sizes) : 10000;
+        int rv = s_bench_soak (count, soak_days, json);
+        zlistx_destroy (&sizes);
+        return rv == 0 ? 0 : 1;
+    }
+    if (zlistx_size (sizes) == 0) {
+        for (const size_t *it = s_default_sizes; *it; it++)
+            zlistx_add_end (sizes, (void *) (uintptr_t) *it);
+    }
+
+    if (!BENCH_COUNTS_ALLOCS)
+        log_warning ("allocations are not counted on this platform");
+    for (void *it = zlistx_first (sizes); it != NULL; it = zlistx_next (sizes))
+        s_bench_fleet ((size_t) (uintptr_t) it, json);
+    zlistx_destroy (&sizes);
+    return 0;
+}
@@ -37,12 +37,77 @@
 typedef struct _data_t data_t;
 #define DATA_T_DEFINED
 #endif
+#ifndef STATE_T_DEFINED
+typedef struct _state_t state_t;
+#define STATE_T_DEFINED
+#endif
+#ifndef JOURNAL_T_DEFINED
+typedef struct _journal_t journal_t;
+#define JOURNAL_T_DEFINED
+#endif
+#ifndef CATALOG_T_DEFINED
+typedef struct _catalog_t catalog_t;
+#define CATALOG_T_DEFINED
+#endif
+#ifndef DEADLINE_T_DEFINED
+typedef struct _deadline_t deadline_t;
+#define DEADLINE_T_DEFINED
+#endif
+#ifndef SCHEDULE_T_DEFINED
+typedef struct _schedule_t schedule_t;
+#define SCHEDULE_T_DEFINED
+#endif
+#ifndef STATUS_T_DEFINED
+typedef struct _status_t status_t;
+#define STATUS_T_DEFINED
+#endif
+#ifndef STATS_T_DEFINED
+typedef struct _stats_t stats_t;
+#define STATS_T_DEFINED
+#endif
+#ifndef VCLOCK_T_DEFINED
+typedef struct _vclock_t vclock_t;
+#define VCLOCK_T_DEFINED
+#endif
+#ifndef RECORDING_T_DEFINED
+typedef struct _recording_t recording_t;
+#define RECORDING_T_DEFINED
+#endif
+#ifndef PROBE_T_DEFINED
+typedef struct _probe_t probe_t;
+#define PROBE_T_DEFINED
+#endif
+#ifndef LOGGING_T_DEFINED
+typedef struct _logging_t logging_t;
+#define LOGGING_T_DEFINED
+#endif
+#ifndef BLACKBOX_T_DEFINED
+typedef struct _blackbox_t blackbox_t;
+#define BLACKBOX_T_DEFINED
+#endif
+#ifndef WATCHDOG_T_DEFINED
+typedef struct _watchdog_t watchdog_t;
+#define WATCHDOG_T_DEFINED
+#endif
 
 //  Extra headers
 
 //  Internal API
 
 #include "data.h"
+#include "state.h"
+#include "journal.h"
+#include "catalog.h"
+#include "deadline.h"
+#include "schedule.h"
+#include "status.h"
+#include "stats.h"
+#include "vclock.h"
+#include "recording.h"
+#include "probe.h"
+#include "logging.h"
+#include "blackbox.h"
+#include "watchdog.h"
 
 //  *** To avoid double-definitions, only define if building without draft ***
 #ifndef FTY_OUTAGE_BUILD_DRAFT_API
@@ -52,6 +117,71 @@ typedef struct _data_t data_t;
 FTY_OUTAGE_PRIVATE void
     data_test (bool verbose);
 
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    state_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    journal_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    catalog_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    deadline_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    schedule_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    status_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    stats_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    vclock_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    recording_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    probe_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    logging_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    blackbox_test (bool verbose);
+
+//  *** Draft method, defined for internal use only ***
+//  Self test of this class.
+FTY_OUTAGE_PRIVATE void
+    watchdog_test (bool verbose);
+
 //  Self test for private classes
 FTY_OUTAGE_PRIVATE void
     fty_outage_private_selftest (bool verbose, const char *subtest);
@@ -40,6 +40,32 @@ fty_outage_private_selftest (bool verbose, const char *subtest)
 // Tests for stable private classes:
     if (streq (subtest, "$ALL") || streq (subtest, "data_test"))
         data_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "state_test"))
+        state_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "journal_test"))
+        journal_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "catalog_test"))
+        catalog_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "deadline_test"))
+        deadline_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "schedule_test"))
+        schedule_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "status_test"))
+        status_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "stats_test"))
+        stats_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "vclock_test"))
+        vclock_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "recording_test"))
+        recording_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "probe_test"))
+        probe_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "logging_test"))
+        logging_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "blackbox_test"))
+        blackbox_test (verbose);
+    if (streq (subtest, "$ALL") || streq (subtest, "watchdog_test"))
+        watchdog_test (verbose);
 }
 /*
 ################################################################################
@@ -43,11 +43,25 @@ all_tests [] = {
 // Tests for stable/draft private classes:
 // Now built only with --enable-drafts, so even stable builds are hidden behind the flag
     { "data", NULL, true, false, "data_test" },
+    { "state", NULL, true, false, "state_test" },
+    { "journal", NULL, true, false, "journal_test" },
+    { "catalog", NULL, true, false, "catalog_test" },
+    { "deadline", NULL, true, false, "deadline_test" },
+    { "schedule", NULL, true, false, "schedule_test" },
+    { "status", NULL, true, false, "status_test" },
+    { "stats", NULL, true, false, "stats_test" },
+    { "vclock", NULL, true, false, "vclock_test" },
+    { "recording", NULL, true, false, "recording_test" },
+    { "probe", NULL, true, false, "probe_test" },
+    { "logging", NULL, true, false, "logging_test" },
+    { "blackbox", NULL, true, false, "blackbox_test" },
+    { "watchdog", NULL, true, false, "watchdog_test" },
     { "private_classes", NULL, false, false, "$ALL" }, // compat option for older projects
 #endif // FTY_OUTAGE_BUILD_DRAFT_API
 #ifdef FTY_OUTAGE_BUILD_DRAFT_API
 // Tests for draft public classes:
     { "fty_outage_server", fty_outage_server_test, false, true, NULL },
+    { "fty_outage_status", fty_outage_status_test, false, true, NULL },
 #endif // FTY_OUTAGE_BUILD_DRAFT_API
     {NULL, NULL, 0, 0, NULL}          //  Sentinel
 };
@@ -0,0 +1,469 @@
+/*  =========================================================================
+    journal - Append-only journal of outage state changes
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    journal - Append-only journal of outage state changes
+@discuss
+    Transitions between two state snapshots are appended to the journal and
+    synced to disk in groups. On startup the journal is replayed on top of
+    the last snapshot. Each record carries its own checksum, so a torn
+    write at the end of the journal is detected and cut off.
+
+    When a snapshot is saved in background, the journal is rotated at the
+    moment the snapshot is taken, and rotated records are dropped only once
+    the snapshot is on disk.
+@end
+*/
+
+#include "fty_outage_classes.h"
+
+// write(2), replaced by selftest to inject short writes
+static ssize_t (*s_journal_write) (int fd, const void *data, size_t size) = write;
+
+static uint32_t
+s_record_checksum (const journal_record_t *record, const char *asset_name)
+{
+    uint64_t hash = STATE_FNV_OFFSET_BASIS;
+    hash = state_fnv1a (hash, &record->length, sizeof (journal_record_t) - sizeof (record->checksum));
+    hash = state_fnv1a (hash, asset_name, record->length);
+    return (uint32_t) hash;
+}
+
+//  --------------------------------------------------------------------------
+//  Open journal for appending
+journal_t *
+journal_new (const char *path)
+{
+    assert (path);
+
+    journal_t *self = (journal_t *) zmalloc (sizeof (journal_t));
+    if (!self)
+        return NULL;
+
+    self->fd = open (path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (self->fd == -1) {
+        log_error ("Can't open journal %s: %m", path);
+        free (self);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat (self->fd, &st) == 0)
+        self->size = (uint64_t) st.st_size;
+    self->path = strdup (path);
+    self->rotated_path = zsys_sprintf ("%s.old", path);
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Sync pending records and close the journal
+void
+journal_destroy (journal_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        journal_t *self = *self_p;
+        journal_sync (self, true);
+        close (self->fd);
+        zstr_free (&self->path);
+        zstr_free (&self->rotated_path);
+        free (self->buffer);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+// replay records of journal file, return number of records replayed or -1
+// offset_p is set to the end of the last good record
+static int
+s_journal_replay_file (const char *path, journal_replay_fn *replay_fn, void *arg, uint64_t *offset_p)
+{
+    FILE *f = fopen (path, "rb");
+    if (!f) {
+        log_error ("Can't read journal %s: %m", path);
+        return -1;
+    }
+
+    int count = 0;
+    uint64_t offset = 0;
+    char name [UINT16_MAX + 1];
+    journal_record_t record;
+    while (fread (&record, sizeof (record), 1, f) == 1) {
+        if (record.length == 0
+        ||  fread (name, record.length, 1, f) != 1
+        ||  name [record.length - 1] != '\0'
+        ||  s_record_checksum (&record, name) != record.checksum)
+            break;
+        replay_fn (record.type, name, record.time_sec, record.value, arg);
+        offset += sizeof (record) + record.length;
+        count++;
+    }
+    fclose (f);
+    *offset_p = offset;
+    return count;
+}
+
+//  --------------------------------------------------------------------------
+//  Call replay_fn for each record of the journal in order
+int
+journal_replay (journal_t *self, journal_replay_fn *replay_fn, void *arg)
+{
+    assert (self);
+    assert (replay_fn);
+
+    journal_sync (self, true);
+
+    int rotated = 0;
+    uint64_t offset = 0;
+    if (zsys_file_exists (self->rotated_path)) {
+        rotated = s_journal_replay_file (self->rotated_path, replay_fn, arg, &offset);
+        if (rotated == -1)
+            rotated = 0;
+    }
+
+    int count = s_journal_replay_file (self->path, replay_fn, arg, &offset);
+    if (count == -1)
+        return -1;
+
+    if (offset < self->size) {
+        log_warning ("Journal %s is damaged at offset %" PRIu64 ", cutting it off", self->path, offset);
+        if (ftruncate (self->fd, (off_t) offset) != 0) {
+            log_error ("Can't truncate journal %s: %m", self->path);
+            return -1;
+        }
+        self->size = offset;
+    }
+    return rotated + count;
+}
+
+//  --------------------------------------------------------------------------
+//  Append record
+int
+journal_append (journal_t *self, uint8_t type, const char *asset_name, uint64_t time_sec, uint64_t value)
+{
+    assert (self);
+    assert (asset_name);
+
+    size_t length = strlen (asset_name) + 1;
+    if (length > UINT16_MAX) {
+        log_error ("Asset name %.32s... too long for journal", asset_name);
+        return -1;
+    }
+    size_t size = sizeof (journal_record_t) + length;
+    if (self->buffer_size + size > self->buffer_alloc) {
+        size_t alloc = self->buffer_alloc ? self->buffer_alloc * 2 : 16384;
+        while (alloc < self->buffer_size + size)
+            alloc *= 2;
+        char *buffer = (char *) realloc (self->buffer, alloc);
+        if (!buffer)
+            return -1;
+        self->buffer = buffer;
+        self->buffer_alloc = alloc;
+    }
+
+    journal_record_t record;
+    memset (&record, 0, sizeof (record));
+    record.length = (uint16_t) length;
+    record.type = type;
+    record.time_sec = time_sec;
+    record.value = value;
+    record.checksum = s_record_checksum (&record, asset_name);
+
+    memcpy (self->buffer + self->buffer_size, &record, sizeof (record));
+    memcpy (self->buffer + self->buffer_size + sizeof (record), asset_name, length);
+    self->buffer_size += size;
+    self->size += size;
+    if (self->pending++ == 0)
+        self->pending_since_ms = zclock_mono ();
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Write and fsync pending records
+int
+journal_sync (journal_t *self, bool force)
+{
+    assert (self);
+
+    if (self->pending == 0)
+        return 0;
+    if (!force
+    &&  self->pending < JOURNAL_SYNC_RECORDS
+    &&  zclock_mono () - self->pending_since_ms < JOURNAL_SYNC_MS)
+        return 0;
+
+    const char *p = self->buffer;
+    size_t size = self->buffer_size;
+    while (size > 0) {
+        ssize_t n = s_journal_write (self->fd, p, size);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            log_error ("Can't write journal %s: %m", self->path);
+            // part already in the file is not written again, so the next
+            // sync completes the torn record instead of repeating it
+            memmove (self->buffer, p, size);
+            self->buffer_size = size;
+            return -1;
+        }
+        p += n;
+        size -= (size_t) n;
+    }
+    self->buffer_size = 0;
+    self->pending = 0;
+
+    if (fdatasync (self->fd) != 0) {
+        log_error ("Can't sync journal %s: %m", self->path);
+        return -1;
+    }
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Return number of records not synced yet
+size_t
+journal_pending (journal_t *self)
+{
+    assert (self);
+    return self->pending;
+}
+
+//  --------------------------------------------------------------------------
+//  Return size of the journal in bytes
+uint64_t
+journal_size (journal_t *self)
+{
+    assert (self);
+    return self->size;
+}
+
+//  --------------------------------------------------------------------------
+//  Drop all records
+int
+journal_truncate (journal_t *self)
+{
+    assert (self);
+
+    self->buffer_size = 0;
+    self->pending = 0;
+    self->size = 0;
+    if (ftruncate (self->fd, 0) != 0 || fdatasync (self->fd) != 0) {
+        log_error ("Can't truncate journal %s: %m", self->path);
+        return -1;
+    }
+    journal_discard_rotated (self);
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Move all records aside
+int
+journal_rotate (journal_t *self)
+{
+    assert (self);
+
+    if (journal_sync (self, true) != 0)
+        return -1;
+
+    if (!zsys_file_exists (self->rotated_path)) {
+        if (rename (self->path, self->rotated_path) != 0) {
+            log_error ("Can't rotate journal %s: %m", self->path);
+            return -1;
+        }
+        int fd = open (self->path, O_WRONLY | O_CREAT | O_APPEND | O_TRUNC, 0644);
+        if (fd == -1) {
+            log_error ("Can't open journal %s: %m", self->path);
+            return -1;
+        }
+        close (self->fd);
+        self->fd = fd;
+    }
+    else {
+        // previous snapshot did not get saved, its records are still needed
+        FILE *in = fopen (self->path, "rb");
+        FILE *out = fopen (self->rotated_path, "ab");
+        int rv = (in && out) ? 0 : -1;
+        char buffer [16384];
+        size_t n;
+        while (rv == 0 && (n = fread (buffer, 1, sizeof (buffer), in)) > 0) {
+            if (fwrite (buffer, 1, n, out) != n)
+                rv = -1;
+        }
+        if (out && (fflush (out) != 0 || fdatasync (fileno (out)) != 0))
+            rv = -1;
+        if (in)
+            fclose (in);
+        if (out)
+            fclose (out);
+        if (rv != 0 || ftruncate (self->fd, 0) != 0) {
+            log_error ("Can't rotate journal %s: %m", self->path);
+            return -1;
+        }
+    }
+    self->size = 0;
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Drop records moved aside by journal_rotate
+void
+journal_discard_rotated (journal_t *self)
+{
+    assert (self);
+    unlink (self->rotated_path);
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+typedef struct {
+    int count;
+    uint8_t types [8];
+    char names [8][32];
+    uint64_t values [8];
+} test_replay_t;
+
+// write at most 10 bytes, then fail
+static ssize_t
+s_test_short_write (int fd, const void *data, size_t size)
+{
+    static bool written = false;
+    if (written) {
+        written = false;
+        errno = EIO;
+        return -1;
+    }
+    written = true;
+    return write (fd, data, size < 10 ? size : 10);
+}
+
+static void
+s_test_replay (uint8_t type, const char *asset_name, uint64_t time_sec, uint64_t value, void *arg)
+{
+    test_replay_t *replay = (test_replay_t *) arg;
+    assert (time_sec == 1000 + (uint64_t) replay->count);
+    assert (replay->count < 8);
+    replay->types [replay->count] = type;
+    snprintf (replay->names [replay->count], 32, "%s", asset_name);
+    replay->values [replay->count] = value;
+    replay->count++;
+}
+
+void
+journal_test (bool verbose)
+{
+    ftylog_setInstance("journal_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * journal: \n");
+
+    //  @selftest
+    const char *path = "src/journal_test.journal";
+    unlink (path);
+
+    journal_t *journal = journal_new (path);
+    assert (journal);
+    assert (journal_size (journal) == 0);
+    assert (journal_append (journal, JOURNAL_ALERT_ACTIVE, "UPS1", 1000, 0) == 0);
+    assert (journal_append (journal, JOURNAL_MAINTENANCE_ENABLE, "DEVICE WITH SPACE", 1001, 4601) == 0);
+    assert (journal_pending (journal) == 2);
+
+    // not enough records, not old enough
+    assert (journal_sync (journal, false) == 0);
+    assert (journal_pending (journal) == 2);
+    assert (journal_sync (journal, true) == 0);
+    assert (journal_pending (journal) == 0);
+    assert (journal_append (journal, JOURNAL_ALERT_RESOLVED, "UPS1", 1002, 0) == 0);
+    journal_destroy (&journal);
+
+    // replay after restart
+    journal = journal_new (path);
+    assert (journal);
+    test_replay_t replay;
+    memset (&replay, 0, sizeof (replay));
+    assert (journal_replay (journal, s_test_replay, &replay) == 3);
+    assert (replay.count == 3);
+    assert (replay.types [0] == JOURNAL_ALERT_ACTIVE && streq (replay.names [0], "UPS1"));
+    assert (replay.types [1] == JOURNAL_MAINTENANCE_ENABLE && streq (replay.names [1], "DEVICE WITH SPACE"));
+    assert (replay.values [1] == 4601);
+    assert (replay.types [2] == JOURNAL_ALERT_RESOLVED);
+    uint64_t size = journal_size (journal);
+    journal_destroy (&journal);
+
+    // torn write is cut off, following records are readable
+    FILE *f = fopen (path, "ab");
+    assert (f);
+    fputs ("garbage", f);
+    fclose (f);
+    journal = journal_new (path);
+    memset (&replay, 0, sizeof (replay));
+    assert (journal_replay (journal, s_test_replay, &replay) == 3);
+    assert (journal_size (journal) == size);
+    assert (journal_append (journal, JOURNAL_ASSET_DELETE, "UPS1", 1003, 0) == 0);
+    assert (journal_sync (journal, true) == 0);
+    memset (&replay, 0, sizeof (replay));
+    assert (journal_replay (journal, s_test_replay, &replay) == 4);
+    assert (replay.types [3] == JOURNAL_ASSET_DELETE);
+
+    // failed short write is completed by the next sync, nothing is torn
+    assert (journal_append (journal, JOURNAL_ALERT_ACTIVE, "UPS3", 1004, 0) == 0);
+    assert (journal_append (journal, JOURNAL_ALERT_RESOLVED, "UPS3", 1005, 0) == 0);
+    s_journal_write = s_test_short_write;
+    assert (journal_sync (journal, true) == -1);
+    s_journal_write = write;
+    assert (journal_pending (journal) == 2);
+    assert (journal_sync (journal, true) == 0);
+    memset (&replay, 0, sizeof (replay));
+    assert (journal_replay (journal, s_test_replay, &replay) == 6);
+    assert (replay.types [5] == JOURNAL_ALERT_RESOLVED && streq (replay.names [5], "UPS3"));
+
+    // rotated records are replayed until discarded
+    assert (journal_rotate (journal) == 0);
+    assert (journal_size (journal) == 0);
+    assert (journal_append (journal, JOURNAL_ALERT_ACTIVE, "UPS2", 1006, 0) == 0);
+    assert (journal_sync (journal, true) == 0);
+    memset (&replay, 0, sizeof (replay));
+    assert (journal_replay (journal, s_test_replay, &replay) == 7);
+    assert (replay.types [6] == JOURNAL_ALERT_ACTIVE && streq (replay.names [6], "UPS2"));
+    // snapshot was not saved, rotate again keeps everything
+    assert (journal_rotate (journal) == 0);
+    memset (&replay, 0, sizeof (replay));
+    assert (journal_replay (journal, s_test_replay, &replay) == 7);
+    journal_discard_rotated (journal);
+    memset (&replay, 0, sizeof (replay));
+    assert (journal_replay (journal, s_test_replay, &replay) == 0);
+    assert (journal_append (journal, JOURNAL_ALERT_ACTIVE, "UPS2", 1000, 0) == 0);
+    assert (journal_rotate (journal) == 0);
+
+    // truncate after snapshot
+    assert (journal_truncate (journal) == 0);
+    assert (journal_size (journal) == 0);
+    memset (&replay, 0, sizeof (replay));
+    assert (journal_replay (journal, s_test_replay, &replay) == 0);
+    journal_destroy (&journal);
+
+    unlink (path);
+    assert (!zsys_file_exists ("src/journal_test.journal.old"));
+    //  @end
+    printf ("OK\n");
+}
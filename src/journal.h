@@ -0,0 +1,137 @@
+/*  =========================================================================
+    journal - Append-only journal of outage state changes
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef JOURNAL_H_INCLUDED
+#define JOURNAL_H_INCLUDED
+
+#include "../include/fty-outage.h"
+
+// journaled transitions
+#define JOURNAL_ALERT_ACTIVE        1   // outage alert activated
+#define JOURNAL_ALERT_RESOLVED      2   // outage alert resolved
+#define JOURNAL_MAINTENANCE_ENABLE  3   // maintenance enabled, value is its end [s]
+#define JOURNAL_MAINTENANCE_DISABLE 4   // maintenance disabled
+#define JOURNAL_ASSET_ADD           5   // asset is tracked
+#define JOURNAL_ASSET_DELETE        6   // asset is not tracked anymore
+
+// records are synced to disk in groups of this size ...
+#define JOURNAL_SYNC_RECORDS 512
+// ... or when the oldest pending record is older than this
+#define JOURNAL_SYNC_MS 1000
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// record on disk (native byte order), followed by zero terminated asset name
+typedef struct _journal_record_t {
+    uint32_t checksum;              // FNV-1a (lower half) of the rest of record and name
+    uint16_t length;                // [B] of asset name including terminating zero
+    uint8_t type;                   // JOURNAL_*
+    uint8_t reserved;
+    uint64_t time_sec;              // [s] time of the transition
+    uint64_t value;                 // type specific value
+} journal_record_t;
+
+//  Structure of our class
+struct _journal_t {
+    char *path;                     // journal file
+    char *rotated_path;             // records of a snapshot being saved
+    int fd;                         // opened for append
+    char *buffer;                   // records not written yet
+    size_t buffer_size;             // [B] used
+    size_t buffer_alloc;            // [B] allocated
+    size_t pending;                 // records not synced yet
+    int64_t pending_since_ms;       // zclock_mono of the oldest pending record
+    uint64_t size;                  // [B] of the journal, including pending records
+};
+
+#ifndef JOURNAL_T_DEFINED
+typedef struct _journal_t journal_t;
+#define JOURNAL_T_DEFINED
+#endif
+
+// callback for journal_replay
+typedef void (journal_replay_fn) (uint8_t type, const char *asset_name, uint64_t time_sec, uint64_t value, void *arg);
+
+//  @interface
+//  Open journal for appending, file is created if missing
+//  return NULL on error
+FTY_OUTAGE_EXPORT journal_t *
+    journal_new (const char *path);
+
+//  Sync pending records and close the journal
+FTY_OUTAGE_EXPORT void
+    journal_destroy (journal_t **self_p);
+
+//  Call replay_fn for each record of the journal in order, starting with
+//  records rotated for a snapshot, which did not get saved
+//  damaged tail of the journal (torn write) is cut off
+//  return number of records replayed, -1 on error
+FTY_OUTAGE_EXPORT int
+    journal_replay (journal_t *self, journal_replay_fn *replay_fn, void *arg);
+
+//  Append record, it is kept in memory until journal_sync
+//  return -1 on memory error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    journal_append (journal_t *self, uint8_t type, const char *asset_name, uint64_t time_sec, uint64_t value);
+
+//  Write and fsync pending records, if there are enough of them or they are
+//  old enough (force = false), or unconditionally (force = true)
+//  return -1 on error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    journal_sync (journal_t *self, bool force);
+
+//  Return number of records not synced yet
+FTY_OUTAGE_EXPORT size_t
+    journal_pending (journal_t *self);
+
+//  Return size of the journal in bytes
+FTY_OUTAGE_EXPORT uint64_t
+    journal_size (journal_t *self);
+
+//  Drop all records, called once they are part of a saved state snapshot
+//  return -1 on error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    journal_truncate (journal_t *self);
+
+//  Move all records aside, called when snapshot is taken to be saved in
+//  background, new records go to an empty journal
+//  return -1 on error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    journal_rotate (journal_t *self);
+
+//  Drop records moved aside by journal_rotate, called once the snapshot
+//  is saved
+FTY_OUTAGE_EXPORT void
+    journal_discard_rotated (journal_t *self);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    journal_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,96 @@
+/*  =========================================================================
+    logging - Log level gating of hot paths
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    logging - Log level gating of hot paths
+@discuss
+    log_debug of fty_log evaluates all its arguments and calls the logger,
+    which only then checks the level. Hot paths (each metric, each asset of
+    the dead devices check) use logging_debug instead: the level is checked
+    against a value cached by logging_refresh before anything else, and
+    levels below FTY_OUTAGE_LOG_FLOOR are not compiled in at all.
+@end
+*/
+
+#include "fty_outage_classes.h"
+
+int fty_outage_logging_level = LOGGING_TRACE;
+
+//  --------------------------------------------------------------------------
+//  Cache the lowest level enabled in the logger
+void
+logging_refresh (void)
+{
+    Ftylog *log = ftylog_getInstance ();
+    int level = LOGGING_INFO;
+    if (ftylog_isLogTrace (log))
+        level = LOGGING_TRACE;
+    else
+    if (ftylog_isLogDebug (log))
+        level = LOGGING_DEBUG;
+    __atomic_store_n (&fty_outage_logging_level, level, __ATOMIC_RELAXED);
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+static int s_evaluated = 0;
+
+static const char *
+s_test_argument (void)
+{
+    s_evaluated++;
+    return "evaluated";
+}
+
+void
+logging_test (bool verbose)
+{
+    ftylog_setInstance("logging_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * logging: \n");
+
+    //  @selftest
+    // cached level follows the logger
+    logging_refresh ();
+    assert (logging_enabled (LOGGING_INFO));
+    assert (logging_enabled (LOGGING_DEBUG) == (FTY_OUTAGE_LOG_FLOOR <= LOGGING_DEBUG && ftylog_isLogDebug (ftylog_getInstance ())));
+
+    // arguments of disabled levels are not evaluated
+    int level = fty_outage_logging_level;
+    fty_outage_logging_level = LOGGING_INFO;
+    s_evaluated = 0;
+    logging_debug ("%s", s_test_argument ());
+    logging_trace ("%s", s_test_argument ());
+    assert (s_evaluated == 0);
+
+    fty_outage_logging_level = LOGGING_DEBUG;
+    logging_debug ("%s", s_test_argument ());
+    logging_trace ("%s", s_test_argument ());
+    assert (s_evaluated == (FTY_OUTAGE_LOG_FLOOR <= LOGGING_DEBUG ? 1 : 0));
+    fty_outage_logging_level = level;
+    //  @end
+    printf ("OK\n");
+}
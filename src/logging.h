@@ -0,0 +1,74 @@
+/*  =========================================================================
+    logging - Log level gating of hot paths
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef LOGGING_H_INCLUDED
+#define LOGGING_H_INCLUDED
+
+#include "../include/fty-outage.h"
+
+// levels of logging_enabled, as of fty_log
+#define LOGGING_TRACE   0
+#define LOGGING_DEBUG   1
+#define LOGGING_INFO    2
+
+// logging_trace and logging_debug below this level are compiled out, e.g.
+// CXXFLAGS=-DFTY_OUTAGE_LOG_FLOOR=LOGGING_INFO for builds without debug logging
+#ifndef FTY_OUTAGE_LOG_FLOOR
+#define FTY_OUTAGE_LOG_FLOOR LOGGING_TRACE
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// lowest level enabled in the logger, cached by logging_refresh; all levels
+// are enabled until the first refresh
+FTY_OUTAGE_EXPORT extern int fty_outage_logging_level;
+
+// true if messages of level are logged, costs a compare of a cached value
+#define logging_enabled(level) \
+    ((level) >= FTY_OUTAGE_LOG_FLOOR \
+    && __builtin_expect ((level) >= __atomic_load_n (&fty_outage_logging_level, __ATOMIC_RELAXED), 0))
+
+// log_trace and log_debug of hot paths, arguments are not evaluated unless
+// the level is enabled
+#define logging_trace(...) \
+    do { if (logging_enabled (LOGGING_TRACE)) log_trace (__VA_ARGS__); } while (0)
+#define logging_debug(...) \
+    do { if (logging_enabled (LOGGING_DEBUG)) log_debug (__VA_ARGS__); } while (0)
+
+//  @interface
+//  Cache the lowest level enabled in the logger, called whenever its level
+//  may have changed (verbose mode, log configuration reloaded)
+FTY_OUTAGE_EXPORT void
+    logging_refresh (void);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    logging_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,188 @@
+/*  =========================================================================
+    probe - USDT probes of hot paths
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    probe - USDT probes of hot paths
+@discuss
+    Probes themselves are macros of probe.h. Each of them leaves a note in
+    section .note.stapsdt of the binary, which tracers read to find it; this
+    class reads the notes as well, so tests can check that the probes are
+    compiled in.
+@end
+*/
+
+#include "fty_outage_classes.h"
+#include <link.h>
+
+#define STAPSDT_NOTE_TYPE 3
+
+// read size bytes at offset of file, return 0 if all were read
+static int
+s_read_at (FILE *file, long offset, void *buffer, size_t size)
+{
+    if (fseek (file, offset, SEEK_SET) != 0)
+        return -1;
+    return fread (buffer, size, 1, file) == 1 ? 0 : -1;
+}
+
+//  --------------------------------------------------------------------------
+//  Return list of probes found in ELF file at path
+zlistx_t *
+probe_list (const char *path)
+{
+    assert (path);
+
+    FILE *file = fopen (path, "rb");
+    if (!file)
+        return NULL;
+
+    ElfW(Ehdr) header;
+    if (s_read_at (file, 0, &header, sizeof (header)) != 0
+    ||  memcmp (header.e_ident, ELFMAG, SELFMAG) != 0
+    ||  header.e_ident [EI_CLASS] != (sizeof (void *) == 8 ? ELFCLASS64 : ELFCLASS32)
+    ||  header.e_shentsize != sizeof (ElfW(Shdr))
+    ||  header.e_shstrndx >= header.e_shnum) {
+        fclose (file);
+        return NULL;
+    }
+
+    ElfW(Shdr) *sections = (ElfW(Shdr) *) zmalloc (header.e_shnum * sizeof (ElfW(Shdr)));
+    ElfW(Shdr) *names = NULL;
+    if (s_read_at (file, (long) header.e_shoff, sections, header.e_shnum * sizeof (ElfW(Shdr))) == 0)
+        names = &sections [header.e_shstrndx];
+
+    zlistx_t *probes = names ? zlistx_new () : NULL;
+    if (probes) {
+        zlistx_set_destructor (probes, (zlistx_destructor_fn *) zstr_free);
+        zlistx_set_duplicator (probes, (zlistx_duplicator_fn *) strdup);
+    }
+    for (int i = 0; probes && i < header.e_shnum; i++) {
+        char name [32];
+        if (sections [i].sh_type != SHT_NOTE
+        ||  sections [i].sh_name >= names->sh_size
+        ||  s_read_at (file, (long) (names->sh_offset + sections [i].sh_name), name, sizeof (name)) != 0
+        ||  strncmp (name, ".note.stapsdt", sizeof (name)) != 0)
+            continue;
+
+        char *notes = (char *) zmalloc (sections [i].sh_size + 1);
+        if (s_read_at (file, (long) sections [i].sh_offset, notes, sections [i].sh_size) == 0) {
+            // note: header, owner "stapsdt", three addresses, provider, name, arguments
+            size_t pos = 0;
+            while (pos + sizeof (ElfW(Nhdr)) <= sections [i].sh_size) {
+                ElfW(Nhdr) note;
+                memcpy (&note, notes + pos, sizeof (note));
+                size_t desc = pos + sizeof (note) + ((note.n_namesz + 3) & ~3u);
+                size_t next = desc + ((note.n_descsz + 3) & ~3u);
+                if (next > sections [i].sh_size)
+                    break;
+                if (note.n_type == STAPSDT_NOTE_TYPE && note.n_descsz > 3 * sizeof (ElfW(Addr))) {
+                    const char *provider = notes + desc + 3 * sizeof (ElfW(Addr));
+                    const char *end = notes + desc + note.n_descsz;
+                    size_t provider_len = strnlen (provider, (size_t) (end - provider));
+                    if (provider + provider_len < end) {
+                        const char *probe = provider + provider_len + 1;
+                        char *entry = zsys_sprintf ("%s:%.*s", provider, (int) strnlen (probe, (size_t) (end - probe)), probe);
+                        zlistx_add_end (probes, entry);
+                        zstr_free (&entry);
+                    }
+                }
+                pos = next;
+            }
+        }
+        free (notes);
+    }
+    free (sections);
+    fclose (file);
+    return probes;
+}
+
+//  --------------------------------------------------------------------------
+//  Return path of the binary this code is loaded from
+char *
+probe_binary_path (void)
+{
+    FILE *maps = fopen ("/proc/self/maps", "r");
+    if (!maps)
+        return NULL;
+
+    uintptr_t address = (uintptr_t) &probe_binary_path;
+    char *path = NULL;
+    char line [4096];
+    while (!path && fgets (line, sizeof (line), maps)) {
+        // start-end perms offset dev inode path
+        uintptr_t start, end;
+        int path_at = 0;
+        if (sscanf (line, "%" SCNxPTR "-%" SCNxPTR " %*s %*s %*s %*s %n", &start, &end, &path_at) < 2
+        ||  address < start || address >= end || path_at == 0 || line [path_at] != '/')
+            continue;
+        line [strcspn (line, "\n")] = '\0';
+        path = strdup (line + path_at);
+    }
+    fclose (maps);
+    return path;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+probe_test (bool verbose)
+{
+    ftylog_setInstance("probe_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * probe: \n");
+
+    //  @selftest
+    assert (probe_list ("src/does-not-exist") == NULL);
+    assert (probe_list ("/proc/self/maps") == NULL);
+
+    char *path = probe_binary_path ();
+    assert (path);
+    zlistx_t *probes = probe_list (path);
+    assert (probes);
+    log_info ("%s: %zu probes in %s", __func__, zlistx_size (probes), path);
+#ifdef FTY_OUTAGE_HAVE_PROBES
+    static const char *expected [] = {
+        "fty_outage:asset__add", "fty_outage:asset__delete", "fty_outage:asset__touch",
+        "fty_outage:sweep__start", "fty_outage:sweep__end",
+#ifdef FTY_OUTAGE_BUILD_DRAFT_API
+        "fty_outage:alert__send", "fty_outage:shm__scan__start", "fty_outage:shm__scan__end",
+#endif
+        NULL
+    };
+    zlistx_set_comparator (probes, (zlistx_comparator_fn *) strcmp);
+    for (const char **it = expected; *it; it++) {
+        if (verbose)
+            log_debug ("%s: looking for %s", __func__, *it);
+        assert (zlistx_find (probes, (void *) *it));
+    }
+#else
+    log_info ("%s: built without sys/sdt.h, no probes expected", __func__);
+#endif
+    zlistx_destroy (&probes);
+    zstr_free (&path);
+    //  @end
+    printf ("OK\n");
+}
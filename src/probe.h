@@ -0,0 +1,92 @@
+/*  =========================================================================
+    probe - USDT probes of hot paths
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef PROBE_H_INCLUDED
+#define PROBE_H_INCLUDED
+
+#include "../include/fty-outage.h"
+
+// Statically defined tracepoints (USDT) of provider fty_outage, for perf,
+// bpftrace or systemtap, e.g.
+//   bpftrace -e 'usdt:/usr/lib/libfty_outage.so:fty_outage:alert__send { printf ("%s %s\n", str (arg0), str (arg1)); }'
+// A probe is a single nop in the code, which a tracer replaces by a trap when
+// it attaches; arguments are values already at hand, so a probe costs nothing
+// noticeable. Probes are compiled in, if sys/sdt.h (systemtap-sdt-dev) is
+// available, unless FTY_OUTAGE_NO_PROBES is defined.
+//
+//   asset__add (char *name, char *subtype)         data_put, device announced
+//   asset__delete (char *name)                     data_delete, tracked asset forgotten
+//   asset__touch (char *name, uint64_t time_sec,   expiration_touch, metric seen
+//                 uint64_t ttl_sec, uint64_t now_sec)
+//   sweep__start (size_t assets)                   data_get_dead, dead devices check starts
+//   sweep__end (size_t assets, size_t dead)        data_get_dead, check ends
+//   alert__send (char *asset, char *state, int rv) s_osrv_send_alert, rv of mlm_client_send
+//   shm__scan__start ()                            outage_metric_polling, reading shm starts
+//   shm__scan__end (size_t metrics, uint64_t read_us)  reading shm ends
+
+#if !defined (FTY_OUTAGE_NO_PROBES) && defined (__has_include)
+#   if __has_include (<sys/sdt.h>)
+#       include <sys/sdt.h>
+#       define FTY_OUTAGE_HAVE_PROBES 1
+#   endif
+#endif
+
+#ifdef FTY_OUTAGE_HAVE_PROBES
+#   define FTY_OUTAGE_PROBE(name)                   DTRACE_PROBE (fty_outage, name)
+#   define FTY_OUTAGE_PROBE1(name, a)               DTRACE_PROBE1 (fty_outage, name, a)
+#   define FTY_OUTAGE_PROBE2(name, a, b)            DTRACE_PROBE2 (fty_outage, name, a, b)
+#   define FTY_OUTAGE_PROBE3(name, a, b, c)         DTRACE_PROBE3 (fty_outage, name, a, b, c)
+#   define FTY_OUTAGE_PROBE4(name, a, b, c, d)      DTRACE_PROBE4 (fty_outage, name, a, b, c, d)
+#else
+#   define FTY_OUTAGE_PROBE(name)
+#   define FTY_OUTAGE_PROBE1(name, a)
+#   define FTY_OUTAGE_PROBE2(name, a, b)
+#   define FTY_OUTAGE_PROBE3(name, a, b, c)
+#   define FTY_OUTAGE_PROBE4(name, a, b, c, d)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Return list of probes ("provider:name") found in ELF file at path,
+//  empty list if it has none, NULL if it is not readable ELF file of this
+//  architecture; caller must destroy it
+FTY_OUTAGE_EXPORT zlistx_t *
+    probe_list (const char *path);
+
+//  Return path of the binary (library or program) this code is loaded from,
+//  NULL if not found; caller must free it
+FTY_OUTAGE_EXPORT char *
+    probe_binary_path (void);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    probe_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
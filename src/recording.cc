@@ -0,0 +1,334 @@
+/*  =========================================================================
+    recording - Recording of agent inputs for offline replay
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    recording - Recording of agent inputs for offline replay
+@discuss
+    When enabled, the agent appends everything it reacts on (stream messages,
+    mailbox requests and metrics read from shm) together with alerts it
+    publishes to a recording file. Each record carries the time it was
+    received and its own checksum. The recording is fed back to the agent by
+    fty_outage_bench --replay, which compares the published alerts with the
+    recorded ones.
+@end
+*/
+
+#include "fty_outage_classes.h"
+
+static uint32_t
+s_record_checksum (const recording_record_t *record, const char *frames)
+{
+    uint64_t hash = STATE_FNV_OFFSET_BASIS;
+    hash = state_fnv1a (hash, &record->size, sizeof (recording_record_t) - sizeof (record->checksum));
+    hash = state_fnv1a (hash, frames, record->size);
+    return (uint32_t) hash;
+}
+
+// read records of recording file, return number of records read or -1
+// offset_p is set to the end of the last good record
+static int
+s_recording_scan (const char *path, recording_read_fn *read_fn, void *arg, uint64_t *offset_p)
+{
+    FILE *f = fopen (path, "rb");
+    if (!f) {
+        log_error ("Can't read recording %s: %m", path);
+        return -1;
+    }
+
+    char magic [sizeof (RECORDING_MAGIC) - 1];
+    if (fread (magic, sizeof (magic), 1, f) != 1
+    ||  memcmp (magic, RECORDING_MAGIC, sizeof (magic)) != 0) {
+        log_error ("File %s is not a recording", path);
+        fclose (f);
+        return -1;
+    }
+
+    int count = 0;
+    uint64_t offset = sizeof (magic);
+    char *frames = NULL;
+    size_t frames_alloc = 0;
+    recording_record_t record;
+    while (fread (&record, sizeof (record), 1, f) == 1) {
+        if (record.size > RECORDING_MAX_SIZE)
+            break;
+        if (record.size > frames_alloc) {
+            char *p = (char *) realloc (frames, record.size);
+            if (!p)
+                break;
+            frames = p;
+            frames_alloc = record.size;
+        }
+        if ((record.size > 0 && fread (frames, record.size, 1, f) != 1)
+        ||  s_record_checksum (&record, frames) != record.checksum)
+            break;
+
+        if (read_fn) {
+            zmsg_t *msg = zmsg_new ();
+            size_t pos = 0;
+            while (pos + sizeof (uint32_t) <= record.size) {
+                uint32_t size;
+                memcpy (&size, frames + pos, sizeof (size));
+                pos += sizeof (size);
+                if (size > record.size - pos)
+                    break;
+                zmsg_addmem (msg, frames + pos, size);
+                pos += size;
+            }
+            read_fn (record.type, record.time_ms, msg, arg);
+            zmsg_destroy (&msg);
+        }
+        offset += sizeof (record) + record.size;
+        count++;
+    }
+    free (frames);
+    fclose (f);
+    *offset_p = offset;
+    return count;
+}
+
+//  --------------------------------------------------------------------------
+//  Open recording for appending
+recording_t *
+recording_new (const char *path)
+{
+    assert (path);
+
+    recording_t *self = (recording_t *) zmalloc (sizeof (recording_t));
+    if (!self)
+        return NULL;
+
+    // records after a damaged tail would not be readable
+    uint64_t offset = 0;
+    if (zsys_file_exists (path)
+    &&  (s_recording_scan (path, NULL, NULL, &offset) == -1
+    ||   truncate (path, (off_t) offset) != 0)) {
+        log_error ("Can't append to recording %s", path);
+        free (self);
+        return NULL;
+    }
+
+    self->file = fopen (path, "ab");
+    if (!self->file) {
+        log_error ("Can't open recording %s: %m", path);
+        free (self);
+        return NULL;
+    }
+    if (offset == 0) {
+        fwrite (RECORDING_MAGIC, sizeof (RECORDING_MAGIC) - 1, 1, self->file);
+        offset = sizeof (RECORDING_MAGIC) - 1;
+    }
+    self->size = offset;
+    self->path = strdup (path);
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Flush records and close the recording
+void
+recording_destroy (recording_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        recording_t *self = *self_p;
+        if (fclose (self->file) != 0)
+            log_error ("Can't write recording %s: %m", self->path);
+        log_info ("Recording %s closed, %" PRIu64 " records written", self->path, self->records);
+        zstr_free (&self->path);
+        free (self->buffer);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Append record of all frames of msg
+int
+recording_write (recording_t *self, uint8_t type, int64_t time_ms, zmsg_t *msg)
+{
+    assert (self);
+    assert (msg);
+
+    if (self->full)
+        return -1;
+
+    size_t size = 0;
+    for (zframe_t *frame = zmsg_first (msg); frame; frame = zmsg_next (msg))
+        size += sizeof (uint32_t) + zframe_size (frame);
+    if (self->size + sizeof (recording_record_t) + size > RECORDING_MAX_SIZE) {
+        log_warning ("Recording %s is full, recording stopped", self->path);
+        self->full = true;
+        return -1;
+    }
+    if (size > self->buffer_alloc) {
+        size_t alloc = self->buffer_alloc ? self->buffer_alloc * 2 : 16384;
+        while (alloc < size)
+            alloc *= 2;
+        char *buffer = (char *) realloc (self->buffer, alloc);
+        if (!buffer)
+            return -1;
+        self->buffer = buffer;
+        self->buffer_alloc = alloc;
+    }
+
+    char *p = self->buffer;
+    for (zframe_t *frame = zmsg_first (msg); frame; frame = zmsg_next (msg)) {
+        uint32_t frame_size = (uint32_t) zframe_size (frame);
+        memcpy (p, &frame_size, sizeof (frame_size));
+        memcpy (p + sizeof (frame_size), zframe_data (frame), frame_size);
+        p += sizeof (frame_size) + frame_size;
+    }
+
+    recording_record_t record;
+    memset (&record, 0, sizeof (record));
+    record.size = (uint32_t) size;
+    record.type = type;
+    record.time_ms = time_ms;
+    record.checksum = s_record_checksum (&record, self->buffer);
+
+    if (fwrite (&record, sizeof (record), 1, self->file) != 1
+    ||  (size > 0 && fwrite (self->buffer, size, 1, self->file) != 1)) {
+        log_error ("Can't write recording %s: %m", self->path);
+        return -1;
+    }
+    self->size += sizeof (record) + size;
+    self->records++;
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Return size of the recording in bytes
+uint64_t
+recording_size (recording_t *self)
+{
+    assert (self);
+    return self->size;
+}
+
+//  --------------------------------------------------------------------------
+//  Call read_fn for each record of recording file in order
+int
+recording_read (const char *path, recording_read_fn *read_fn, void *arg)
+{
+    assert (path);
+    assert (read_fn);
+
+    uint64_t offset = 0;
+    return s_recording_scan (path, read_fn, arg, &offset);
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+typedef struct {
+    int count;
+    uint8_t types [8];
+    int64_t times [8];
+    char frames [8][64];
+} test_read_t;
+
+static void
+s_test_read (uint8_t type, int64_t time_ms, zmsg_t *msg, void *arg)
+{
+    test_read_t *read = (test_read_t *) arg;
+    assert (read->count < 8);
+    read->types [read->count] = type;
+    read->times [read->count] = time_ms;
+    // frames joined with '|'
+    char *p = read->frames [read->count];
+    *p = '\0';
+    for (zframe_t *frame = zmsg_first (msg); frame; frame = zmsg_next (msg)) {
+        size_t used = strlen (read->frames [read->count]);
+        snprintf (p + used, 64 - used, "%s%.*s", used ? "|" : "", (int) zframe_size (frame), (char *) zframe_data (frame));
+    }
+    read->count++;
+}
+
+void
+recording_test (bool verbose)
+{
+    ftylog_setInstance("recording_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * recording: \n");
+
+    //  @selftest
+    const char *path = "src/recording_test.rec";
+    unlink (path);
+
+    recording_t *recording = recording_new (path);
+    assert (recording);
+    assert (recording_size (recording) == sizeof (RECORDING_MAGIC) - 1);
+    zmsg_t *msg = zmsg_new ();
+    zmsg_addstr (msg, "METRICS_SENSOR");
+    zmsg_addstr (msg, "agent-sensor");
+    zmsg_addstr (msg, "temperature@ups-1");
+    zmsg_addmem (msg, NULL, 0);
+    assert (recording_write (recording, RECORDING_STREAM, 1000, msg) == 0);
+    assert (zmsg_size (msg) == 4);
+    zmsg_destroy (&msg);
+    msg = zmsg_new ();
+    zmsg_addstr (msg, "ups-1");
+    zmsg_addstr (msg, "ACTIVE");
+    assert (recording_write (recording, RECORDING_ALERT, 1001, msg) == 0);
+    zmsg_destroy (&msg);
+    recording_destroy (&recording);
+
+    test_read_t read;
+    memset (&read, 0, sizeof (read));
+    assert (recording_read (path, s_test_read, &read) == 2);
+    assert (read.types [0] == RECORDING_STREAM && read.times [0] == 1000);
+    assert (streq (read.frames [0], "METRICS_SENSOR|agent-sensor|temperature@ups-1|"));
+    assert (read.types [1] == RECORDING_ALERT && read.times [1] == 1001);
+    assert (streq (read.frames [1], "ups-1|ACTIVE"));
+
+    // damaged tail is ignored and cut off when recording continues
+    FILE *f = fopen (path, "ab");
+    assert (f);
+    fputs ("garbage of killed agent", f);
+    fclose (f);
+    memset (&read, 0, sizeof (read));
+    assert (recording_read (path, s_test_read, &read) == 2);
+    recording = recording_new (path);
+    assert (recording);
+    msg = zmsg_new ();
+    zmsg_addstr (msg, "ups-1");
+    zmsg_addstr (msg, "RESOLVED");
+    assert (recording_write (recording, RECORDING_ALERT, 1002, msg) == 0);
+    zmsg_destroy (&msg);
+    recording_destroy (&recording);
+    memset (&read, 0, sizeof (read));
+    assert (recording_read (path, s_test_read, &read) == 3);
+    assert (streq (read.frames [2], "ups-1|RESOLVED"));
+
+    // not a recording
+    f = fopen (path, "wb");
+    assert (f);
+    fputs ("something else", f);
+    fclose (f);
+    assert (recording_read (path, s_test_read, &read) == -1);
+    assert (recording_new (path) == NULL);
+    unlink (path);
+    //  @end
+    printf ("OK\n");
+}
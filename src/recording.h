@@ -0,0 +1,107 @@
+/*  =========================================================================
+    recording - Recording of agent inputs for offline replay
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef RECORDING_H_INCLUDED
+#define RECORDING_H_INCLUDED
+
+#include "../include/fty-outage.h"
+
+// recorded inputs and outputs of the agent
+#define RECORDING_STREAM    1   // stream message: stream, sender, subject, message frames
+#define RECORDING_MAILBOX   2   // mailbox request: sender, subject, message frames
+#define RECORDING_METRICS   3   // metrics read from shm, frame per metric: time, ttl, name[, port, sname]
+#define RECORDING_ALERT     4   // alert published: asset, state
+
+// recording stops, when the file grows over this size
+#define RECORDING_MAX_SIZE  256*1024*1024
+
+// first bytes of recording file
+#define RECORDING_MAGIC     "FTYOREC2"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// record on disk (native byte order), followed by frames, each of them as
+// uint32_t size and data
+typedef struct _recording_record_t {
+    uint32_t checksum;              // FNV-1a (lower half) of the rest of record and frames
+    uint32_t size;                  // [B] of frames
+    uint8_t type;                   // RECORDING_*
+    uint8_t reserved [7];
+    int64_t time_ms;                // vclock_time when recorded
+} recording_record_t;
+
+//  Structure of our class
+struct _recording_t {
+    char *path;                     // recording file
+    FILE *file;                     // opened for append
+    uint64_t size;                  // [B] of the recording
+    uint64_t records;               // records written by this instance
+    bool full;                      // RECORDING_MAX_SIZE reached
+    char *buffer;                   // record being encoded
+    size_t buffer_alloc;            // [B] allocated
+};
+
+#ifndef RECORDING_T_DEFINED
+typedef struct _recording_t recording_t;
+#define RECORDING_T_DEFINED
+#endif
+
+// callback for recording_read, msg is destroyed after the call
+typedef void (recording_read_fn) (uint8_t type, int64_t time_ms, zmsg_t *msg, void *arg);
+
+//  @interface
+//  Open recording for appending, file is created if missing
+//  return NULL on error
+FTY_OUTAGE_EXPORT recording_t *
+    recording_new (const char *path);
+
+//  Flush records and close the recording
+FTY_OUTAGE_EXPORT void
+    recording_destroy (recording_t **self_p);
+
+//  Append record of all frames of msg, msg is not changed
+//  return -1 on error or when the recording is full, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    recording_write (recording_t *self, uint8_t type, int64_t time_ms, zmsg_t *msg);
+
+//  Return size of the recording in bytes
+FTY_OUTAGE_EXPORT uint64_t
+    recording_size (recording_t *self);
+
+//  Call read_fn for each record of recording file in order, damaged tail
+//  (agent killed while recording) is ignored
+//  return number of records read, -1 on error
+FTY_OUTAGE_EXPORT int
+    recording_read (const char *path, recording_read_fn *read_fn, void *arg);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    recording_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
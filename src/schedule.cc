@@ -0,0 +1,394 @@
+/*  =========================================================================
+    schedule - Recurring maintenance windows
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    schedule - Recurring maintenance windows
+@discuss
+    Schedule opens a maintenance window of duration_sec at start_sec and
+    then each period_sec, for assets chosen by a selector. Start of the next
+    window of every schedule is precomputed into a deadline index, so only
+    schedules with an open window are touched. End of the window needs no
+    timer of its own, it is the end of maintenance of the selected assets.
+@end
+*/
+
+#include "fty_outage_classes.h"
+
+static void
+s_schedule_entry_destroy (schedule_entry_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        schedule_entry_t *self = *self_p;
+        zstr_free (&self->id);
+        zstr_free (&self->selector);
+        zlistx_destroy (&self->arguments);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+// return start of the window open at now_sec, or of the next one
+static uint64_t
+s_schedule_window (schedule_entry_t *entry, uint64_t now_sec)
+{
+    if (now_sec < entry->start_sec)
+        return entry->start_sec;
+    uint64_t window_sec = entry->start_sec
+        + (now_sec - entry->start_sec) / entry->period_sec * entry->period_sec;
+    if (now_sec < window_sec + entry->duration_sec)
+        return window_sec;
+    return window_sec + entry->period_sec;
+}
+
+//  --------------------------------------------------------------------------
+//  Create a new empty set of schedules
+schedule_t *
+schedule_new (void)
+{
+    schedule_t *self = (schedule_t *) zmalloc (sizeof (schedule_t));
+    if (self) {
+        self->entries = zhashx_new ();
+        if (self->entries) {
+            zhashx_set_destructor (self->entries, (zhashx_destructor_fn *) s_schedule_entry_destroy);
+            self->transitions = deadline_new ();
+        }
+        if (!self->transitions)
+            schedule_destroy (&self);
+    }
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the schedules
+void
+schedule_destroy (schedule_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        schedule_t *self = *self_p;
+        zhashx_destroy (&self->entries);
+        deadline_destroy (&self->transitions);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Add or replace schedule
+int
+schedule_add (schedule_t *self, const char *id, uint64_t start_sec, uint64_t period_sec,
+              uint64_t duration_sec, const char *selector, zlistx_t *arguments, uint64_t now_sec)
+{
+    assert (self);
+    assert (id);
+    assert (selector);
+
+    if (period_sec == 0 || duration_sec == 0 || duration_sec > period_sec)
+        return -1;
+
+    schedule_entry_t *entry = (schedule_entry_t *) zmalloc (sizeof (schedule_entry_t));
+    if (!entry)
+        return -1;
+    entry->id = strdup (id);
+    entry->selector = strdup (selector);
+    entry->arguments = zlistx_new ();
+    if (!entry->id || !entry->selector || !entry->arguments) {
+        s_schedule_entry_destroy (&entry);
+        return -1;
+    }
+    zlistx_set_duplicator (entry->arguments, (zlistx_duplicator_fn *) strdup);
+    zlistx_set_destructor (entry->arguments, (zlistx_destructor_fn *) zstr_free);
+    for (void *it = arguments ? zlistx_first (arguments) : NULL;
+               it != NULL;
+               it = zlistx_next (arguments))
+        zlistx_add_end (entry->arguments, it);
+    entry->start_sec = start_sec;
+    entry->period_sec = period_sec;
+    entry->duration_sec = duration_sec;
+    entry->next_sec = s_schedule_window (entry, now_sec);
+
+    // index entry of replaced schedule becomes stale, unless it has the same time
+    zhashx_update (self->entries, id, entry);
+    return deadline_push (self->transitions, id, entry->next_sec);
+}
+
+//  --------------------------------------------------------------------------
+//  Remove schedule
+int
+schedule_delete (schedule_t *self, const char *id)
+{
+    assert (self);
+    assert (id);
+
+    if (!zhashx_lookup (self->entries, id))
+        return -1;
+    // index entry is stale now
+    zhashx_delete (self->entries, id);
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Return schedule 'id' or NULL
+schedule_entry_t *
+schedule_lookup (schedule_t *self, const char *id)
+{
+    assert (self);
+    assert (id);
+    return (schedule_entry_t *) zhashx_lookup (self->entries, id);
+}
+
+//  --------------------------------------------------------------------------
+//  Return number of schedules
+size_t
+schedule_size (schedule_t *self)
+{
+    assert (self);
+    return zhashx_size (self->entries);
+}
+
+//  --------------------------------------------------------------------------
+//  Return the earliest start of a window
+uint64_t
+schedule_next (schedule_t *self)
+{
+    assert (self);
+    return deadline_next (self->transitions);
+}
+
+//  --------------------------------------------------------------------------
+//  Return schedule, whose window is open
+schedule_entry_t *
+schedule_pop (schedule_t *self, uint64_t now_sec, uint64_t *window_end_sec)
+{
+    assert (self);
+
+    uint64_t time_sec;
+    char *id;
+    while ((id = deadline_pop (self->transitions, now_sec, &time_sec)) != NULL) {
+        schedule_entry_t *entry = (schedule_entry_t *) zhashx_lookup (self->entries, id);
+        zstr_free (&id);
+        // deleted or replaced schedule
+        if (!entry || entry->next_sec != time_sec)
+            continue;
+
+        uint64_t end_sec = time_sec + entry->duration_sec;
+        entry->next_sec = end_sec > now_sec ? time_sec + entry->period_sec : s_schedule_window (entry, now_sec);
+        if (deadline_push (self->transitions, entry->id, entry->next_sec) != 0)
+            log_error ("Can't index next window of schedule '%s' (memory error)", entry->id);
+        if (end_sec > now_sec) {
+            if (window_end_sec)
+                *window_end_sec = end_sec;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+//  --------------------------------------------------------------------------
+//  Save schedules to a file
+int
+schedule_save (schedule_t *self, const char *path)
+{
+    assert (self);
+    assert (path);
+
+    zconfig_t *root = zconfig_new ("root", NULL);
+    zconfig_t *schedules = zconfig_new ("schedule", root);
+    size_t index = 0;
+    for (schedule_entry_t *entry = (schedule_entry_t *) zhashx_first (self->entries);
+                           entry != NULL;
+                           entry = (schedule_entry_t *) zhashx_next (self->entries))
+    {
+        char name [32];
+        snprintf (name, sizeof (name), "%zu", ++index);
+        zconfig_t *item = zconfig_new (name, schedules);
+        zconfig_put (item, "id", entry->id);
+        zconfig_putf (item, "start", "%" PRIu64, entry->start_sec);
+        zconfig_putf (item, "period", "%" PRIu64, entry->period_sec);
+        zconfig_putf (item, "duration", "%" PRIu64, entry->duration_sec);
+        zconfig_put (item, "selector", entry->selector);
+        zconfig_t *arguments = zconfig_new ("arguments", item);
+        size_t arg_index = 0;
+        for (void *it = zlistx_first (entry->arguments);
+                   it != NULL;
+                   it = zlistx_next (entry->arguments))
+        {
+            snprintf (name, sizeof (name), "%zu", ++arg_index);
+            zconfig_t *argument = zconfig_new (name, arguments);
+            zconfig_set_value (argument, "%s", (const char *) it);
+        }
+    }
+
+    char *tmp_path = zsys_sprintf ("%s.tmp", path);
+    int rv = zconfig_save (root, tmp_path);
+    if (rv == 0)
+        rv = rename (tmp_path, path);
+    if (rv != 0) {
+        log_error ("Can't write schedules to %s: %m", path);
+        unlink (tmp_path);
+    }
+    zstr_free (&tmp_path);
+    zconfig_destroy (&root);
+    return rv;
+}
+
+//  --------------------------------------------------------------------------
+//  Add schedules saved in a file
+int
+schedule_load (schedule_t *self, const char *path, uint64_t now_sec)
+{
+    assert (self);
+    assert (path);
+
+    zconfig_t *root = zconfig_load (path);
+    if (!root)
+        return -1;
+
+    int count = 0;
+    zconfig_t *schedules = zconfig_locate (root, "schedule");
+    for (zconfig_t *item = schedules ? zconfig_child (schedules) : NULL;
+                    item != NULL;
+                    item = zconfig_next (item))
+    {
+        const char *id = zconfig_get (item, "id", NULL);
+        const char *selector = zconfig_get (item, "selector", NULL);
+        if (!id || !selector)
+            continue;
+        zlistx_t *arguments = zlistx_new ();
+        zconfig_t *args = zconfig_locate (item, "arguments");
+        for (zconfig_t *arg = args ? zconfig_child (args) : NULL;
+                        arg != NULL;
+                        arg = zconfig_next (arg))
+            zlistx_add_end (arguments, zconfig_value (arg));
+        int rv = schedule_add (self, id,
+                               strtoull (zconfig_get (item, "start", "0"), NULL, 10),
+                               strtoull (zconfig_get (item, "period", "0"), NULL, 10),
+                               strtoull (zconfig_get (item, "duration", "0"), NULL, 10),
+                               selector, arguments, now_sec);
+        zlistx_destroy (&arguments);
+        if (rv == 0)
+            count++;
+        else
+            log_error ("Invalid schedule '%s' in %s", id, path);
+    }
+    zconfig_destroy (&root);
+    return count;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+schedule_test (bool verbose)
+{
+    ftylog_setInstance("schedule_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * schedule: \n");
+
+    //  @selftest
+    const char *path = "src/schedule_test.cfg";
+    uint64_t window_end_sec = 0;
+
+    schedule_t *schedule = schedule_new ();
+    assert (schedule);
+    assert (schedule_size (schedule) == 0);
+    assert (schedule_next (schedule) == 0);
+    assert (schedule_pop (schedule, 1000, NULL) == NULL);
+
+    // invalid windows
+    assert (schedule_add (schedule, "bad", 100, 0, 10, "ASSETS", NULL, 0) == -1);
+    assert (schedule_add (schedule, "bad", 100, 60, 0, "ASSETS", NULL, 0) == -1);
+    assert (schedule_add (schedule, "bad", 100, 60, 61, "ASSETS", NULL, 0) == -1);
+    assert (schedule_size (schedule) == 0);
+
+    // windows [1000, 1100), [2000, 2100), ...
+    zlistx_t *arguments = zlistx_new ();
+    zlistx_add_end (arguments, (void *) "ups-1");
+    zlistx_add_end (arguments, (void *) "ups-2");
+    assert (schedule_add (schedule, "firmware", 1000, 1000, 100, "ASSETS", arguments, 500) == 0);
+    zlistx_destroy (&arguments);
+    assert (schedule_size (schedule) == 1);
+    assert (schedule_next (schedule) == 1000);
+    assert (schedule_pop (schedule, 999, &window_end_sec) == NULL);
+
+    schedule_entry_t *entry = schedule_pop (schedule, 1010, &window_end_sec);
+    assert (entry && streq (entry->id, "firmware") && window_end_sec == 1100);
+    assert (zlistx_size (entry->arguments) == 2);
+    assert (streq ((const char *) zlistx_first (entry->arguments), "ups-1"));
+    // window is returned once
+    assert (schedule_pop (schedule, 1050, &window_end_sec) == NULL);
+    assert (schedule_next (schedule) == 2000);
+
+    // missed windows are skipped, the open one is returned
+    entry = schedule_pop (schedule, 5050, &window_end_sec);
+    assert (entry && window_end_sec == 5100);
+    assert (schedule_next (schedule) == 6000);
+    // missed window, none is open
+    assert (schedule_pop (schedule, 7500, &window_end_sec) == NULL);
+    assert (schedule_next (schedule) == 8000);
+
+    // added in the middle of the window, it is open right away
+    assert (schedule_add (schedule, "daily", 0, 86400, 3600, "SUBTYPE", NULL, 86400 + 1800) == 0);
+    entry = schedule_pop (schedule, 86400 + 1800, &window_end_sec);
+    assert (entry && streq (entry->id, "daily") && window_end_sec == 86400 + 3600);
+
+    // replaced and deleted schedules leave stale index entries behind
+    assert (schedule_add (schedule, "firmware", 9500, 1000, 100, "ASSETS", NULL, 8000) == 0);
+    entry = schedule_pop (schedule, 9000, &window_end_sec);
+    assert (entry == NULL);
+    entry = schedule_pop (schedule, 9500, &window_end_sec);
+    assert (entry && streq (entry->id, "firmware") && window_end_sec == 9600);
+    assert (schedule_delete (schedule, "firmware") == 0);
+    assert (schedule_delete (schedule, "firmware") == -1);
+    assert (schedule_pop (schedule, 10500, &window_end_sec) == NULL);
+    assert (schedule_lookup (schedule, "firmware") == NULL);
+
+    // save/load round trip
+    arguments = zlistx_new ();
+    zlistx_add_end (arguments, (void *) "^epdu-[0-9]+$");
+    assert (schedule_add (schedule, "weekly", 0, 7 * 86400, 7200, "REGEX", arguments, 0) == 0);
+    zlistx_destroy (&arguments);
+    assert (schedule_save (schedule, path) == 0);
+    schedule_destroy (&schedule);
+
+    schedule = schedule_new ();
+    assert (schedule_load (schedule, path, 7 * 86400 + 60) == 2);
+    entry = schedule_lookup (schedule, "weekly");
+    assert (entry && entry->period_sec == 7 * 86400 && entry->duration_sec == 7200);
+    assert (streq (entry->selector, "REGEX"));
+    assert (streq ((const char *) zlistx_first (entry->arguments), "^epdu-[0-9]+$"));
+    // loaded in the middle of the window
+    assert (entry->next_sec == 7 * 86400);
+    assert (schedule_lookup (schedule, "daily"));
+    schedule_destroy (&schedule);
+    unlink (path);
+
+    schedule = schedule_new ();
+    assert (schedule_load (schedule, path, 0) == -1);
+    schedule_destroy (&schedule);
+    //  @end
+    printf ("OK\n");
+}
@@ -0,0 +1,112 @@
+/*  =========================================================================
+    schedule - Recurring maintenance windows
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef SCHEDULE_H_INCLUDED
+#define SCHEDULE_H_INCLUDED
+
+#include "../include/fty-outage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _schedule_entry_t {
+    char *id;                       // name of the schedule, given by user
+    uint64_t start_sec;             // [s] start of the first window
+    uint64_t period_sec;            // [s] windows start each period
+    uint64_t duration_sec;          // [s] length of the window
+    char *selector;                 // ASSETS, REGEX, SUBTYPE or PARENT
+    zlistx_t *arguments;            // arguments of the selector
+    uint64_t next_sec;              // [s] start of the next window, as pushed to transitions
+} schedule_entry_t;
+
+//  Structure of our class
+struct _schedule_t {
+    zhashx_t *entries;              // id => schedule_entry_t
+    deadline_t *transitions;        // starts of the next windows, keyed by id
+};
+
+#ifndef SCHEDULE_T_DEFINED
+typedef struct _schedule_t schedule_t;
+#define SCHEDULE_T_DEFINED
+#endif
+
+//  @interface
+//  Create a new empty set of schedules
+FTY_OUTAGE_EXPORT schedule_t *
+    schedule_new (void);
+
+//  Destroy the schedules
+FTY_OUTAGE_EXPORT void
+    schedule_destroy (schedule_t **self_p);
+
+//  Add or replace schedule 'id', windows of duration_sec start at start_sec
+//  and then each period_sec. Arguments are copied.
+//  return -1 if period or duration is invalid or on memory error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    schedule_add (schedule_t *self, const char *id, uint64_t start_sec, uint64_t period_sec,
+                  uint64_t duration_sec, const char *selector, zlistx_t *arguments, uint64_t now_sec);
+
+//  Remove schedule 'id'
+//  return -1 if there is no such schedule, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    schedule_delete (schedule_t *self, const char *id);
+
+//  Return schedule 'id' or NULL
+FTY_OUTAGE_EXPORT schedule_entry_t *
+    schedule_lookup (schedule_t *self, const char *id);
+
+//  Return number of schedules
+FTY_OUTAGE_EXPORT size_t
+    schedule_size (schedule_t *self);
+
+//  Return the earliest start of a window, 0 if there are no schedules
+FTY_OUTAGE_EXPORT uint64_t
+    schedule_next (schedule_t *self);
+
+//  Return schedule, whose window is open at now_sec and was not returned yet,
+//  and set window_end_sec to the end of that window. Start of its next window
+//  is computed and indexed. Windows, which were missed completely, are skipped.
+//  return NULL if no window opens
+FTY_OUTAGE_EXPORT schedule_entry_t *
+    schedule_pop (schedule_t *self, uint64_t now_sec, uint64_t *window_end_sec);
+
+//  Save schedules to a file
+//  return -1 on error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    schedule_save (schedule_t *self, const char *path);
+
+//  Add schedules saved in a file
+//  return -1 if file can't be loaded, number of schedules otherwise
+FTY_OUTAGE_EXPORT int
+    schedule_load (schedule_t *self, const char *path, uint64_t now_sec);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    schedule_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
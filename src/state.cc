@@ -0,0 +1,596 @@
+/*  =========================================================================
+    state - Binary snapshot of outage state
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    state - Binary snapshot of outage state
+@discuss
+    Snapshot is a header, an array of fixed size records and an area of
+    zero terminated asset names. It is written to a temporary file, which
+    then atomically replaces the previous snapshot, and it is loaded by
+    mapping the file to memory, so records are used in place.
+
+    State writer actor saves states (and asset catalogs) built by its
+    caller, so a snapshot can be taken quickly in memory and written while
+    the caller goes on.
+@end
+*/
+
+#include "fty_outage_classes.h"
+#include <stddef.h>
+#include <sys/mman.h>
+
+#define FNV_PRIME 1099511628211ULL
+
+//  --------------------------------------------------------------------------
+//  Update FNV-1a hash with data
+uint64_t
+state_fnv1a (uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char *) data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p [i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// checksum of the header with zero checksum field, records and strings;
+// version 1 files covered records and strings only
+static uint64_t
+s_state_checksum (state_t *self)
+{
+    uint64_t hash = STATE_FNV_OFFSET_BASIS;
+    if (self->header->version != STATE_VERSION_1) {
+        state_header_t header = *self->header;
+        header.checksum = 0;
+        hash = state_fnv1a (hash, &header, sizeof (header));
+    }
+    hash = state_fnv1a (hash, self->records, self->header->count * sizeof (state_record_t));
+    hash = state_fnv1a (hash, self->strings, self->header->strings_size);
+    return hash;
+}
+
+// write whole buffer, return -1 on error
+static int
+s_write_all (int fd, const void *data, size_t size)
+{
+    const char *p = (const char *) data;
+    while (size > 0) {
+        ssize_t n = write (fd, p, size);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        size -= (size_t) n;
+    }
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Create a new empty state
+state_t *
+state_new (uint64_t time_sec)
+{
+    state_t *self = (state_t *) zmalloc (sizeof (state_t));
+    if (self) {
+        self->header = (state_header_t *) zmalloc (sizeof (state_header_t));
+        if (!self->header) {
+            free (self);
+            return NULL;
+        }
+        memcpy (self->header->magic, STATE_MAGIC, sizeof (self->header->magic));
+        self->header->version = STATE_VERSION;
+        self->header->time_sec = time_sec;
+    }
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the state
+void
+state_destroy (state_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        state_t *self = *self_p;
+        if (self->map)
+            munmap (self->map, self->map_size);
+        else {
+            free (self->header);
+            free (self->records);
+            free (self->strings);
+        }
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Append record for an asset
+int
+state_add (state_t *self, const char *asset_name, uint32_t flags,
+           uint64_t last_time_seen_sec, uint64_t ttl_sec, uint64_t maintenance_until_sec)
+{
+    assert (self);
+    assert (asset_name);
+    assert (!self->map);
+
+    state_header_t *header = self->header;
+    if (header->count == self->records_alloc) {
+        size_t alloc = self->records_alloc ? self->records_alloc * 2 : 256;
+        state_record_t *records = (state_record_t *) realloc (self->records, alloc * sizeof (state_record_t));
+        if (!records)
+            return -1;
+        self->records = records;
+        self->records_alloc = alloc;
+    }
+
+    size_t length = strlen (asset_name) + 1;
+    if (header->strings_size + length > self->strings_alloc) {
+        size_t alloc = self->strings_alloc ? self->strings_alloc * 2 : 4096;
+        while (alloc < header->strings_size + length)
+            alloc *= 2;
+        char *strings = (char *) realloc (self->strings, alloc);
+        if (!strings)
+            return -1;
+        self->strings = strings;
+        self->strings_alloc = alloc;
+    }
+
+    state_record_t *record = &self->records [header->count++];
+    memset (record, 0, sizeof (state_record_t));
+    record->name_offset = (uint32_t) header->strings_size;
+    record->flags = flags;
+    record->last_time_seen_sec = last_time_seen_sec;
+    record->ttl_sec = ttl_sec;
+    record->maintenance_until_sec = maintenance_until_sec;
+
+    memcpy (self->strings + header->strings_size, asset_name, length);
+    header->strings_size += length;
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Write parts to a temporary file, which atomically replaces path
+int
+state_write_file (const char *path, const struct iovec *parts, int count)
+{
+    assert (path);
+    assert (parts || count == 0);
+
+    char *tmp_path = zsys_sprintf ("%s.tmp", path);
+    int fd = open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        log_error ("Can't create %s: %m", tmp_path);
+        zstr_free (&tmp_path);
+        return -1;
+    }
+
+    int rv = 0;
+    for (int i = 0; rv == 0 && i < count; i++)
+        rv = s_write_all (fd, parts [i].iov_base, parts [i].iov_len);
+    if (rv == 0)
+        rv = fsync (fd);
+    if (close (fd) != 0)
+        rv = -1;
+
+    if (rv == 0)
+        rv = rename (tmp_path, path);
+    if (rv != 0) {
+        log_error ("Can't write %s: %m", path);
+        unlink (tmp_path);
+    }
+    zstr_free (&tmp_path);
+    if (rv != 0)
+        return rv;
+
+    // rename is durable only once the directory is synced
+    const char *slash = strrchr (path, '/');
+    char *dir_path = slash
+        ? zsys_sprintf ("%.*s", (int) (slash == path ? 1 : slash - path), path)
+        : strdup (".");
+    int dir_fd = open (dir_path, O_RDONLY | O_DIRECTORY);
+    if (dir_fd == -1 || fsync (dir_fd) != 0) {
+        log_error ("Can't sync directory %s: %m", dir_path);
+        rv = -1;
+    }
+    if (dir_fd != -1)
+        close (dir_fd);
+    zstr_free (&dir_path);
+    return rv;
+}
+
+//  --------------------------------------------------------------------------
+//  Write the state to a file
+int
+state_save (state_t *self, const char *path)
+{
+    assert (self);
+    assert (path);
+
+    self->header->checksum = s_state_checksum (self);
+
+    struct iovec parts [] = {
+        { self->header, sizeof (state_header_t) },
+        { self->records, self->header->count * sizeof (state_record_t) },
+        { self->strings, self->header->strings_size }
+    };
+    return state_write_file (path, parts, 3);
+}
+
+//  --------------------------------------------------------------------------
+//  Map the state file into memory
+state_t *
+state_load (const char *path)
+{
+    assert (path);
+
+    int fd = open (path, O_RDONLY);
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+    if (fstat (fd, &st) != 0 || (size_t) st.st_size < offsetof (state_header_t, time_sec)) {
+        log_error ("State file %s is too short", path);
+        close (fd);
+        return NULL;
+    }
+
+    size_t map_size = (size_t) st.st_size;
+    void *map = mmap (NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        log_error ("Can't map state file %s: %m", path);
+        return NULL;
+    }
+
+    // fields of version 1 header are a prefix of the current one
+    state_header_t *header = (state_header_t *) map;
+    size_t header_size = header->version == STATE_VERSION_1
+        ? offsetof (state_header_t, time_sec)
+        : sizeof (state_header_t);
+    if (memcmp (header->magic, STATE_MAGIC, sizeof (header->magic)) != 0
+    ||  (header->version != STATE_VERSION && header->version != STATE_VERSION_1)
+    ||  map_size < header_size
+    ||  header->strings_size > map_size
+    ||  header_size + (uint64_t) header->count * sizeof (state_record_t) + header->strings_size != map_size
+    ||  (header->strings_size > 0 && ((char *) map) [map_size - 1] != '\0'))
+    {
+        log_error ("State file %s has unknown format or version", path);
+        munmap (map, map_size);
+        return NULL;
+    }
+
+    state_t *self = (state_t *) zmalloc (sizeof (state_t));
+    if (!self) {
+        munmap (map, map_size);
+        return NULL;
+    }
+    self->map = map;
+    self->map_size = map_size;
+    if (header_size < sizeof (state_header_t)) {
+        // snapshot time and shutdown flags unknown, times are taken as saved
+        memcpy (&self->converted, header, header_size);
+        header = &self->converted;
+    }
+    self->header = header;
+    self->records = (state_record_t *) ((char *) map + header_size);
+    self->strings = (char *) (self->records + header->count);
+
+    if (s_state_checksum (self) != header->checksum) {
+        log_error ("State file %s is damaged (checksum mismatch)", path);
+        state_destroy (&self);
+        return NULL;
+    }
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Return number of records
+size_t
+state_size (state_t *self)
+{
+    assert (self);
+    return self->header->count;
+}
+
+//  --------------------------------------------------------------------------
+//  Return time when the snapshot was taken
+uint64_t
+state_time (state_t *self)
+{
+    assert (self);
+    return self->header->time_sec;
+}
+
+//  --------------------------------------------------------------------------
+//  Return header flags
+uint32_t
+state_flags (state_t *self)
+{
+    assert (self);
+    return self->header->flags;
+}
+
+//  --------------------------------------------------------------------------
+//  Set header flags
+void
+state_set_flags (state_t *self, uint32_t flags)
+{
+    assert (self);
+    assert (!self->map);
+    self->header->flags = flags;
+}
+
+//  --------------------------------------------------------------------------
+//  Return record at index
+const state_record_t *
+state_record (state_t *self, size_t index)
+{
+    assert (self);
+    if (index >= self->header->count)
+        return NULL;
+    return &self->records [index];
+}
+
+//  --------------------------------------------------------------------------
+//  Return asset name of the record
+const char *
+state_record_name (state_t *self, const state_record_t *record)
+{
+    assert (self);
+    assert (record);
+    if (record->name_offset >= self->header->strings_size)
+        return NULL;
+    return self->strings + record->name_offset;
+}
+
+//  --------------------------------------------------------------------------
+//  Actor writing states in background
+void
+state_writer (zsock_t *pipe, void *args)
+{
+    zsock_signal (pipe, 0);
+    while (!zsys_interrupted) {
+        char *command = NULL;
+        char *path = NULL;
+        void *state = NULL;
+        char *catalog_path = NULL;
+        void *catalog = NULL;
+        if (zsock_recv (pipe, "sspsp", &command, &path, &state, &catalog_path, &catalog) != 0 || !command)
+            break;
+        if (streq (command, "$TERM")) {
+            zstr_free (&command);
+            break;
+        }
+        if (streq (command, "SAVE") && path && state) {
+            state_t *self = (state_t *) state;
+            int64_t start = zclock_mono ();
+            int rv = state_save (self, path);
+            log_debug ("state_writer: %zu records saved to %s in %" PRIi64 " ms",
+                       state_size (self), path, zclock_mono () - start);
+            state_destroy (&self);
+            if (catalog) {
+                catalog_t *assets = (catalog_t *) catalog;
+                if (catalog_save (assets, catalog_path) != 0)
+                    rv = -1;
+                catalog_destroy (&assets);
+            }
+            zsock_send (pipe, "si", "SAVED", rv);
+        }
+        else
+            log_error ("state_writer: unknown command %s", command);
+        zstr_free (&command);
+        zstr_free (&path);
+        zstr_free (&catalog_path);
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+state_test (bool verbose)
+{
+    ftylog_setInstance("state_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * state: \n");
+
+    //  @selftest
+    const char *path = "src/state_test.bin";
+
+    // save/load round trip
+    state_t *state = state_new (4242);
+    assert (state);
+    assert (state_size (state) == 0);
+    state_set_flags (state, STATE_CLEAN_SHUTDOWN);
+    assert (state_add (state, "UPS1", STATE_FLAG_TRACKED | STATE_FLAG_ALERT_ACTIVE, 100, 15, 0) == 0);
+    assert (state_add (state, "DEVICE WITH SPACE", STATE_FLAG_ALERT_ACTIVE, 0, 0, 0) == 0);
+    assert (state_add (state, "epdu-42", STATE_FLAG_TRACKED, 200, 30, 5000) == 0);
+    assert (state_save (state, path) == 0);
+    state_destroy (&state);
+
+    state = state_load (path);
+    assert (state);
+    assert (state_size (state) == 3);
+    assert (state_time (state) == 4242);
+    assert (state_flags (state) == STATE_CLEAN_SHUTDOWN);
+    const state_record_t *record = state_record (state, 0);
+    assert (streq (state_record_name (state, record), "UPS1"));
+    assert (record->flags == (STATE_FLAG_TRACKED | STATE_FLAG_ALERT_ACTIVE));
+    assert (record->last_time_seen_sec == 100);
+    assert (record->ttl_sec == 15);
+    record = state_record (state, 1);
+    assert (streq (state_record_name (state, record), "DEVICE WITH SPACE"));
+    assert (record->flags == STATE_FLAG_ALERT_ACTIVE);
+    record = state_record (state, 2);
+    assert (streq (state_record_name (state, record), "epdu-42"));
+    assert (record->maintenance_until_sec == 5000);
+    assert (state_record (state, 3) == NULL);
+    state_destroy (&state);
+
+    // damaged file is refused
+    FILE *f = fopen (path, "r+b");
+    assert (f);
+    fseek (f, -2, SEEK_END);
+    fputc ('X', f);
+    fclose (f);
+    assert (state_load (path) == NULL);
+
+    // header is covered by the checksum too
+    state = state_new (4242);
+    assert (state_add (state, "UPS1", STATE_FLAG_TRACKED, 100, 15, 0) == 0);
+    assert (state_save (state, path) == 0);
+    state_destroy (&state);
+    f = fopen (path, "r+b");
+    assert (f);
+    fseek (f, offsetof (state_header_t, flags), SEEK_SET);
+    fputc (STATE_CLEAN_SHUTDOWN, f);
+    fclose (f);
+    assert (state_load (path) == NULL);
+
+    // sizes which wrap around to the file size are refused
+    state = state_new (4242);
+    assert (state_save (state, path) == 0);
+    state_destroy (&state);
+    state_header_t bad_header;
+    f = fopen (path, "r+b");
+    assert (f);
+    assert (fread (&bad_header, sizeof (bad_header), 1, f) == 1);
+    bad_header.count = 1000;
+    bad_header.strings_size = (uint64_t) 0 - 1000 * sizeof (state_record_t);
+    fseek (f, 0, SEEK_SET);
+    assert (fwrite (&bad_header, sizeof (bad_header), 1, f) == 1);
+    fclose (f);
+    assert (state_load (path) == NULL);
+
+    // missing or foreign file is refused
+    unlink (path);
+    assert (state_load (path) == NULL);
+    f = fopen (path, "w");
+    assert (f);
+    fputs ("root\n    alerts\n        0 = \"UPS1\"\n", f);
+    fclose (f);
+    assert (state_load (path) == NULL);
+    unlink (path);
+
+    // file is replaced as a whole, failed write keeps no temporary file
+    char text [] = "file content";
+    struct iovec parts [] = { { text, 4 }, { text + 4, sizeof (text) - 4 } };
+    assert (state_write_file (path, parts, 2) == 0);
+    f = fopen (path, "r");
+    assert (f);
+    char buffer [32] = {0};
+    assert (fread (buffer, 1, sizeof (buffer), f) == sizeof (text));
+    fclose (f);
+    assert (streq (buffer, text));
+    assert (state_write_file ("src/no-such-dir/state_test.bin", parts, 2) == -1);
+    assert (access ("src/no-such-dir/state_test.bin.tmp", F_OK) == -1);
+
+    // version 1 file (without time and flags) is loaded
+    state = state_new (4242);
+    state_set_flags (state, STATE_CLEAN_SHUTDOWN);
+    assert (state_add (state, "UPS1", STATE_FLAG_TRACKED, 100, 15, 0) == 0);
+    state->header->version = STATE_VERSION_1;
+    state->header->checksum = s_state_checksum (state);
+    struct iovec v1_parts [] = {
+        { state->header, offsetof (state_header_t, time_sec) },
+        { state->records, state->header->count * sizeof (state_record_t) },
+        { state->strings, state->header->strings_size }
+    };
+    assert (state_write_file (path, v1_parts, 3) == 0);
+    state_destroy (&state);
+    state = state_load (path);
+    assert (state);
+    assert (state_size (state) == 1);
+    assert (state_time (state) == 0);
+    assert (state_flags (state) == 0);
+    record = state_record (state, 0);
+    assert (streq (state_record_name (state, record), "UPS1"));
+    assert (record->last_time_seen_sec == 100 && record->ttl_sec == 15);
+    state_destroy (&state);
+    unlink (path);
+
+    // timings for a big site
+    const size_t count = 100000;
+    int64_t start = zclock_usecs ();
+    state = state_new (0);
+    for (size_t i = 0; i < count; i++) {
+        char name [32];
+        snprintf (name, sizeof (name), "ups-%zu", i);
+        assert (state_add (state, name, STATE_FLAG_TRACKED | ((i % 100) ? 0 : STATE_FLAG_ALERT_ACTIVE), i, 15, 0) == 0);
+    }
+    int64_t built = zclock_usecs ();
+    assert (state_save (state, path) == 0);
+    int64_t saved = zclock_usecs ();
+    state_destroy (&state);
+
+    int64_t load_start = zclock_usecs ();
+    state = state_load (path);
+    assert (state);
+    size_t alerts = 0;
+    for (size_t i = 0; i < state_size (state); i++) {
+        if (state_record (state, i)->flags & STATE_FLAG_ALERT_ACTIVE)
+            alerts++;
+    }
+    int64_t loaded = zclock_usecs ();
+    assert (state_size (state) == count);
+    assert (alerts == count / 100);
+    assert (streq (state_record_name (state, state_record (state, count - 1)), "ups-99999"));
+    state_destroy (&state);
+    log_info ("%s: %zu assets: build %" PRIi64 " us, save %" PRIi64 " us, load %" PRIi64 " us",
+              __func__, count, built - start, saved - built, loaded - load_start);
+
+    // background writer
+    zactor_t *writer = zactor_new (state_writer, NULL);
+    assert (writer);
+    state = state_new (0);
+    assert (state_add (state, "UPS1", STATE_FLAG_TRACKED, 100, 15, 0) == 0);
+    catalog_t *catalog = catalog_new ();
+    assert (catalog_add (catalog, "UPS1", "UPS 1", "ups", NULL) == 0);
+    zsock_send (writer, "sspsp", "SAVE", path, state, "src/state_test.catalog", catalog);
+    char *command = NULL;
+    int rv = -1;
+    assert (zsock_recv (writer, "si", &command, &rv) == 0);
+    assert (streq (command, "SAVED"));
+    assert (rv == 0);
+    zstr_free (&command);
+    zactor_destroy (&writer);
+    state = state_load (path);
+    assert (state);
+    assert (state_size (state) == 1);
+    state_destroy (&state);
+    catalog = catalog_load ("src/state_test.catalog");
+    assert (catalog);
+    assert (catalog_size (catalog) == 1);
+    catalog_destroy (&catalog);
+    unlink ("src/state_test.catalog");
+
+    unlink (path);
+    //  @end
+    printf ("OK\n");
+}
@@ -0,0 +1,163 @@
+/*  =========================================================================
+    state - Binary snapshot of outage state
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef STATE_H_INCLUDED
+#define STATE_H_INCLUDED
+
+#include "../include/fty-outage.h"
+#include <sys/uio.h>
+
+// file layout (native byte order):
+//      state_header_t
+//      state_record_t [count]
+//      strings [strings_size], zero terminated names
+#define STATE_MAGIC   "FTYOUTST"
+#define STATE_VERSION 2
+// version 1 header ends before time_sec, records are the same
+#define STATE_VERSION_1 1
+
+#define STATE_FNV_OFFSET_BASIS 14695981039346656037ULL
+
+// header flags
+#define STATE_CLEAN_SHUTDOWN    0x01    // saved on shutdown, times are exact
+
+// record flags
+#define STATE_FLAG_ALERT_ACTIVE 0x01    // outage alert is active for the asset
+#define STATE_FLAG_TRACKED      0x02    // asset is tracked, times are valid
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _state_header_t {
+    char magic [8];                 // STATE_MAGIC, not zero terminated
+    uint32_t version;               // STATE_VERSION
+    uint32_t count;                 // number of records
+    uint64_t strings_size;          // [B] size of string area
+    uint64_t checksum;              // FNV-1a of header (zero checksum), records and strings
+    uint64_t time_sec;              // [s] time when the snapshot was taken
+    uint32_t flags;                 // STATE_CLEAN_SHUTDOWN
+    uint32_t reserved;
+} state_header_t;
+
+typedef struct _state_record_t {
+    uint32_t name_offset;           // offset of asset name in string area
+    uint32_t flags;                 // STATE_FLAG_*
+    uint64_t last_time_seen_sec;    // [s] time when some metrics were seen for the asset
+    uint64_t ttl_sec;               // [s] minimal ttl seen for the asset
+    uint64_t maintenance_until_sec; // [s] end of maintenance window, 0 if none
+} state_record_t;
+
+//  Structure of our class
+struct _state_t {
+    state_header_t *header;         // header of the snapshot (mapped or built)
+    state_record_t *records;        // records of the snapshot
+    char *strings;                  // string area
+    size_t records_alloc;           // [records] allocated while building, 0 if mapped
+    size_t strings_alloc;           // [B] allocated while building, 0 if mapped
+    void *map;                      // mapped file, NULL while building
+    state_header_t converted;       // header of an older version, filled on load
+    size_t map_size;                // [B] size of mapped file
+};
+
+#ifndef STATE_T_DEFINED
+typedef struct _state_t state_t;
+#define STATE_T_DEFINED
+#endif
+
+//  @interface
+//  Create a new empty state to be filled by state_add, taken at time_sec
+FTY_OUTAGE_EXPORT state_t *
+    state_new (uint64_t time_sec);
+
+//  Destroy the state
+FTY_OUTAGE_EXPORT void
+    state_destroy (state_t **self_p);
+
+//  Append record for an asset, return -1 on memory error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    state_add (state_t *self, const char *asset_name, uint32_t flags,
+               uint64_t last_time_seen_sec, uint64_t ttl_sec, uint64_t maintenance_until_sec);
+
+//  Write the state to a file
+//  data go to a temporary file first, which atomically replaces target
+//  return -1 on error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    state_save (state_t *self, const char *path);
+
+//  Map the state file into memory, records are not copied nor parsed
+//  version 1 files are loaded with zero time and flags
+//  return NULL if file is missing, damaged or of unknown version
+FTY_OUTAGE_EXPORT state_t *
+    state_load (const char *path);
+
+//  Return number of records
+FTY_OUTAGE_EXPORT size_t
+    state_size (state_t *self);
+
+//  Return time [s] when the snapshot was taken
+FTY_OUTAGE_EXPORT uint64_t
+    state_time (state_t *self);
+
+//  Return header flags (STATE_CLEAN_SHUTDOWN)
+FTY_OUTAGE_EXPORT uint32_t
+    state_flags (state_t *self);
+
+//  Set header flags
+FTY_OUTAGE_EXPORT void
+    state_set_flags (state_t *self, uint32_t flags);
+
+//  Return record at index, NULL if out of range
+FTY_OUTAGE_EXPORT const state_record_t *
+    state_record (state_t *self, size_t index);
+
+//  Return asset name of the record, NULL if record is damaged
+FTY_OUTAGE_EXPORT const char *
+    state_record_name (state_t *self, const state_record_t *record);
+
+//  Actor writing states in background, so the caller does not wait on disk
+//  request:  "SAVE"/path/state_t */catalog path/catalog_t * (actor takes
+//            ownership of the state and the catalog, catalog may be NULL)
+//  reply:    "SAVED"/rv, rv is -1 if any of them was not saved, 0 otherwise
+FTY_OUTAGE_EXPORT void
+    state_writer (zsock_t *pipe, void *args);
+
+//  Write parts to a temporary file, fsync it and rename it over path, then
+//  fsync the directory, so path holds either old or new data after a crash
+//  return -1 on error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    state_write_file (const char *path, const struct iovec *parts, int count);
+
+//  Update FNV-1a hash with data, start with STATE_FNV_OFFSET_BASIS
+FTY_OUTAGE_EXPORT uint64_t
+    state_fnv1a (uint64_t hash, const void *data, size_t size);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    state_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
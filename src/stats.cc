@@ -0,0 +1,298 @@
+/*  =========================================================================
+    stats - Performance counters and latency histograms
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    stats - Performance counters and latency histograms
+@discuss
+    Counters and latency histograms of the hot paths of the main actor. Values
+    are recorded to log-linear buckets (HDR style): values below 16 us are
+    exact, each following power of two is split into 16 buckets. Recording is
+    a few integer operations without any allocation; percentiles are computed
+    only when the stats are reported. Stats are owned by a single thread.
+@end
+*/
+
+#include "fty_outage_classes.h"
+
+static const char *s_counter_names [STATS_COUNTERS] = {
+    "metrics",
+    "assets_touched",
+    "alerts_active",
+    "alerts_resolved",
+    "send_errors",
+    "mailbox",
+    "stalls",
+    "heartbeats"
+};
+
+static const char *s_histogram_names [STATS_HISTOGRAMS] = {
+    "check_dead",
+    "read_metrics",
+    "metric_processing",
+    "save",
+    "send",
+    "loop"
+};
+
+// index of the bucket of the value
+static size_t
+s_bucket (uint64_t value)
+{
+    if (value < STATS_SUB_COUNT)
+        return (size_t) value;
+    int shift = 63 - __builtin_clzll (value) - STATS_SUB_BITS;
+    return (size_t) (shift + 1) * STATS_SUB_COUNT + (size_t) ((value >> shift) - STATS_SUB_COUNT);
+}
+
+// highest value of the bucket
+static uint64_t
+s_bucket_max (size_t index)
+{
+    if (index < STATS_SUB_COUNT)
+        return index;
+    int shift = (int) (index / STATS_SUB_COUNT) - 1;
+    uint64_t sub = index % STATS_SUB_COUNT;
+    return ((STATS_SUB_COUNT + sub + 1) << shift) - 1;
+}
+
+//  --------------------------------------------------------------------------
+//  Create a new stats with all counters zero
+stats_t *
+stats_new (void)
+{
+    stats_t *self = (stats_t *) zmalloc (sizeof (stats_t));
+    if (self)
+        stats_reset (self);
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the stats
+void
+stats_destroy (stats_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        free (*self_p);
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Add value to the counter
+void
+stats_add (stats_t *self, int counter, uint64_t value)
+{
+    assert (self);
+    assert (counter >= 0 && counter < STATS_COUNTERS);
+    self->counters [counter] += value;
+}
+
+//  --------------------------------------------------------------------------
+//  Record latency [us] to the histogram
+void
+stats_record (stats_t *self, int histogram, uint64_t value_us)
+{
+    assert (self);
+    assert (histogram >= 0 && histogram < STATS_HISTOGRAMS);
+    stats_histogram_t *h = &self->histograms [histogram];
+    if (h->count == 0 || value_us < h->min)
+        h->min = value_us;
+    if (value_us > h->max)
+        h->max = value_us;
+    h->count++;
+    h->sum += value_us;
+    h->buckets [s_bucket (value_us)]++;
+}
+
+//  --------------------------------------------------------------------------
+//  Record time elapsed since start_us to the histogram
+void
+stats_record_since (stats_t *self, int histogram, int64_t start_us)
+{
+    int64_t elapsed_us = zclock_usecs () - start_us;
+    stats_record (self, histogram, elapsed_us > 0 ? (uint64_t) elapsed_us : 0);
+}
+
+//  --------------------------------------------------------------------------
+//  Return value of the counter
+uint64_t
+stats_counter (stats_t *self, int counter)
+{
+    assert (self);
+    assert (counter >= 0 && counter < STATS_COUNTERS);
+    return self->counters [counter];
+}
+
+//  --------------------------------------------------------------------------
+//  Return number of values recorded to the histogram
+uint64_t
+stats_count (stats_t *self, int histogram)
+{
+    assert (self);
+    assert (histogram >= 0 && histogram < STATS_HISTOGRAMS);
+    return self->histograms [histogram].count;
+}
+
+//  --------------------------------------------------------------------------
+//  Return value [us] below which percentile of recorded values is
+uint64_t
+stats_percentile (stats_t *self, int histogram, double percentile)
+{
+    assert (self);
+    assert (histogram >= 0 && histogram < STATS_HISTOGRAMS);
+    stats_histogram_t *h = &self->histograms [histogram];
+    if (h->count == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t) (percentile / 100.0 * (double) h->count + 0.5);
+    if (rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < STATS_BUCKETS; i++) {
+        seen += h->buckets [i];
+        if (seen >= rank) {
+            uint64_t value = s_bucket_max (i);
+            return value < h->max ? value : h->max;
+        }
+    }
+    return h->max;
+}
+
+//  --------------------------------------------------------------------------
+//  Call fn for each key and value
+void
+stats_report (stats_t *self, stats_report_fn *fn, void *arg)
+{
+    assert (self);
+    assert (fn);
+
+    fn ("uptime_sec", (uint64_t) (zclock_mono () - self->start_ms) / 1000, arg);
+    for (int i = 0; i < STATS_COUNTERS; i++)
+        fn (s_counter_names [i], self->counters [i], arg);
+
+    for (int i = 0; i < STATS_HISTOGRAMS; i++) {
+        stats_histogram_t *h = &self->histograms [i];
+        char key [64];
+        snprintf (key, sizeof (key), "%s.count", s_histogram_names [i]);
+        fn (key, h->count, arg);
+        snprintf (key, sizeof (key), "%s.mean_us", s_histogram_names [i]);
+        fn (key, h->count ? h->sum / h->count : 0, arg);
+        snprintf (key, sizeof (key), "%s.p50_us", s_histogram_names [i]);
+        fn (key, stats_percentile (self, i, 50), arg);
+        snprintf (key, sizeof (key), "%s.p99_us", s_histogram_names [i]);
+        fn (key, stats_percentile (self, i, 99), arg);
+        snprintf (key, sizeof (key), "%s.max_us", s_histogram_names [i]);
+        fn (key, h->max, arg);
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Set all counters and histograms to zero
+void
+stats_reset (stats_t *self)
+{
+    assert (self);
+    memset (self->counters, 0, sizeof (self->counters));
+    memset (self->histograms, 0, sizeof (self->histograms));
+    self->start_ms = zclock_mono ();
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+static void
+s_test_report (const char *key, uint64_t value, void *arg)
+{
+    zhashx_t *report = (zhashx_t *) arg;
+    zhashx_update (report, key, (void *) (uintptr_t) (value + 1));
+}
+
+void
+stats_test (bool verbose)
+{
+    ftylog_setInstance("stats_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * stats: \n");
+
+    //  @selftest
+    // buckets cover the whole range and keep the relative error small
+    assert (s_bucket (0) == 0);
+    assert (s_bucket (15) == 15);
+    assert (s_bucket (16) == 16);
+    assert (s_bucket (UINT64_MAX) == STATS_BUCKETS - 1);
+    for (uint64_t value = 1; value < (1ULL << 40); value = value * 3 + 1) {
+        size_t index = s_bucket (value);
+        assert (s_bucket_max (index) >= value);
+        assert (s_bucket_max (index) - value <= value / STATS_SUB_COUNT);
+        assert (index == 0 || s_bucket_max (index - 1) < value);
+    }
+
+    stats_t *stats = stats_new ();
+    assert (stats);
+    assert (stats_percentile (stats, STATS_SEND, 50) == 0);
+
+    stats_add (stats, STATS_METRICS, 10);
+    stats_add (stats, STATS_METRICS, 5);
+    assert (stats_counter (stats, STATS_METRICS) == 15);
+    assert (stats_counter (stats, STATS_ALERTS_ACTIVE) == 0);
+
+    // 1..1000 us
+    for (uint64_t value = 1; value <= 1000; value++)
+        stats_record (stats, STATS_CHECK_DEAD, value);
+    assert (stats_count (stats, STATS_CHECK_DEAD) == 1000);
+    uint64_t p50 = stats_percentile (stats, STATS_CHECK_DEAD, 50);
+    uint64_t p99 = stats_percentile (stats, STATS_CHECK_DEAD, 99);
+    assert (p50 >= 500 && p50 <= 500 + 500 / STATS_SUB_COUNT);
+    assert (p99 >= 990 && p99 <= 1000);
+    assert (stats_percentile (stats, STATS_CHECK_DEAD, 100) == 1000);
+    assert (stats_percentile (stats, STATS_CHECK_DEAD, 0) == 1);
+
+    zhashx_t *report = zhashx_new ();
+    stats_report (stats, s_test_report, report);
+    assert ((uintptr_t) zhashx_lookup (report, "metrics") == 15 + 1);
+    assert ((uintptr_t) zhashx_lookup (report, "check_dead.count") == 1000 + 1);
+    assert ((uintptr_t) zhashx_lookup (report, "check_dead.mean_us") == 500 + 1);
+    assert ((uintptr_t) zhashx_lookup (report, "check_dead.max_us") == 1000 + 1);
+    assert ((uintptr_t) zhashx_lookup (report, "send.p99_us") == 0 + 1);
+    assert (zhashx_lookup (report, "uptime_sec"));
+    zhashx_destroy (&report);
+
+    stats_reset (stats);
+    assert (stats_counter (stats, STATS_METRICS) == 0);
+    assert (stats_count (stats, STATS_CHECK_DEAD) == 0);
+
+    // recording is cheap enough for hot paths
+    const int count = 1000000;
+    int64_t start = zclock_usecs ();
+    for (int i = 0; i < count; i++)
+        stats_record (stats, STATS_SEND, (uint64_t) (i * 7919) % 100000);
+    int64_t elapsed = zclock_usecs () - start;
+    assert (stats_count (stats, STATS_SEND) == (uint64_t) count);
+    log_info ("%s: %d values recorded in %" PRIi64 " us", __func__, count, elapsed);
+    stats_destroy (&stats);
+    //  @end
+    printf ("OK\n");
+}
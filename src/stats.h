@@ -0,0 +1,133 @@
+/*  =========================================================================
+    stats - Performance counters and latency histograms
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED
+
+#include "../include/fty-outage.h"
+
+// counters
+#define STATS_METRICS           0   // metrics processed (shm and streams)
+#define STATS_ASSETS_TOUCHED    1   // last seen times updated
+#define STATS_ALERTS_ACTIVE     2   // ACTIVE alerts published
+#define STATS_ALERTS_RESOLVED   3   // RESOLVED alerts published
+#define STATS_SEND_ERRORS       4   // messages mlm_client_send failed to send
+#define STATS_MAILBOX           5   // mailbox requests handled
+#define STATS_STALLS            6   // iterations of the main loop longer than the stall threshold
+#define STATS_HEARTBEATS        7   // watchdog heartbeats of the main loop
+#define STATS_COUNTERS          8
+
+// latency histograms
+#define STATS_CHECK_DEAD        0   // s_osrv_check_dead_devices
+#define STATS_READ_METRICS      1   // fty::shm::read_metrics of a polling cycle
+#define STATS_METRIC_PROCESSING 2   // metric_processing of a polling cycle
+#define STATS_SAVE              3   // main actor busy with saving the state
+#define STATS_SEND              4   // mlm_client_send of an alert
+#define STATS_LOOP              5   // iteration of the main loop, without waiting
+#define STATS_HISTOGRAMS        6
+
+// each power of two of a histogram is split into 2^STATS_SUB_BITS buckets,
+// so recorded values are kept with relative error below 1/16
+#define STATS_SUB_BITS          4
+#define STATS_SUB_COUNT         (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS           ((64 - STATS_SUB_BITS + 1) * STATS_SUB_COUNT)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _stats_histogram_t {
+    uint64_t count;                 // values recorded
+    uint64_t sum;                   // [us] of values recorded
+    uint64_t min;                   // [us]
+    uint64_t max;                   // [us]
+    uint64_t buckets [STATS_BUCKETS];
+} stats_histogram_t;
+
+//  Structure of our class
+struct _stats_t {
+    int64_t start_ms;               // zclock_mono when the stats were reset
+    uint64_t counters [STATS_COUNTERS];
+    stats_histogram_t histograms [STATS_HISTOGRAMS];
+};
+
+#ifndef STATS_T_DEFINED
+typedef struct _stats_t stats_t;
+#define STATS_T_DEFINED
+#endif
+
+// callback for stats_report
+typedef void (stats_report_fn) (const char *key, uint64_t value, void *arg);
+
+//  @interface
+//  Create a new stats with all counters zero
+FTY_OUTAGE_EXPORT stats_t *
+    stats_new (void);
+
+//  Destroy the stats
+FTY_OUTAGE_EXPORT void
+    stats_destroy (stats_t **self_p);
+
+//  Add value to the counter (STATS_METRICS, ...)
+FTY_OUTAGE_EXPORT void
+    stats_add (stats_t *self, int counter, uint64_t value);
+
+//  Record latency [us] to the histogram (STATS_CHECK_DEAD, ...)
+FTY_OUTAGE_EXPORT void
+    stats_record (stats_t *self, int histogram, uint64_t value_us);
+
+//  Record time elapsed since start_us (zclock_usecs) to the histogram
+FTY_OUTAGE_EXPORT void
+    stats_record_since (stats_t *self, int histogram, int64_t start_us);
+
+//  Return value of the counter
+FTY_OUTAGE_EXPORT uint64_t
+    stats_counter (stats_t *self, int counter);
+
+//  Return number of values recorded to the histogram
+FTY_OUTAGE_EXPORT uint64_t
+    stats_count (stats_t *self, int histogram);
+
+//  Return value [us] below which percentile (0..100) of recorded values is
+//  return 0 if nothing was recorded
+FTY_OUTAGE_EXPORT uint64_t
+    stats_percentile (stats_t *self, int histogram, double percentile);
+
+//  Call fn for each key and value: uptime, counters, then count, mean,
+//  percentiles and max of each histogram (e.g. "check_dead.p99_us")
+FTY_OUTAGE_EXPORT void
+    stats_report (stats_t *self, stats_report_fn *fn, void *arg);
+
+//  Set all counters and histograms to zero
+FTY_OUTAGE_EXPORT void
+    stats_reset (stats_t *self);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    stats_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,556 @@
+/*  =========================================================================
+    status - Published snapshots of asset status
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    status - Published snapshots of asset status
+@discuss
+    The outage actor is the only writer. It updates status of changed assets
+    and publishes a new immutable view after each batch. Readers in other
+    threads take the current view without any lock: a reader announces the
+    epoch it entered in, and the writer frees a replaced view only once no
+    reader entered before it was replaced (epoch based reclamation). Names
+    of assets are indexed separately and shared by views until an asset is
+    added or removed.
+@end
+*/
+
+#include "fty_outage_classes.h"
+#include <new>
+
+static int
+s_index_entry_compare (const void *a, const void *b)
+{
+    return strcmp (((const status_index_entry_t *) a)->name, ((const status_index_entry_t *) b)->name);
+}
+
+// build index of names from slots_by_name, return NULL on memory error
+static status_index_t *
+s_status_index_new (status_t *self)
+{
+    status_index_t *index = (status_index_t *) zmalloc (sizeof (status_index_t));
+    if (!index)
+        return NULL;
+    index->count = zhashx_size (self->slots_by_name);
+    index->refs = 1;
+
+    size_t strings_size = 0;
+    for (void *it = zhashx_first (self->slots_by_name); it != NULL; it = zhashx_next (self->slots_by_name))
+        strings_size += strlen ((const char *) zhashx_cursor (self->slots_by_name)) + 1;
+    index->entries = (status_index_entry_t *) malloc ((index->count ? index->count : 1) * sizeof (status_index_entry_t));
+    index->strings = (char *) malloc (strings_size ? strings_size : 1);
+    if (!index->entries || !index->strings) {
+        free (index->entries);
+        free (index->strings);
+        free (index);
+        return NULL;
+    }
+
+    size_t i = 0;
+    char *string = index->strings;
+    for (void *it = zhashx_first (self->slots_by_name); it != NULL; it = zhashx_next (self->slots_by_name)) {
+        const char *name = (const char *) zhashx_cursor (self->slots_by_name);
+        size_t length = strlen (name) + 1;
+        memcpy (string, name, length);
+        index->entries [i].name = string;
+        index->entries [i].slot = (size_t) (uintptr_t) it - 1;
+        string += length;
+        i++;
+    }
+    qsort (index->entries, index->count, sizeof (status_index_entry_t), s_index_entry_compare);
+    return index;
+}
+
+static void
+s_status_index_unref (status_index_t **index_p)
+{
+    status_index_t *index = *index_p;
+    if (index && --index->refs == 0) {
+        free (index->entries);
+        free (index->strings);
+        free (index);
+    }
+    *index_p = NULL;
+}
+
+static void
+s_status_view_destroy (status_view_t **view_p)
+{
+    status_view_t *view = *view_p;
+    if (view) {
+        s_status_index_unref (&view->index);
+        free (view->records);
+        free (view);
+    }
+    *view_p = NULL;
+}
+
+// free replaced views, which no reader entered before they were replaced
+static void
+s_status_reclaim (status_t *self)
+{
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < STATUS_READERS; i++) {
+        uint64_t epoch = self->reader_epoch [i].load ();
+        if (epoch != 0 && epoch < oldest)
+            oldest = epoch;
+    }
+    status_view_t **view_p = &self->retired;
+    while (*view_p) {
+        status_view_t *view = *view_p;
+        if (view->retired_epoch < oldest) {
+            *view_p = view->next_retired;
+            s_status_view_destroy (&view);
+        }
+        else
+            view_p = &view->next_retired;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Create a new status with an empty view published
+status_t *
+status_new (void)
+{
+    status_t *self = new (std::nothrow) status_t ();
+    if (!self)
+        return NULL;
+    self->slots_by_name = zhashx_new ();
+    if (self->slots_by_name)
+        self->index = s_status_index_new (self);
+    status_view_t *view = self->index ? (status_view_t *) zmalloc (sizeof (status_view_t)) : NULL;
+    if (!view) {
+        status_destroy (&self);
+        return NULL;
+    }
+    view->index = self->index;
+    view->index->refs++;
+    view->version = ++self->version;
+    self->current.store (view);
+    self->epoch.store (1);
+    for (int i = 0; i < STATUS_READERS; i++) {
+        self->reader_epoch [i].store (0);
+        self->reader_used [i].store (false);
+    }
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the status
+void
+status_destroy (status_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        status_t *self = *self_p;
+        status_view_t *view = self->current.load ();
+        s_status_view_destroy (&view);
+        while (self->retired) {
+            view = self->retired;
+            self->retired = view->next_retired;
+            s_status_view_destroy (&view);
+        }
+        s_status_index_unref (&self->index);
+        zhashx_destroy (&self->slots_by_name);
+        free (self->records);
+        free (self->free_slots);
+        delete self;
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Set status of the asset
+int
+status_update (status_t *self, const char *asset_name, uint64_t last_time_seen_sec,
+               uint64_t ttl_sec, uint64_t expires_sec, uint64_t maintenance_until_sec,
+               bool alert_active)
+{
+    assert (self);
+    assert (asset_name);
+
+    size_t slot = (size_t) (uintptr_t) zhashx_lookup (self->slots_by_name, asset_name);
+    if (slot == 0) {
+        if (self->free_count > 0)
+            slot = self->free_slots [--self->free_count];
+        else {
+            if (self->slots == self->alloc) {
+                size_t alloc = self->alloc ? self->alloc * 2 : 256;
+                status_record_t *records = (status_record_t *) realloc (self->records, alloc * sizeof (status_record_t));
+                if (!records)
+                    return -1;
+                size_t *free_slots = (size_t *) realloc (self->free_slots, alloc * sizeof (size_t));
+                if (!free_slots) {
+                    self->records = records;
+                    return -1;
+                }
+                self->records = records;
+                self->free_slots = free_slots;
+                self->alloc = alloc;
+            }
+            slot = self->slots++;
+        }
+        zhashx_insert (self->slots_by_name, asset_name, (void *) (uintptr_t) (slot + 1));
+        self->members_changed = true;
+    }
+    else
+        slot--;
+
+    status_record_t *record = &self->records [slot];
+    record->last_time_seen_sec = last_time_seen_sec;
+    record->ttl_sec = ttl_sec;
+    record->expires_sec = expires_sec;
+    record->maintenance_until_sec = maintenance_until_sec;
+    record->flags = STATUS_USED | (alert_active ? STATUS_ALERT_ACTIVE : 0);
+    record->reserved = 0;
+    self->changed = true;
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Remove the asset
+void
+status_remove (status_t *self, const char *asset_name)
+{
+    assert (self);
+    assert (asset_name);
+
+    size_t slot = (size_t) (uintptr_t) zhashx_lookup (self->slots_by_name, asset_name);
+    if (slot == 0)
+        return;
+    slot--;
+    memset (&self->records [slot], 0, sizeof (status_record_t));
+    self->free_slots [self->free_count++] = slot;
+    zhashx_delete (self->slots_by_name, asset_name);
+    self->changed = true;
+    self->members_changed = true;
+}
+
+//  --------------------------------------------------------------------------
+//  Return true if there are updates, which were not published
+bool
+status_changed (status_t *self)
+{
+    assert (self);
+    return self->changed;
+}
+
+//  --------------------------------------------------------------------------
+//  Publish a new view with all updates so far
+int
+status_publish (status_t *self, uint64_t time_sec)
+{
+    assert (self);
+
+    if (self->members_changed) {
+        status_index_t *index = s_status_index_new (self);
+        if (!index)
+            return -1;
+        s_status_index_unref (&self->index);
+        self->index = index;
+    }
+
+    status_view_t *view = (status_view_t *) zmalloc (sizeof (status_view_t));
+    if (!view)
+        return -1;
+    if (self->slots > 0) {
+        view->records = (status_record_t *) malloc (self->slots * sizeof (status_record_t));
+        if (!view->records) {
+            free (view);
+            return -1;
+        }
+        memcpy (view->records, self->records, self->slots * sizeof (status_record_t));
+    }
+    view->slots = self->slots;
+    view->index = self->index;
+    view->index->refs++;
+    view->version = ++self->version;
+    view->time_sec = time_sec;
+
+    // readers entering from now on get the new view
+    status_view_t *old = self->current.exchange (view);
+    old->retired_epoch = self->epoch.fetch_add (1);
+    old->next_retired = self->retired;
+    self->retired = old;
+    s_status_reclaim (self);
+
+    self->changed = false;
+    self->members_changed = false;
+    return 0;
+}
+
+//  --------------------------------------------------------------------------
+//  Register reader thread
+int
+status_reader_new (status_t *self)
+{
+    assert (self);
+    for (int i = 0; i < STATUS_READERS; i++) {
+        bool used = false;
+        if (self->reader_used [i].compare_exchange_strong (used, true))
+            return i;
+    }
+    return -1;
+}
+
+//  --------------------------------------------------------------------------
+//  Unregister reader thread
+void
+status_reader_destroy (status_t *self, int reader)
+{
+    assert (self);
+    assert (reader >= 0 && reader < STATUS_READERS);
+    self->reader_epoch [reader].store (0);
+    self->reader_used [reader].store (false);
+}
+
+//  --------------------------------------------------------------------------
+//  Return the current view
+const status_view_t *
+status_enter (status_t *self, int reader)
+{
+    assert (self);
+    assert (reader >= 0 && reader < STATUS_READERS);
+    self->reader_epoch [reader].store (self->epoch.load ());
+    return self->current.load ();
+}
+
+//  --------------------------------------------------------------------------
+//  Release the view
+void
+status_leave (status_t *self, int reader)
+{
+    assert (self);
+    assert (reader >= 0 && reader < STATUS_READERS);
+    self->reader_epoch [reader].store (0);
+}
+
+//  --------------------------------------------------------------------------
+//  Return number of assets in the view
+size_t
+status_view_size (const status_view_t *view)
+{
+    assert (view);
+    return view->index->count;
+}
+
+//  --------------------------------------------------------------------------
+//  Return record of i-th asset
+const status_record_t *
+status_view_at (const status_view_t *view, size_t i, const char **name_p)
+{
+    assert (view);
+    if (i >= view->index->count)
+        return NULL;
+    if (name_p)
+        *name_p = view->index->entries [i].name;
+    return &view->records [view->index->entries [i].slot];
+}
+
+//  --------------------------------------------------------------------------
+//  Return index of the first asset ordered after asset_name
+size_t
+status_view_after (const status_view_t *view, const char *asset_name)
+{
+    assert (view);
+    assert (asset_name);
+
+    size_t low = 0, high = view->index->count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (strcmp (view->index->entries [middle].name, asset_name) <= 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+//  --------------------------------------------------------------------------
+//  Return record of the asset
+const status_record_t *
+status_view_lookup (const status_view_t *view, const char *asset_name)
+{
+    assert (view);
+    assert (asset_name);
+
+    status_index_entry_t key = {asset_name, 0};
+    const status_index_entry_t *entry = (const status_index_entry_t *)
+        bsearch (&key, view->index->entries, view->index->count, sizeof (status_index_entry_t), s_index_entry_compare);
+    return entry ? &view->records [entry->slot] : NULL;
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+#define TEST_ASSETS 100
+#define TEST_PUBLISHES 2000
+
+// check, that every view is consistent: the writer sets all assets to the
+// same time before it publishes
+static void
+s_status_test_reader (zsock_t *pipe, void *args)
+{
+    status_t *status = (status_t *) args;
+    int reader = status_reader_new (status);
+    zsock_signal (pipe, 0);
+
+    int errors = reader < 0 ? 1 : 0;
+    uint64_t views = 0;
+    uint64_t last_version = 0;
+    while (reader >= 0 && last_version < TEST_PUBLISHES) {
+        const status_view_t *view = status_enter (status, reader);
+        if (view->version < last_version)
+            errors++;
+        last_version = view->version;
+        const status_record_t *first = status_view_at (view, 0, NULL);
+        for (size_t i = 0; first && i < status_view_size (view); i++) {
+            if (status_view_at (view, i, NULL)->last_time_seen_sec != first->last_time_seen_sec)
+                errors++;
+        }
+        status_leave (status, reader);
+        views++;
+    }
+    if (reader >= 0)
+        status_reader_destroy (status, reader);
+    zsock_send (pipe, "i8", errors, views);
+
+    zmsg_t *msg = zmsg_recv (pipe);
+    zmsg_destroy (&msg);
+}
+
+void
+status_test (bool verbose)
+{
+    ftylog_setInstance("status_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * status: \n");
+
+    //  @selftest
+    status_t *status = status_new ();
+    assert (status);
+    int reader = status_reader_new (status);
+    assert (reader >= 0);
+
+    // empty view is published from the start
+    const status_view_t *view = status_enter (status, reader);
+    assert (view && status_view_size (view) == 0);
+    assert (status_view_lookup (view, "ups-1") == NULL);
+    status_leave (status, reader);
+
+    assert (status_update (status, "ups-2", 100, 10, 120, 0, false) == 0);
+    assert (status_update (status, "ups-1", 200, 20, 240, 0, true) == 0);
+    assert (status_changed (status));
+    // not visible until published
+    view = status_enter (status, reader);
+    assert (status_view_size (view) == 0);
+    status_leave (status, reader);
+    assert (status_publish (status, 1000) == 0);
+    assert (!status_changed (status));
+
+    view = status_enter (status, reader);
+    assert (status_view_size (view) == 2);
+    const char *name = NULL;
+    const status_record_t *record = status_view_at (view, 0, &name);
+    assert (record && streq (name, "ups-1") && record->last_time_seen_sec == 200);
+    assert (record->flags & STATUS_ALERT_ACTIVE);
+    record = status_view_lookup (view, "ups-2");
+    assert (record && record->expires_sec == 120 && !(record->flags & STATUS_ALERT_ACTIVE));
+    // pages follow the name order
+    assert (status_view_after (view, "") == 0);
+    assert (status_view_after (view, "ups-1") == 1);
+    assert (status_view_after (view, "ups-15") == 1);
+    assert (status_view_after (view, "ups-2") == 2);
+
+    // view entered before publish stays as it was, and is not freed
+    assert (status_update (status, "ups-2", 150, 10, 170, 500, false) == 0);
+    status_remove (status, "ups-1");
+    assert (status_publish (status, 1001) == 0);
+    assert (status->retired != NULL);
+    assert (status_view_lookup (view, "ups-1") != NULL);
+    assert (status_view_lookup (view, "ups-2")->last_time_seen_sec == 100);
+    status_leave (status, reader);
+
+    view = status_enter (status, reader);
+    assert (status_view_size (view) == 1);
+    assert (status_view_lookup (view, "ups-1") == NULL);
+    assert (status_view_lookup (view, "ups-2")->maintenance_until_sec == 500);
+    status_leave (status, reader);
+    // nobody reads old views anymore
+    assert (status_publish (status, 1002) == 0);
+    assert (status->retired == NULL);
+    // removed slot is reused
+    assert (status_update (status, "ups-3", 300, 30, 360, 0, false) == 0);
+    assert (status->slots == 2);
+    status_reader_destroy (status, reader);
+    status_destroy (&status);
+
+    // readers in other threads always see a consistent view
+    status = status_new ();
+    zactor_t *readers [2];
+    for (int i = 0; i < 2; i++)
+        readers [i] = zactor_new (s_status_test_reader, status);
+    for (uint64_t version = 1; version <= TEST_PUBLISHES; version++) {
+        for (int i = 0; i < TEST_ASSETS; i++) {
+            char asset [32];
+            snprintf (asset, sizeof (asset), "ups-%d", i);
+            status_update (status, asset, version, 1, version + 2, 0, false);
+        }
+        assert (status_publish (status, version) == 0);
+    }
+    for (int i = 0; i < 2; i++) {
+        int errors = -1;
+        uint64_t views = 0;
+        assert (zsock_recv (readers [i], "i8", &errors, &views) == 0);
+        log_debug ("%s: reader %d checked %" PRIu64 " views", __func__, i, views);
+        assert (errors == 0);
+        zactor_destroy (&readers [i]);
+    }
+    status_destroy (&status);
+
+    // publish cost for a big site, when all assets changed
+    const size_t count = 100000;
+    status = status_new ();
+    for (size_t i = 0; i < count; i++) {
+        char asset [32];
+        snprintf (asset, sizeof (asset), "ups-%zu", i);
+        assert (status_update (status, asset, i, 1, i + 2, 0, false) == 0);
+    }
+    int64_t start = zclock_usecs ();
+    assert (status_publish (status, 1) == 0);
+    int64_t indexed = zclock_usecs ();
+    for (size_t i = 0; i < count; i += 100) {
+        char asset [32];
+        snprintf (asset, sizeof (asset), "ups-%zu", i);
+        assert (status_update (status, asset, i + 1, 1, i + 3, 0, false) == 0);
+    }
+    int64_t updated = zclock_usecs ();
+    assert (status_publish (status, 2) == 0);
+    int64_t published = zclock_usecs ();
+    log_info ("%s: %zu assets: first publish %" PRIi64 " us, publish of updates %" PRIi64 " us",
+              __func__, count, indexed - start, published - updated);
+    status_destroy (&status);
+    //  @end
+    printf ("OK\n");
+}
@@ -0,0 +1,174 @@
+/*  =========================================================================
+    status - Published snapshots of asset status
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef STATUS_H_INCLUDED
+#define STATUS_H_INCLUDED
+
+#include "../include/fty-outage.h"
+#include <atomic>
+
+// maximal number of reader threads
+#define STATUS_READERS 16
+
+// status_record_t flags
+#define STATUS_USED         0x01    // slot holds an asset
+#define STATUS_ALERT_ACTIVE 0x02    // outage alert is active
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _status_record_t {
+    uint64_t last_time_seen_sec;    // [s] last time the asset was seen
+    uint64_t ttl_sec;               // [s] learned TTL
+    uint64_t expires_sec;           // [s] asset is dead since then
+    uint64_t maintenance_until_sec; // [s] end of maintenance, 0 if none
+    uint32_t flags;                 // STATUS_USED, STATUS_ALERT_ACTIVE
+    uint32_t reserved;
+} status_record_t;
+
+typedef struct _status_index_entry_t {
+    const char *name;               // asset iname
+    size_t slot;                    // index to records of a view
+} status_index_entry_t;
+
+// names of the assets ordered by name, shared by views until assets are
+// added or removed
+typedef struct _status_index_t {
+    status_index_entry_t *entries;
+    size_t count;
+    char *strings;                  // names
+    size_t refs;                    // views and writer using the index
+} status_index_t;
+
+// immutable view of status of all assets
+typedef struct _status_view_t {
+    uint64_t version;               // sequence number of the view
+    uint64_t time_sec;              // [s] time the view was published
+    status_record_t *records;       // records indexed by slot
+    size_t slots;                   // number of records
+    status_index_t *index;          // names of assets
+    uint64_t retired_epoch;         // epoch the view was replaced in, writer only
+    struct _status_view_t *next_retired;
+} status_view_t;
+
+//  Structure of our class
+struct _status_t {
+    // writer side
+    zhashx_t *slots_by_name;        // asset iname => slot + 1
+    status_record_t *records;       // current status, indexed by slot
+    size_t slots;                   // slots used so far
+    size_t alloc;                   // slots allocated
+    size_t *free_slots;             // slots of removed assets
+    size_t free_count;
+    bool changed;                   // records changed since the last publish
+    bool members_changed;           // assets added or removed since the last publish
+    status_index_t *index;          // index of the current view
+    uint64_t version;               // version of the current view
+    status_view_t *retired;         // replaced views, which may be still read
+    // shared with readers
+    std::atomic<status_view_t *> current;
+    std::atomic<uint64_t> epoch;
+    std::atomic<uint64_t> reader_epoch [STATUS_READERS];    // 0 = reader outside of view
+    std::atomic<bool> reader_used [STATUS_READERS];
+};
+
+#ifndef STATUS_T_DEFINED
+typedef struct _status_t status_t;
+#define STATUS_T_DEFINED
+#endif
+
+//  @interface
+//  Create a new status with an empty view published
+FTY_OUTAGE_EXPORT status_t *
+    status_new (void);
+
+//  Destroy the status, there must be no readers
+FTY_OUTAGE_EXPORT void
+    status_destroy (status_t **self_p);
+
+//  Set status of the asset, seen by readers after next status_publish
+//  return -1 on memory error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    status_update (status_t *self, const char *asset_name, uint64_t last_time_seen_sec,
+                   uint64_t ttl_sec, uint64_t expires_sec, uint64_t maintenance_until_sec,
+                   bool alert_active);
+
+//  Remove the asset, seen by readers after next status_publish
+FTY_OUTAGE_EXPORT void
+    status_remove (status_t *self, const char *asset_name);
+
+//  Return true if there are updates, which were not published
+FTY_OUTAGE_EXPORT bool
+    status_changed (status_t *self);
+
+//  Publish a new view with all updates so far, and free replaced views,
+//  which no reader can use anymore. Writer side never waits for readers.
+//  return -1 on memory error, 0 otherwise
+FTY_OUTAGE_EXPORT int
+    status_publish (status_t *self, uint64_t time_sec);
+
+//  Register reader thread
+//  return reader id, -1 if all STATUS_READERS are registered
+FTY_OUTAGE_EXPORT int
+    status_reader_new (status_t *self);
+
+//  Unregister reader thread
+FTY_OUTAGE_EXPORT void
+    status_reader_destroy (status_t *self, int reader);
+
+//  Return the current view, which stays valid until status_leave
+FTY_OUTAGE_EXPORT const status_view_t *
+    status_enter (status_t *self, int reader);
+
+//  Release the view returned by status_enter
+FTY_OUTAGE_EXPORT void
+    status_leave (status_t *self, int reader);
+
+//  Return number of assets in the view
+FTY_OUTAGE_EXPORT size_t
+    status_view_size (const status_view_t *view);
+
+//  Return record of i-th asset (ordered by name) and set name_p to its name
+//  return NULL if index is out of range
+FTY_OUTAGE_EXPORT const status_record_t *
+    status_view_at (const status_view_t *view, size_t i, const char **name_p);
+
+//  Return index of the first asset ordered after asset_name, view size if
+//  there is none
+FTY_OUTAGE_EXPORT size_t
+    status_view_after (const status_view_t *view, const char *asset_name);
+
+//  Return record of the asset, NULL if the view does not contain it
+FTY_OUTAGE_EXPORT const status_record_t *
+    status_view_lookup (const status_view_t *view, const char *asset_name);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    status_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
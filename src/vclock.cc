@@ -0,0 +1,149 @@
+/*  =========================================================================
+    vclock - Clock, which can be switched to simulated time
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    vclock - Clock, which can be switched to simulated time
+@discuss
+    All time dependent logic of the agent (expiration of assets, alerts,
+    maintenance, schedules) reads the time from here. By default it is the
+    real time of zclock; selftests and benchmarks switch the whole process
+    to simulated time and move it forward, so hours of outage behavior run
+    in milliseconds. Simulated time is shared by all threads.
+@end
+*/
+
+#include "fty_outage_classes.h"
+#include <atomic>
+
+static std::atomic<bool> s_virtual (false);
+static std::atomic<int64_t> s_time_ms (0);  // simulated time since the epoch
+static std::atomic<int64_t> s_mono_ms (0);  // simulated monotonic time
+
+//  --------------------------------------------------------------------------
+//  Return current time [ms] since the epoch
+int64_t
+vclock_time (void)
+{
+    if (s_virtual.load (std::memory_order_acquire))
+        return s_time_ms.load (std::memory_order_acquire);
+    return zclock_time ();
+}
+
+//  --------------------------------------------------------------------------
+//  Return monotonic time [ms]
+int64_t
+vclock_mono (void)
+{
+    if (s_virtual.load (std::memory_order_acquire))
+        return s_mono_ms.load (std::memory_order_acquire);
+    return zclock_mono ();
+}
+
+//  --------------------------------------------------------------------------
+//  Switch the process to simulated time starting at time_ms
+void
+vclock_set_virtual (int64_t time_ms)
+{
+    // monotonic time goes on from the real one, never backwards
+    s_mono_ms.store (zclock_mono (), std::memory_order_release);
+    s_time_ms.store (time_ms, std::memory_order_release);
+    s_virtual.store (true, std::memory_order_release);
+}
+
+//  --------------------------------------------------------------------------
+//  Switch the process back to real time
+void
+vclock_set_real (void)
+{
+    s_virtual.store (false, std::memory_order_release);
+}
+
+//  --------------------------------------------------------------------------
+//  Return true if the time is simulated
+bool
+vclock_is_virtual (void)
+{
+    return s_virtual.load (std::memory_order_acquire);
+}
+
+//  --------------------------------------------------------------------------
+//  Move simulated time forward by msecs
+void
+vclock_advance (int64_t msecs)
+{
+    if (!s_virtual.load (std::memory_order_acquire) || msecs <= 0)
+        return;
+    s_time_ms.fetch_add (msecs, std::memory_order_acq_rel);
+    s_mono_ms.fetch_add (msecs, std::memory_order_acq_rel);
+}
+
+//  --------------------------------------------------------------------------
+//  Sleep msecs of real time, or move simulated time without waiting
+void
+vclock_sleep (int msecs)
+{
+    if (s_virtual.load (std::memory_order_acquire))
+        vclock_advance (msecs);
+    else
+        zclock_sleep (msecs);
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+vclock_test (bool verbose)
+{
+    ftylog_setInstance("vclock_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * vclock: \n");
+
+    //  @selftest
+    // real time by default
+    assert (!vclock_is_virtual ());
+    int64_t real_ms = zclock_time ();
+    assert (vclock_time () >= real_ms && vclock_time () - real_ms < 1000);
+
+    // simulated time moves only when asked, without waiting
+    vclock_set_virtual (1000000);
+    assert (vclock_is_virtual ());
+    assert (vclock_time () == 1000000);
+    int64_t mono_ms = vclock_mono ();
+    int64_t start_ms = zclock_mono ();
+    vclock_sleep (24 * 3600 * 1000);
+    assert (zclock_mono () - start_ms < 1000);
+    assert (vclock_time () == 1000000 + 24 * 3600 * 1000);
+    assert (vclock_mono () == mono_ms + 24 * 3600 * 1000);
+    vclock_advance (-5);
+    assert (vclock_time () == 1000000 + 24 * 3600 * 1000);
+
+    vclock_set_real ();
+    assert (!vclock_is_virtual ());
+    assert (vclock_time () - zclock_time () < 1000);
+    vclock_advance (1000);
+    assert (vclock_time () - zclock_time () < 1000);
+    //  @end
+    printf ("OK\n");
+}
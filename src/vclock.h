@@ -0,0 +1,71 @@
+/*  =========================================================================
+    vclock - Clock, which can be switched to simulated time
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#ifndef VCLOCK_H_INCLUDED
+#define VCLOCK_H_INCLUDED
+
+#include "../include/fty-outage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Return current time [ms] since the epoch, as zclock_time does
+FTY_OUTAGE_EXPORT int64_t
+    vclock_time (void);
+
+//  Return monotonic time [ms], as zclock_mono does
+FTY_OUTAGE_EXPORT int64_t
+    vclock_mono (void);
+
+//  Switch the process to simulated time starting at time_ms, it moves only
+//  with vclock_advance and vclock_sleep
+FTY_OUTAGE_EXPORT void
+    vclock_set_virtual (int64_t time_ms);
+
+//  Switch the process back to real time
+FTY_OUTAGE_EXPORT void
+    vclock_set_real (void);
+
+//  Return true if the time is simulated
+FTY_OUTAGE_EXPORT bool
+    vclock_is_virtual (void);
+
+//  Move simulated time forward by msecs, no-op for real time
+FTY_OUTAGE_EXPORT void
+    vclock_advance (int64_t msecs);
+
+//  Sleep msecs of real time, or move simulated time without waiting
+FTY_OUTAGE_EXPORT void
+    vclock_sleep (int msecs);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    vclock_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,383 @@
+/*  =========================================================================
+    watchdog - Stall detector and heartbeat of the main loop
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+/*
+@header
+    watchdog - Stall detector and heartbeat of the main loop
+@discuss
+    The main actor is single threaded, so a blocked send or a slow save
+    stops outage detection for its whole duration. Each iteration of the
+    loop (from the poller return to the next wait) is split into phases;
+    the duration of the iteration is recorded to the "loop" histogram and
+    an iteration longer than the threshold is logged as a stall together
+    with the phase which took the most of it. Heartbeats are sent to the
+    systemd watchdog (sd_notify protocol, so there is no link dependency)
+    when the service sets WatchdogSec, and counted in stats either way, so
+    a stuck loop is restarted by systemd or seen as a heartbeat counter
+    which stopped.
+@end
+*/
+
+#include "fty_outage_classes.h"
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const char *s_phase_names [WATCHDOG_PHASES] = {
+    "loop",
+    "journal",
+    "status",
+    "save",
+    "maintenance",
+    "check_dead",
+    "publish",
+    "command",
+    "metrics",
+    "writer",
+    "stream",
+    "mailbox"
+};
+
+//  Structure of our class
+
+struct _watchdog_t {
+    stats_t *stats;                 // borrowed
+    uint64_t stall_us;              // 0 = stalls not reported
+    int64_t start_us;               // zclock_usecs at the start of the iteration
+    int64_t phase_start_us;         // zclock_usecs at the start of the current phase
+    int phase;                      // current phase
+    uint64_t phase_us [WATCHDOG_PHASES];
+    int last_stall;                 // phase which took the most of the last stall
+    int notify_fd;                  // socket to systemd, -1 if not used
+    struct sockaddr_un notify_addr;
+    socklen_t notify_addr_size;
+    uint64_t interval_ms;           // heartbeat interval
+    int64_t last_beat_ms;           // zclock_mono of the last heartbeat
+};
+
+// connect to NOTIFY_SOCKET, if systemd expects watchdog heartbeats from us
+static void
+s_watchdog_systemd_open (watchdog_t *self)
+{
+    const char *path = getenv ("NOTIFY_SOCKET");
+    const char *usec = getenv ("WATCHDOG_USEC");
+    const char *pid = getenv ("WATCHDOG_PID");
+    if (!path || !usec || (path [0] != '/' && path [0] != '@'))
+        return;
+    if (pid && (pid_t) atoll (pid) != getpid ())
+        return;
+    uint64_t watchdog_usec = (uint64_t) atoll (usec);
+    size_t length = strlen (path);
+    if (watchdog_usec == 0 || length >= sizeof (self->notify_addr.sun_path))
+        return;
+
+    memset (&self->notify_addr, 0, sizeof (self->notify_addr));
+    self->notify_addr.sun_family = AF_UNIX;
+    memcpy (self->notify_addr.sun_path, path, length);
+    // abstract namespace
+    if (self->notify_addr.sun_path [0] == '@')
+        self->notify_addr.sun_path [0] = '\0';
+    self->notify_addr_size = (socklen_t) (offsetof (struct sockaddr_un, sun_path) + length);
+    self->notify_fd = socket (AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (self->notify_fd == -1) {
+        log_error ("Can't create socket for systemd watchdog: %s", strerror (errno));
+        return;
+    }
+    // beat twice in each watchdog period
+    self->interval_ms = watchdog_usec / 2000;
+    if (self->interval_ms == 0)
+        self->interval_ms = 1;
+    log_info ("outage: systemd watchdog heartbeat each %" PRIu64 " ms", self->interval_ms);
+}
+
+//  --------------------------------------------------------------------------
+//  Create a new watchdog counting to stats
+
+watchdog_t *
+watchdog_new (stats_t *stats)
+{
+    assert (stats);
+    watchdog_t *self = (watchdog_t *) zmalloc (sizeof (watchdog_t));
+    if (self) {
+        self->stats = stats;
+        self->stall_us = WATCHDOG_STALL_MS * 1000;
+        self->last_stall = -1;
+        self->notify_fd = -1;
+        self->interval_ms = WATCHDOG_HEARTBEAT_MS;
+        s_watchdog_systemd_open (self);
+        self->last_beat_ms = zclock_mono () - (int64_t) self->interval_ms;
+        watchdog_start (self);
+    }
+    return self;
+}
+
+//  --------------------------------------------------------------------------
+//  Destroy the watchdog
+
+void
+watchdog_destroy (watchdog_t **self_p)
+{
+    assert (self_p);
+    if (*self_p) {
+        watchdog_t *self = *self_p;
+        if (self->notify_fd != -1)
+            close (self->notify_fd);
+        free (self);
+        *self_p = NULL;
+    }
+}
+
+//  --------------------------------------------------------------------------
+//  Set duration [ms] of an iteration reported as stall
+
+void
+watchdog_set_threshold (watchdog_t *self, uint64_t stall_ms)
+{
+    assert (self);
+    self->stall_us = stall_ms * 1000;
+}
+
+//  --------------------------------------------------------------------------
+//  Iteration of the loop starts
+
+void
+watchdog_start (watchdog_t *self)
+{
+    assert (self);
+    memset (self->phase_us, 0, sizeof (self->phase_us));
+    self->start_us = zclock_usecs ();
+    self->phase_start_us = self->start_us;
+    self->phase = WATCHDOG_LOOP;
+}
+
+//  --------------------------------------------------------------------------
+//  Work which follows belongs to phase
+
+void
+watchdog_phase (watchdog_t *self, int phase)
+{
+    assert (self);
+    assert (phase >= 0 && phase < WATCHDOG_PHASES);
+    int64_t now_us = zclock_usecs ();
+    if (now_us > self->phase_start_us)
+        self->phase_us [self->phase] += (uint64_t) (now_us - self->phase_start_us);
+    self->phase_start_us = now_us;
+    self->phase = phase;
+}
+
+//  --------------------------------------------------------------------------
+//  Iteration of the loop ends, report it if it is a stall
+
+uint64_t
+watchdog_end (watchdog_t *self)
+{
+    assert (self);
+    watchdog_phase (self, WATCHDOG_LOOP);
+    uint64_t elapsed_us = self->phase_start_us > self->start_us ? (uint64_t) (self->phase_start_us - self->start_us) : 0;
+    stats_record (self->stats, STATS_LOOP, elapsed_us);
+    if (self->stall_us == 0 || elapsed_us < self->stall_us)
+        return elapsed_us;
+
+    int worst = WATCHDOG_LOOP;
+    for (int i = 0; i < WATCHDOG_PHASES; i++) {
+        if (self->phase_us [i] > self->phase_us [worst])
+            worst = i;
+    }
+    self->last_stall = worst;
+    stats_add (self->stats, STATS_STALLS, 1);
+    blackbox_record (BLACKBOX_STALL, s_phase_names [worst], elapsed_us, self->phase_us [worst]);
+    log_warning ("outage: main loop stalled for %" PRIu64 " ms, %" PRIu64 " ms of it in %s",
+                 elapsed_us / 1000, self->phase_us [worst] / 1000, s_phase_names [worst]);
+    return elapsed_us;
+}
+
+//  --------------------------------------------------------------------------
+//  Send heartbeat, if the last one is older than the heartbeat interval
+
+bool
+watchdog_beat (watchdog_t *self)
+{
+    assert (self);
+    int64_t now_ms = zclock_mono ();
+    if (now_ms - self->last_beat_ms < (int64_t) self->interval_ms)
+        return false;
+    self->last_beat_ms = now_ms;
+    stats_add (self->stats, STATS_HEARTBEATS, 1);
+    if (self->notify_fd != -1) {
+        static const char beat [] = "WATCHDOG=1";
+        if (sendto (self->notify_fd, beat, sizeof (beat) - 1, MSG_NOSIGNAL | MSG_DONTWAIT,
+                    (struct sockaddr *) &self->notify_addr, self->notify_addr_size) < 0)
+            log_warning ("Can't send heartbeat to systemd watchdog: %s", strerror (errno));
+    }
+    return true;
+}
+
+//  --------------------------------------------------------------------------
+//  Return heartbeat interval [ms]
+
+uint64_t
+watchdog_interval (watchdog_t *self)
+{
+    assert (self);
+    return self->interval_ms;
+}
+
+//  --------------------------------------------------------------------------
+//  Return true if heartbeats go to systemd
+
+bool
+watchdog_systemd (watchdog_t *self)
+{
+    assert (self);
+    return self->notify_fd != -1;
+}
+
+//  --------------------------------------------------------------------------
+//  Return phase which took the most of the last stall, -1 if no stall yet
+
+int
+watchdog_last_stall (watchdog_t *self)
+{
+    assert (self);
+    return self->last_stall;
+}
+
+//  --------------------------------------------------------------------------
+//  Return name of the phase
+
+const char *
+watchdog_phase_name (int phase)
+{
+    if (phase < 0 || phase >= WATCHDOG_PHASES)
+        return "unknown";
+    return s_phase_names [phase];
+}
+
+//  --------------------------------------------------------------------------
+//  Self test of this class
+
+void
+watchdog_test (bool verbose)
+{
+    ftylog_setInstance("watchdog_test","");
+    if (verbose)
+    {
+        ftylog_setVeboseMode(ftylog_getInstance());
+    }
+    printf (" * watchdog: \n");
+
+    //  @selftest
+    unsetenv ("NOTIFY_SOCKET");
+    unsetenv ("WATCHDOG_USEC");
+    unsetenv ("WATCHDOG_PID");
+    stats_t *stats = stats_new ();
+    assert (stats);
+    watchdog_t *watchdog = watchdog_new (stats);
+    assert (watchdog);
+    assert (!watchdog_systemd (watchdog));
+    assert (watchdog_interval (watchdog) == WATCHDOG_HEARTBEAT_MS);
+    assert (streq (watchdog_phase_name (WATCHDOG_MAILBOX), "mailbox"));
+    assert (streq (watchdog_phase_name (WATCHDOG_PHASES), "unknown"));
+
+    // fast iteration is recorded, but not reported
+    watchdog_start (watchdog);
+    watchdog_phase (watchdog, WATCHDOG_STREAM);
+    watchdog_end (watchdog);
+    assert (stats_count (stats, STATS_LOOP) == 1);
+    assert (stats_counter (stats, STATS_STALLS) == 0);
+    assert (watchdog_last_stall (watchdog) == -1);
+
+    // stall is reported with the phase, which caused it
+    watchdog_set_threshold (watchdog, 50);
+    watchdog_start (watchdog);
+    watchdog_phase (watchdog, WATCHDOG_JOURNAL);
+    zclock_sleep (10);
+    watchdog_phase (watchdog, WATCHDOG_MAILBOX);
+    zclock_sleep (60);
+    watchdog_phase (watchdog, WATCHDOG_PUBLISH);
+    assert (watchdog_end (watchdog) >= 70000);
+    assert (stats_counter (stats, STATS_STALLS) == 1);
+    assert (watchdog_last_stall (watchdog) == WATCHDOG_MAILBOX);
+
+    // disabled reports
+    watchdog_set_threshold (watchdog, 0);
+    watchdog_start (watchdog);
+    watchdog_phase (watchdog, WATCHDOG_SAVE);
+    zclock_sleep (60);
+    watchdog_end (watchdog);
+    assert (stats_counter (stats, STATS_STALLS) == 1);
+    assert (stats_count (stats, STATS_LOOP) == 3);
+
+    // heartbeat is counted, at most once per interval
+    assert (watchdog_beat (watchdog));
+    assert (!watchdog_beat (watchdog));
+    assert (stats_counter (stats, STATS_HEARTBEATS) == 1);
+    watchdog_destroy (&watchdog);
+
+    // heartbeat goes to systemd, if it expects it (socket in abstract namespace)
+    char *name = zsys_sprintf ("@fty-outage-watchdog-test-%d", (int) getpid ());
+    int fd = socket (AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    assert (fd != -1);
+    struct sockaddr_un addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    memcpy (addr.sun_path + 1, name + 1, strlen (name) - 1);
+    assert (bind (fd, (struct sockaddr *) &addr, (socklen_t) (offsetof (struct sockaddr_un, sun_path) + strlen (name))) == 0);
+
+    // relative path is not a valid NOTIFY_SOCKET
+    setenv ("NOTIFY_SOCKET", "src/notify.sock", 1);
+    setenv ("WATCHDOG_USEC", "100000", 1);
+    watchdog = watchdog_new (stats);
+    assert (!watchdog_systemd (watchdog));
+    watchdog_destroy (&watchdog);
+
+    setenv ("NOTIFY_SOCKET", name, 1);
+    watchdog = watchdog_new (stats);
+    assert (watchdog_systemd (watchdog));
+    assert (watchdog_interval (watchdog) == 50);
+    assert (watchdog_beat (watchdog));
+    char buffer [64];
+    ssize_t size = recv (fd, buffer, sizeof (buffer) - 1, 0);
+    assert (size > 0);
+    buffer [size] = '\0';
+    assert (streq (buffer, "WATCHDOG=1"));
+    zclock_sleep (60);
+    assert (watchdog_beat (watchdog));
+    assert (recv (fd, buffer, sizeof (buffer) - 1, 0) > 0);
+    assert (stats_counter (stats, STATS_HEARTBEATS) == 3);
+    watchdog_destroy (&watchdog);
+
+    // heartbeats of other process
+    setenv ("WATCHDOG_PID", "1", 1);
+    watchdog = watchdog_new (stats);
+    assert (!watchdog_systemd (watchdog));
+    watchdog_destroy (&watchdog);
+
+    unsetenv ("NOTIFY_SOCKET");
+    unsetenv ("WATCHDOG_USEC");
+    unsetenv ("WATCHDOG_PID");
+    zstr_free (&name);
+    close (fd);
+    stats_destroy (&stats);
+    //  @end
+    printf ("OK\n");
+}
@@ -0,0 +1,108 @@
+/*  =========================================================================
+    watchdog - Stall detector and heartbeat of the main loop
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+
+#ifndef WATCHDOG_H_INCLUDED
+#define WATCHDOG_H_INCLUDED
+
+#include "../include/fty-outage.h"
+
+// phases of an iteration of the main loop
+#define WATCHDOG_LOOP           0   // bookkeeping of the loop itself
+#define WATCHDOG_JOURNAL        1   // journal_sync
+#define WATCHDOG_STATUS         2   // status_publish
+#define WATCHDOG_SAVE           3   // snapshot of the state taken
+#define WATCHDOG_MAINTENANCE    4   // restored assets purged, schedules run, maintenance expired
+#define WATCHDOG_CHECK_DEAD     5   // s_osrv_check_dead_devices
+#define WATCHDOG_PUBLISH        6   // outage snapshot and stats published
+#define WATCHDOG_COMMAND        7   // actor command
+#define WATCHDOG_METRICS        8   // metrics read from shm processed
+#define WATCHDOG_WRITER         9   // state writer finished
+#define WATCHDOG_STREAM         10  // stream message
+#define WATCHDOG_MAILBOX        11  // mailbox request, including the reply
+#define WATCHDOG_PHASES         12
+
+#define WATCHDOG_STALL_MS       1000    // default stall threshold
+#define WATCHDOG_HEARTBEAT_MS   1000    // heartbeat interval without systemd watchdog
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  @interface
+//  Create a new watchdog counting to stats (borrowed). Heartbeats are sent to
+//  systemd if the service has WatchdogSec set (NOTIFY_SOCKET, WATCHDOG_USEC).
+FTY_OUTAGE_EXPORT watchdog_t *
+    watchdog_new (stats_t *stats);
+
+//  Destroy the watchdog
+FTY_OUTAGE_EXPORT void
+    watchdog_destroy (watchdog_t **self_p);
+
+//  Set duration [ms] of an iteration reported as stall, 0 disables reports
+FTY_OUTAGE_EXPORT void
+    watchdog_set_threshold (watchdog_t *self, uint64_t stall_ms);
+
+//  Iteration of the loop starts (the poller returned), in WATCHDOG_LOOP phase
+FTY_OUTAGE_EXPORT void
+    watchdog_start (watchdog_t *self);
+
+//  Work which follows belongs to phase (WATCHDOG_JOURNAL, ...)
+FTY_OUTAGE_EXPORT void
+    watchdog_phase (watchdog_t *self, int phase);
+
+//  Iteration of the loop ends; record its duration and report it, if it is
+//  a stall. Return the duration [us].
+FTY_OUTAGE_EXPORT uint64_t
+    watchdog_end (watchdog_t *self);
+
+//  Send heartbeat, if the last one is older than the heartbeat interval.
+//  Return true if sent.
+FTY_OUTAGE_EXPORT bool
+    watchdog_beat (watchdog_t *self);
+
+//  Return heartbeat interval [ms], half of systemd WatchdogSec if set
+FTY_OUTAGE_EXPORT uint64_t
+    watchdog_interval (watchdog_t *self);
+
+//  Return true if heartbeats go to systemd
+FTY_OUTAGE_EXPORT bool
+    watchdog_systemd (watchdog_t *self);
+
+//  Return phase which took the most of the last stall, -1 if no stall yet
+FTY_OUTAGE_EXPORT int
+    watchdog_last_stall (watchdog_t *self);
+
+//  Return name of the phase
+FTY_OUTAGE_EXPORT const char *
+    watchdog_phase_name (int phase);
+
+//  Self test of this class
+FTY_OUTAGE_EXPORT void
+    watchdog_test (bool verbose);
+
+//  @end
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif